@@ -0,0 +1,382 @@
+//
+// Copyright 2022 Vlad
+//
+// Headless batch recognizer: pdf and image files (or directories of them)
+// are rendered, binarized and recognized by pipeline stages. With -d it
+// stays resident and serves requests over local socket (OcrServer).
+//
+
+// *************************************
+// includes
+// *************************************
+
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDebug>
+#include <QtCore/QFile>
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BatchPipeline.h"
+#include "FzLocks.h"
+#include "OcrPool.h"
+#include "OcrServer.h"
+#include "PdfExport.h"
+#include "ResultWriter.h"
+#include "Trace.h"
+
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable : 4100)
+#pragma warning(disable : 4611)
+#endif
+
+#include "mupdf/tessocr.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+// *************************************
+// classes
+// *************************************
+
+struct CliOptions {
+  BatchConfig               config;
+  OcrPoolConfig             configOcr;
+  OcrServerConfig           configServer;
+  bool                      isDaemon = false;
+  // results file, "-" for stdout
+  const char*               fileOut = nullptr;
+  ResultFormat              format = ResultFormat::JSONL;
+  // searchable pdf with 1 bpp or gray page images
+  const char*               filePdf = nullptr;
+  bool                      isPdfBinary = true;
+  const char*               fileTrace = nullptr;
+  std::vector<std::string>  files;
+};
+
+// mupdf context, leptonica allocator on it and OCR engines. Released in
+// reverse order whatever way the run ends
+class CliContext
+{
+public:
+  CliContext() = default;
+  ~CliContext() {
+    m_pool.destroy();
+    if (m_ctx != nullptr) {
+      clear_leptonica_mem(m_ctx);
+      fz_drop_context(m_ctx);
+    }
+  }
+
+  CliContext(const CliContext&) = delete;
+  CliContext& operator=(const CliContext&) = delete;
+
+  // engines are not started if not needed by options
+  bool init(const CliOptions& options);
+  fz_context* getContext() const {
+    return m_ctx;
+  }
+  OcrPool* getPool() {
+    return &m_pool;
+  }
+
+private:
+  FzLocks       m_locks;
+  fz_context*   m_ctx = nullptr;
+  OcrPool       m_pool;
+};
+
+// *************************************
+// funcs
+// *************************************
+
+static void printUsage() {
+  qInfo().noquote() << QString::asprintf(
+      "Usage: imb-cli [options] <pdf | image | directory> ...\n"
+      "       imb-cli [options] -d <socket name>\n"
+      "  -a sauvola|fast|leptonica|none  binarization (fast)\n"
+      "  -r <n>          Sauvola window n * 2 + 1 pixels (7)\n"
+      "  -k <factor>     Sauvola factor (0.25)\n"
+      "  -s <scale>|auto pdf render scale, 1.0 is 72 dpi (2)\n"
+      "  -t ocr|auto|layer  pdf text layer usage (auto)\n"
+      "  -j <n>          OCR engines, 0: all cores (0)\n"
+      "  -b <n>          binarization threads (1)\n"
+      "  -q <n>          pages between stages (%d)\n"
+      "  -m <dir>        trained models directory (data/models/)\n"
+      "  -l <lang>       model language (rus)\n"
+      "  -o <file>|-     write results to file or stdout\n"
+      "  -f hocr|alto|jsonl  results format (jsonl)\n"
+      "  -p <file.pdf>   write searchable pdf: page images with text\n"
+      "  -i bin|gray     page images of pdf: 1 bpp CCITT G4 or gray (bin)\n"
+      "  -d <name>       serve requests on local socket, see OcrServer.h\n"
+      "  -J <n>          daemon jobs running at the same time (%d)\n"
+      "  -T <file.json>  write trace of stages (chrome://tracing, Perfetto)",
+      BATCH_QUEUE_CAPACITY, OCR_SERVER_JOB_THREADS);
+}
+
+// integer option value, not less than valueMin
+static bool getIntArg(const char* val, int valueMin, int& value) {
+  char* end = nullptr;
+  const long res = strtol(val, &end, 10);
+  if ((end == val) || (*end != 0) || (res < valueMin) || (res > INT_MAX))
+    return false;
+  value = (int)res;
+  return true;
+}
+
+static bool getTextLayerPolicy(const char* val, TextLayerPolicy& policy) {
+  if (strcmp(val, "ocr") == 0)
+    policy = TextLayerPolicy::ALWAYS_OCR;
+  else if (strcmp(val, "auto") == 0)
+    policy = TextLayerPolicy::AUTO;
+  else if (strcmp(val, "layer") == 0)
+    policy = TextLayerPolicy::TEXT_LAYER_ONLY;
+  else
+    return false;
+  return true;
+}
+
+// false on unknown option or invalid value
+static bool parseOption(char name, const char* val, CliOptions& options) {
+  BatchConfig& config = options.config;
+  switch (name) {
+    case 'a':
+      return Binarizer::getTypeByName(val, config.algorithm);
+    case 'r':
+      return getIntArg(val, 1, config.neibSize);
+    case 'k':
+      config.factor = (float)atof(val);
+      return true;
+    case 's':
+      config.scale = (strcmp(val, "auto") == 0) ? 0.0F : (float)atof(val);
+      return true;
+    case 't':
+      return getTextLayerPolicy(val, config.textLayerPolicy);
+    case 'j':
+      // 0: engine per core
+      return getIntArg(val, 0, options.configOcr.numEngines);
+    case 'b':
+      return getIntArg(val, 1, config.numBinarizeThreads);
+    case 'q':
+      return getIntArg(val, 1, config.queueCapacity);
+    case 'm':
+      options.configOcr.dataPath = val;
+      return true;
+    case 'l':
+      options.configOcr.lang = val;
+      return true;
+    case 'o':
+      options.fileOut = val;
+      return true;
+    case 'f':
+      return ResultWriter::getFormatByName(val, options.format);
+    case 'p':
+      options.filePdf = val;
+      return true;
+    case 'i':
+      options.isPdfBinary = (strcmp(val, "bin") == 0);
+      return options.isPdfBinary || (strcmp(val, "gray") == 0);
+    case 'd':
+      options.configServer.name = val;
+      options.isDaemon = true;
+      return true;
+    case 'J':
+      return getIntArg(val, 1, options.configServer.numJobThreads);
+    case 'T':
+      options.fileTrace = val;
+      return true;
+  }
+  return false;
+}
+
+// false (usage is printed) on invalid options or no source files
+static bool parseArgs(int argc, char* argv[], CliOptions& options) {
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if ((arg[0] != '-') || (arg[1] == 0)) {
+      paths.push_back(arg);
+      continue;
+    }
+    if (i + 1 >= argc) {
+      printUsage();
+      return false;
+    }
+    const char* val = argv[++i];
+    if (!parseOption(arg[1], val, options)) {
+      qWarning() << "Invalid value" << val << "of option" << arg;
+      printUsage();
+      return false;
+    }
+  }
+  options.files = BatchPipeline::getSourceFiles(paths);
+  if (options.files.empty() && !options.isDaemon) {
+    printUsage();
+    return false;
+  }
+  return true;
+}
+
+bool CliContext::init(const CliOptions& options) {
+  m_ctx = m_locks.newContext();
+  if (m_ctx == nullptr)
+    return false;
+  // leptonica inside tesseract allocates via mupdf context
+  set_leptonica_mem(m_ctx);
+  // daemon requests may ask for OCR whatever the default policy is
+  if (!options.isDaemon &&
+      (options.config.textLayerPolicy == TextLayerPolicy::TEXT_LAYER_ONLY))
+    return true;
+  if (!m_pool.init(options.configOcr)) {
+    qWarning() << "Tesseract engines are not initialized";
+    return false;
+  }
+  return true;
+}
+
+// trace of the whole run. false on write error
+static bool writeTrace(const char* fileName) {
+  if (fileName == nullptr)
+    return true;
+  Trace::setEnabled(false);
+  QFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+      !Trace::write(&file)) {
+    qWarning() << "Cannot write trace" << fileName;
+    return false;
+  }
+  return true;
+}
+
+// serves requests until quit request, returns exit code
+static int runDaemon(const CliOptions& options, CliContext& context) {
+  OcrServerConfig configServer = options.configServer;
+  configServer.batch = options.config;
+  OcrServer server(context.getContext(), context.getPool());
+  if (!server.start(configServer))
+    return 1;
+  return QCoreApplication::exec();
+}
+
+// results file or stdout, false if it cannot be written
+static bool openOutput(const char* fileOut, QFile& out) {
+  bool isOpen = false;
+  if (strcmp(fileOut, "-") == 0) {
+    isOpen = out.open(stdout, QIODevice::WriteOnly);
+  } else {
+    out.setFileName(fileOut);
+    isOpen = out.open(QIODevice::WriteOnly | QIODevice::Truncate);
+  }
+  if (!isOpen)
+    qWarning() << "Cannot write" << fileOut;
+  return isOpen;
+}
+
+static void printStats(const BatchStats& stats) {
+  qInfo().noquote() << QString::asprintf(
+      "%d pages (%d failed, %d text layer) in %.2f s: %.2f pages/s",
+      stats.numPages, stats.numFailed, stats.numTextLayer,
+      stats.timeMs / 1000.0, stats.getPagesPerSec());
+  for (int stage = 0; stage < BATCH_NUM_STAGES; stage++) {
+    qInfo().noquote() << QString::asprintf(
+        "  %-9s %3d threads, utilization %5.1f %%",
+        BatchStats::getStageName(stage), stats.stages[stage].numThreads,
+        stats.getUtilization(stage) * 100.0);
+  }
+}
+
+// all source files through the pipeline, returns exit code: 1 on write
+// error, 2 if some pages failed
+static int runBatch(const CliOptions& options, CliContext& context) {
+  BatchConfig config = options.config;
+  // results are streamed page by page, page list is not kept
+  QFile out;
+  std::unique_ptr<ResultWriter> writer;
+  if (options.fileOut != nullptr) {
+    if (!openOutput(options.fileOut, out))
+      return 1;
+    writer = ResultWriter::create(options.format, &out);
+  }
+  bool okWrite = !writer || writer->begin();
+  // pages are appended while later pages are recognized
+  PdfExport exporter(context.getContext());
+  if (options.filePdf != nullptr) {
+    if (!exporter.open(options.filePdf))
+      return 1;
+    // text layer pages are rendered too
+    config.keepImage = true;
+  }
+
+  BatchPipeline pipeline(config, context.getContext(), context.getPool());
+  const BatchStats stats = pipeline.run(options.files, [&](BatchPage& page) {
+    qInfo().noquote() << QString::asprintf(
+        "%s [%d]: %d words%s%s", page.fileName.c_str(), page.pageIndex + 1,
+        (int)page.words.size(), page.isTextLayer ? ", text layer" : "",
+        page.ok ? "" : ", FAILED");
+    if (writer && okWrite && !writer->writePage(page)) {
+      qWarning() << "Cannot write" << options.fileOut << ":"
+                 << out.errorString();
+      okWrite = false;
+      pipeline.cancel();
+    }
+    if (exporter.isOpen() && page.ok) {
+      const QImage image = (options.isPdfBinary && !page.imageBin.isNull())
+                               ? page.imageBin.getQImage()
+                               : page.image;
+      if (!exporter.addPage(image, page.scale, page.words)) {
+        okWrite = false;
+        pipeline.cancel();
+      }
+    }
+  });
+  if (writer) {
+    okWrite = writer->end() && okWrite;
+    out.close();
+  }
+  if (exporter.isOpen())
+    okWrite = exporter.close() && okWrite;
+  printStats(stats);
+  if (!okWrite)
+    return 1;
+  return (stats.numFailed == 0) ? 0 : 2;
+}
+
+int main(int argc, char *argv[])
+{
+  // image format plugins are found by application paths
+  QCoreApplication app(argc, argv);
+
+  CliOptions options;
+  if (!parseArgs(argc, argv, options))
+    return 1;
+
+  Trace::setThreadName("main");
+  Trace::setEnabled(options.fileTrace != nullptr);
+  int res = 1;
+  {
+    CliContext context;
+    if (context.init(options)) {
+      res = options.isDaemon ? runDaemon(options, context)
+                             : runBatch(options, context);
+    }
+  }
+  if (!writeTrace(options.fileTrace))
+    res = 1;
+  return res;
+}
@@ -0,0 +1,387 @@
+//
+// Copyright 2022 Vlad
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <QtCore/QDebug>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFileInfo>
+
+#include "BatchPipeline.h"
+#include "PdfRender.h"
+#include "TextScale.h"
+#include "Trace.h"
+
+using BatchClock = std::chrono::steady_clock;
+
+static double getMsSince(BatchClock::time_point timeStart) {
+  return std::chrono::duration<double, std::milli>(BatchClock::now() -
+                                                   timeStart).count();
+}
+
+static bool isImageSuffix(const QString& suffix) {
+  static const char* const suffixes[] = {"png", "jpg", "jpeg", "tif",
+                                         "tiff", "bmp"};
+  for (const char* suf : suffixes) {
+    if (suffix.compare(QLatin1String(suf), Qt::CaseInsensitive) == 0)
+      return true;
+  }
+  return false;
+}
+
+// size of rendered page without render
+static QSize getPageSize(fz_context* ctx, fz_document* doc, int pageIndex,
+                         fz_matrix ctm) {
+  fz_page* page = nullptr;
+  fz_irect bbox = fz_empty_irect;
+  fz_var(page);
+  fz_try(ctx) {
+    page = fz_load_page(ctx, doc, pageIndex);
+    bbox = fz_round_rect(fz_transform_rect(fz_bound_page(ctx, page), ctm));
+  }
+  fz_always(ctx) {
+    fz_drop_page(ctx, page);
+  }
+  fz_catch(ctx) {
+    return QSize();
+  }
+  return QSize(bbox.x1 - bbox.x0, bbox.y1 - bbox.y0);
+}
+
+double BatchStats::getPagesPerSec() const {
+  return (timeMs > 0.0) ? (numPages * 1000.0 / timeMs) : 0.0;
+}
+
+double BatchStats::getUtilization(int stage) const {
+  const BatchStageStats& st = stages[stage];
+  const double timeThreads = timeMs * st.numThreads;
+  return (timeThreads > 0.0) ? (st.busyMs / timeThreads) : 0.0;
+}
+
+const char* BatchStats::getStageName(int stage) {
+  switch (stage) {
+    case BATCH_STAGE_RENDER:
+      return "render";
+    case BATCH_STAGE_BINARIZE:
+      return "binarize";
+    case BATCH_STAGE_OCR:
+      return "ocr";
+  }
+  return "";
+}
+
+BatchPipeline::BatchPipeline(const BatchConfig& config, fz_context* ctx,
+                             OcrPool* pool) {
+  m_config = config;
+  // empty queues or stages would never pass a page
+  m_config.queueCapacity = std::max(m_config.queueCapacity, 1);
+  m_config.numBinarizeThreads = std::max(m_config.numBinarizeThreads, 1);
+  m_ctx = ctx;
+  m_pool = pool;
+  m_cancel = false;
+  m_indexNext = 0;
+  m_numPagesWindow = 1;
+  m_onPage = nullptr;
+}
+
+bool BatchPipeline::isPdfFile(const std::string& fileName) {
+  return QFileInfo(QString::fromStdString(fileName))
+             .suffix()
+             .compare(QLatin1String("pdf"), Qt::CaseInsensitive) == 0;
+}
+
+std::vector<std::string> BatchPipeline::getSourceFiles(
+    const std::vector<std::string>& paths) {
+  std::vector<std::string> files;
+  for (const std::string& path : paths) {
+    const QFileInfo info(QString::fromStdString(path));
+    if (info.isFile()) {
+      files.push_back(path);
+      continue;
+    }
+    if (!info.isDir()) {
+      qWarning() << "BatchPipeline: path not found:" << path.c_str();
+      continue;
+    }
+    std::vector<std::string> filesDir;
+    QDirIterator it(info.filePath(), QDir::Files,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+      it.next();
+      const QString suffix = it.fileInfo().suffix();
+      if ((suffix.compare(QLatin1String("pdf"), Qt::CaseInsensitive) == 0) ||
+          isImageSuffix(suffix))
+        filesDir.push_back(it.filePath().toStdString());
+    }
+    std::sort(filesDir.begin(), filesDir.end());
+    files.insert(files.end(), filesDir.begin(), filesDir.end());
+  }
+  return files;
+}
+
+BatchStats BatchPipeline::run(const std::vector<std::string>& files,
+                              const PageCallback& onPage) {
+  m_stats = BatchStats();
+  m_pagesReady.clear();
+  m_indexNext = 0;
+  m_onPage = &onPage;
+
+  const int numBinarize = m_config.numBinarizeThreads;
+  // one thread per engine: every engine has a page to work on
+  const int numOcr = std::max(m_pool->getNumEngines(), 1);
+  m_stats.stages[BATCH_STAGE_RENDER].numThreads = 1;
+  m_stats.stages[BATCH_STAGE_BINARIZE].numThreads = numBinarize;
+  m_stats.stages[BATCH_STAGE_OCR].numThreads = numOcr;
+  // enough to keep every queue and stage thread busy
+  m_numPagesWindow = 2 * m_config.queueCapacity + numBinarize + numOcr;
+
+  BoundedQueue<BatchPage> queueRendered((size_t)m_config.queueCapacity);
+  BoundedQueue<BatchPage> queueBinarized((size_t)m_config.queueCapacity);
+  // stage threads merge their stats at exit
+  auto addStats = [this](int stage, const BatchStageStats& st) {
+    std::lock_guard<std::mutex> lock(m_mutexStats);
+    m_stats.stages[stage].numPages += st.numPages;
+    m_stats.stages[stage].busyMs += st.busyMs;
+  };
+
+  const auto timeStart = BatchClock::now();
+  std::vector<std::thread> threads;
+  threads.emplace_back([&] {
+    Trace::setThreadName("render");
+    BatchStageStats st;
+    renderStage(files, queueRendered, st);
+    queueRendered.close();
+    addStats(BATCH_STAGE_RENDER, st);
+  });
+  std::atomic<int> numBinarizeRunning(numBinarize);
+  for (int i = 0; i < numBinarize; i++) {
+    threads.emplace_back([&] {
+      Trace::setThreadName("binarize");
+      BatchStageStats st;
+      binarizeStage(queueRendered, queueBinarized, st);
+      if (--numBinarizeRunning == 0)
+        queueBinarized.close();
+      addStats(BATCH_STAGE_BINARIZE, st);
+    });
+  }
+  for (int i = 0; i < numOcr; i++) {
+    threads.emplace_back([&] {
+      Trace::setThreadName("ocr");
+      BatchStageStats st;
+      ocrStage(queueBinarized, st);
+      addStats(BATCH_STAGE_OCR, st);
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  m_stats.timeMs = getMsSince(timeStart);
+  m_onPage = nullptr;
+  return m_stats;
+}
+
+void BatchPipeline::renderStage(const std::vector<std::string>& files,
+                                BoundedQueue<BatchPage>& queueOut,
+                                BatchStageStats& stats) {
+  int index = 0;
+  for (const std::string& fileName : files) {
+    if (m_cancel)
+      return;
+    if (isPdfFile(fileName)) {
+      if (!renderPdf(fileName, index, queueOut, stats))
+        return;
+      continue;
+    }
+    if (!waitForWindow(index))
+      return;
+    const auto timeStart = BatchClock::now();
+    BatchPage page;
+    page.fileName = fileName;
+    page.index = index++;
+    {
+      // push waiting for free queue slot is not a part of zone
+      TRACE_ZONE("loadImage", page.index);
+      QImage image(QString::fromStdString(fileName));
+      if (image.isNull()) {
+        qWarning() << "BatchPipeline: cannot load" << fileName.c_str();
+        page.ok = false;
+      } else {
+        // binarizers and OCR work on gray pixels anyway
+        page.image = image.convertToFormat(QImage::Format_Grayscale8);
+        page.size = page.image.size();
+        // unknown resolution: pixel is a point
+        if (image.dotsPerMeterX() > 0)
+          page.scale = image.dotsPerMeterX() * 0.0254F / 72.0F;
+      }
+    }
+    stats.busyMs += getMsSince(timeStart);
+    stats.numPages++;
+    if (!queueOut.push(std::move(page)))
+      return;
+  }
+}
+
+bool BatchPipeline::renderPdf(const std::string& fileName, int& index,
+                              BoundedQueue<BatchPage>& queueOut,
+                              BatchStageStats& stats) {
+  auto timeStart = BatchClock::now();
+  fz_document* doc = nullptr;
+  int numPages = 0;
+  fz_var(doc);
+  fz_try(m_ctx) {
+    doc = fz_open_document(m_ctx, fileName.c_str());
+    numPages = fz_count_pages(m_ctx, doc);
+  }
+  fz_catch(m_ctx) {
+    fz_drop_document(m_ctx, doc);
+    doc = nullptr;
+  }
+  if (doc == nullptr) {
+    qWarning() << "BatchPipeline: cannot open" << fileName.c_str();
+    stats.busyMs += getMsSince(timeStart);
+    if (!waitForWindow(index))
+      return false;
+    BatchPage page;
+    page.fileName = fileName;
+    page.index = index++;
+    page.ok = false;
+    stats.numPages++;
+    return queueOut.push(std::move(page));
+  }
+
+  stats.busyMs += getMsSince(timeStart);
+
+  bool isOpen = true;
+  for (int i = 0; (i < numPages) && isOpen; i++) {
+    if (!waitForWindow(index)) {
+      isOpen = false;
+      break;
+    }
+    timeStart = BatchClock::now();
+    BatchPage page;
+    page.fileName = fileName;
+    page.pageIndex = i;
+    page.index = index++;
+    renderPdfPage(doc, page);
+    stats.busyMs += getMsSince(timeStart);
+    stats.numPages++;
+    isOpen = queueOut.push(std::move(page));
+  }
+  fz_drop_document(m_ctx, doc);
+  return isOpen;
+}
+
+void BatchPipeline::renderPdfPage(fz_document* doc, BatchPage& page) {
+  TRACE_ZONE("loadPdfPage", page.index);
+  const int i = page.pageIndex;
+  float scale = m_config.scale;
+  if (scale <= 0.0F) {
+    scale = TextScale::getPageScale(m_ctx, doc, i, m_config.rotate);
+    if (scale <= 0.0F)
+      scale = BATCH_DEFAULT_SCALE;
+  }
+  const fz_matrix ctm = PdfRender::getMatrix(scale, m_config.rotate);
+  page.scale = scale;
+
+  if (m_config.textLayerPolicy != TextLayerPolicy::ALWAYS_OCR) {
+    PdfTextLayer layer;
+    if (PdfText::getTextLayer(m_ctx, doc, i, ctm, layer) &&
+        PdfText::useTextLayer(m_config.textLayerPolicy, layer)) {
+      page.words = std::move(layer.words);
+      page.isTextLayer = true;
+      page.size = getPageSize(m_ctx, doc, i, ctm);
+    }
+  }
+  if (!page.isTextLayer || m_config.keepImage) {
+    // bands of the page are rasterized in parallel
+    fz_display_list* list = PdfRender::newDisplayList(m_ctx, doc, i);
+    if (list != nullptr) {
+      page.image = PdfRender::renderDisplayList(m_ctx, list, ctm, true);
+      fz_drop_display_list(m_ctx, list);
+    }
+    page.ok = !page.image.isNull();
+    page.size = page.image.size();
+  }
+}
+
+void BatchPipeline::binarizeStage(BoundedQueue<BatchPage>& queueIn,
+                                  BoundedQueue<BatchPage>& queueOut,
+                                  BatchStageStats& stats) {
+  BatchPage page;
+  while (queueIn.pop(page)) {
+    const auto timeStart = BatchClock::now();
+    if (page.ok && !page.isTextLayer &&
+        (m_config.algorithm != AlgirithmBinType::ALGORITHM_NONE)) {
+      TRACE_ZONE("binarize", page.index);
+      page.imageBin = Binarizer::binarize(page.image, m_config.algorithm,
+                                          m_config.neibSize,
+                                          m_config.factor);
+      // gray page is not needed for OCR of binarized one
+      if (!m_config.keepImage)
+        page.image = QImage();
+    }
+    stats.busyMs += getMsSince(timeStart);
+    stats.numPages++;
+    if (!queueOut.push(std::move(page)))
+      return;
+  }
+}
+
+void BatchPipeline::ocrStage(BoundedQueue<BatchPage>& queueIn,
+                             BatchStageStats& stats) {
+  BatchPage page;
+  while (queueIn.pop(page)) {
+    const auto timeStart = BatchClock::now();
+    if (page.ok && !page.isTextLayer) {
+      TRACE_ZONE("ocr", page.index);
+      std::future<std::vector<TextBox>> words =
+          page.imageBin.isNull() ? m_pool->submit(page.image)
+                                 : m_pool->submit(page.imageBin);
+      page.words = words.get();
+    }
+    // images wait in m_pagesReady only if page callback needs them
+    if (!m_config.keepImage) {
+      page.image = QImage();
+      page.imageBin = BinImage();
+    }
+    stats.busyMs += getMsSince(timeStart);
+    stats.numPages++;
+    deliver(std::move(page));
+    page = BatchPage();
+  }
+}
+
+bool BatchPipeline::waitForWindow(int index) {
+  // pages before index are already rendered: the next page to report is
+  // never waited for here
+  std::unique_lock<std::mutex> lock(m_mutexDeliver);
+  m_condDeliver.wait(lock, [this, index] {
+    return m_cancel || (index < m_indexNext + m_numPagesWindow);
+  });
+  return !m_cancel;
+}
+
+void BatchPipeline::deliver(BatchPage&& page) {
+  std::lock_guard<std::mutex> lock(m_mutexDeliver);
+  m_pagesReady.emplace(page.index, std::move(page));
+  while (!m_pagesReady.empty() &&
+         (m_pagesReady.begin()->first == m_indexNext)) {
+    BatchPage& pageNext = m_pagesReady.begin()->second;
+    m_stats.numPages++;
+    if (!pageNext.ok)
+      m_stats.numFailed++;
+    if (pageNext.isTextLayer)
+      m_stats.numTextLayer++;
+    {
+      TRACE_ZONE("onPage", pageNext.index);
+      (*m_onPage)(pageNext);
+    }
+    m_pagesReady.erase(m_pagesReady.begin());
+    m_indexNext++;
+    m_condDeliver.notify_all();
+  }
+}
@@ -0,0 +1,182 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _BATCH_PIPELINE_H__
+#define _BATCH_PIPELINE_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <QtCore/QSize>
+#include <QtGui/QImage>
+
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable : 4100)
+#pragma warning(disable : 4611)
+#endif
+
+#include "mupdf/fitz.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+#include "BinImage.h"
+#include "Binarizer.h"
+#include "BoundedQueue.h"
+#include "OcrPool.h"
+#include "PdfText.h"
+#include "RecogRes.h"
+
+// pages between two stages: more pages only take memory, stages overlap
+// with a couple of pages already
+#define BATCH_QUEUE_CAPACITY    4
+// pdf render scale when text size is unknown
+#define BATCH_DEFAULT_SCALE     2.0F
+
+enum BatchStage {
+  BATCH_STAGE_RENDER = 0,
+  BATCH_STAGE_BINARIZE = 1,
+  BATCH_STAGE_OCR = 2,
+  BATCH_NUM_STAGES = 3,
+};
+
+struct BatchConfig {
+  AlgirithmBinType  algorithm = AlgirithmBinType::ALGORITHM_SAUVOLA_FAST;
+  // Sauvola window is (neibSize * 2 + 1) pixels
+  int               neibSize = 7;
+  float             factor = 0.25F;
+  // pdf render scale (1.0 is 72 dpi), 0: by text size of page (TextScale)
+  float             scale = BATCH_DEFAULT_SCALE;
+  float             rotate = 0.0F;
+  TextLayerPolicy   textLayerPolicy = TextLayerPolicy::AUTO;
+  int               queueCapacity = BATCH_QUEUE_CAPACITY;
+  int               numBinarizeThreads = 1;
+  // page images (gray and binarized) are kept for page callback, text
+  // layer pages are rendered too (for pdf export)
+  bool              keepImage = false;
+};
+
+// one page on its way through the stages
+struct BatchPage {
+  // source file and page in it (0 for image files)
+  std::string           fileName;
+  int                   pageIndex = 0;
+  // page number in the whole batch
+  int                   index = 0;
+  // rendered page pixels (words are in these pixels)
+  QSize                 size;
+  // page pixels per pdf point: render scale, or image resolution / 72
+  float                 scale = 1.0F;
+  // rendered gray page, dropped after binarization (see keepImage)
+  QImage                image;
+  // null for ALGORITHM_NONE or text layer pages, dropped after OCR (see
+  // keepImage)
+  BinImage              imageBin;
+  std::vector<TextBox>  words;
+  // words are taken from pdf text layer, no binarization and OCR
+  bool                  isTextLayer = false;
+  // page cannot be loaded or rendered: no words
+  bool                  ok = true;
+};
+
+struct BatchStageStats {
+  int     numThreads = 0;
+  int     numPages = 0;
+  // sum of work time of stage threads, waits in queues excluded
+  double  busyMs = 0.0;
+};
+
+struct BatchStats {
+  int               numPages = 0;
+  int               numFailed = 0;
+  int               numTextLayer = 0;
+  double            timeMs = 0.0;
+  BatchStageStats   stages[BATCH_NUM_STAGES];
+
+  double getPagesPerSec() const;
+  // busy part of stage threads time [0..1]
+  double getUtilization(int stage) const;
+  static const char* getStageName(int stage);
+};
+
+// Headless document processing: render, binarize and OCR run as separate
+// stages on their own threads, connected by bounded queues. Stages overlap
+// across pages, full queue stops the faster stage (backpressure). Pages
+// are reported in batch order: render also waits while it is too far
+// ahead of the next page to report, so pages finished out of order are
+// limited too and memory does not depend on the number of pages.
+class BatchPipeline
+{
+public:
+  // called for every page in files order, by one thread at a time
+  using PageCallback = std::function<void(BatchPage&)>;
+
+  // ctx should be created with locks (FzLocks): pages are rasterized by
+  // bands. Pool without engines gives pages without words
+  BatchPipeline(const BatchConfig& config, fz_context* ctx, OcrPool* pool);
+
+  BatchPipeline(const BatchPipeline&) = delete;
+  BatchPipeline& operator=(const BatchPipeline&) = delete;
+
+  // process all pages of pdf and image files, returns after the last page
+  BatchStats run(const std::vector<std::string>& files,
+                 const PageCallback& onPage);
+  // any thread: no more pages are rendered, pages in work are finished
+  // and reported
+  void cancel() {
+    m_cancel = true;
+    // no lock: called from page callback too. Waiting render is woken
+    // by the next reported page at the latest
+    m_condDeliver.notify_all();
+  }
+
+  // files of paths: directories are searched (recursively) for pdf and
+  // image files, sorted by name
+  static std::vector<std::string> getSourceFiles(
+      const std::vector<std::string>& paths);
+  static bool isPdfFile(const std::string& fileName);
+
+private:
+  void renderStage(const std::vector<std::string>& files,
+                   BoundedQueue<BatchPage>& queueOut,
+                   BatchStageStats& stats);
+  // false if pipeline is closed
+  bool renderPdf(const std::string& fileName, int& index,
+                 BoundedQueue<BatchPage>& queueOut, BatchStageStats& stats);
+  // text layer and (or) image of page.pageIndex
+  void renderPdfPage(fz_document* doc, BatchPage& page);
+  void binarizeStage(BoundedQueue<BatchPage>& queueIn,
+                     BoundedQueue<BatchPage>& queueOut,
+                     BatchStageStats& stats);
+  void ocrStage(BoundedQueue<BatchPage>& queueIn, BatchStageStats& stats);
+  // false if cancelled while waiting for pages before index to be reported
+  bool waitForWindow(int index);
+  // pages finished out of order wait for previous ones
+  void deliver(BatchPage&& page);
+
+  BatchConfig                   m_config;
+  fz_context*                   m_ctx;
+  OcrPool*                      m_pool;
+  std::atomic<bool>             m_cancel;
+
+  std::mutex                    m_mutexStats;
+  std::mutex                    m_mutexDeliver;
+  std::condition_variable       m_condDeliver;
+  std::map<int, BatchPage>      m_pagesReady;
+  int                           m_indexNext;
+  // pages rendered and not reported yet: in queues, stage threads and
+  // m_pagesReady
+  int                           m_numPagesWindow;
+  const PageCallback*           m_onPage;
+  BatchStats                    m_stats;
+};
+
+#endif
@@ -0,0 +1,51 @@
+//
+// Copyright 2022 Vlad
+//
+
+#include <bitset>
+#include <cassert>
+
+#include "BinImage.h"
+
+using SharedWords = std::shared_ptr<uint64_t[]>;
+
+// QImage cleanup: drop reference of image to the shared pixels
+static void releaseWords(void *info) {
+  delete (SharedWords *)info;
+}
+
+BinImage::BinImage() {
+  m_wImage = 0;
+  m_hImage = 0;
+  m_wordsPerLine = 0;
+}
+
+BinImage::BinImage(int w, int h) {
+  assert(w > 0);
+  assert(h > 0);
+  m_wImage = w;
+  m_hImage = h;
+  m_wordsPerLine = (w + 63) / 64;
+  // zero initialized: bits out of width are never set
+  m_words = SharedWords(new uint64_t[(int64_t)m_wordsPerLine * h]());
+}
+
+QImage BinImage::getQImage() const {
+  if (isNull())
+    return QImage();
+  QImage image((uchar *)m_words.get(), m_wImage, m_hImage,
+               getBytesPerLine(), QImage::Format::Format_Mono, releaseWords,
+               new SharedWords(m_words));
+  image.setColorTable({qRgb(0, 0, 0), qRgb(255, 255, 255)});
+  return image;
+}
+
+int64_t BinImage::getNumBlack() const {
+  const int64_t numWords = (int64_t)m_wordsPerLine * m_hImage;
+  const uint64_t *words = m_words.get();
+  int64_t numWhite = 0;
+  for (int64_t i = 0; i < numWords; i++) {
+    numWhite += (int64_t)std::bitset<64>(words[i]).count();
+  }
+  return (int64_t)m_wImage * m_hImage - numWhite;
+}
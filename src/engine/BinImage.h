@@ -0,0 +1,71 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _BIN_IMAGE_H__
+#define _BIN_IMAGE_H__
+
+#include <cstdint>
+#include <memory>
+
+#include <QtGui/QImage>
+
+// Binarized image, 1 bit per pixel, rows are arrays of 64-bit words.
+// Bit value 1 is white (background), 0 is black (text).
+// Bytes of a row are in QImage::Format_Mono order (first pixel is the most
+// significant bit of the first byte), so the same memory is rendered by Qt
+// and passed to Tesseract as 1 bpp image without conversion.
+// Pixel storage is shared (shallow copy), also with images from getQImage.
+class BinImage
+{
+public:
+  BinImage();
+  // all pixels are black (zero bits)
+  BinImage(int w, int h);
+
+  int width() const {
+    return m_wImage;
+  }
+  int height() const {
+    return m_hImage;
+  }
+  int getWordsPerLine() const {
+    return m_wordsPerLine;
+  }
+  int getBytesPerLine() const {
+    return m_wordsPerLine * 8;
+  }
+  bool isNull() const {
+    return m_words == nullptr;
+  }
+  uint64_t* getLine(int y) const {
+    return m_words.get() + (int64_t)y * m_wordsPerLine;
+  }
+  const uchar* getBytes() const {
+    return (const uchar*)m_words.get();
+  }
+
+  // bit of pixel x inside its row word (little-endian host)
+  static uint64_t getMask(int x) {
+    return (uint64_t)1 << (((x >> 3) & 7) * 8 + 7 - (x & 7));
+  }
+  bool isWhite(int x, int y) const {
+    return (getLine(y)[x >> 6] & getMask(x)) != 0;
+  }
+  void setWhite(int x, int y) {
+    getLine(y)[x >> 6] |= getMask(x);
+  }
+
+  // Format_Mono image over the same pixels, no copy: color 0 is black,
+  // color 1 is white
+  QImage getQImage() const;
+  int64_t getNumBlack() const;
+
+private:
+  int                         m_wImage;
+  int                         m_hImage;
+  int                         m_wordsPerLine;
+  std::shared_ptr<uint64_t[]> m_words;
+};
+
+#endif
@@ -0,0 +1,121 @@
+//
+// Copyright 2022 Vlad
+//
+
+#include <cassert>
+#include <cstring>
+
+#include "Binarizer.h"
+#include "Bmp.h"
+#include "FImage.h"
+#include "FastMeanStd.h"
+#include "IntegralImage.h"
+#include "Trace.h"
+
+BinImage Binarizer::binarize(const QImage& imageSrc, AlgirithmBinType type,
+                             int neibSize, float factor) {
+  // shallow copy: binarizers take not const image
+  QImage image(imageSrc);
+  switch (type) {
+    case AlgirithmBinType::ALGORITHM_SAUVOLA:
+      return createSauvola(image, neibSize, factor);
+    case AlgirithmBinType::ALGORITHM_SAUVOLA_FAST:
+      return createSauvolaFast(image, neibSize, factor);
+    case AlgirithmBinType::ALGORITHM_LEPTONICA:
+      return createLeptonicaBinarization(image, neibSize, factor);
+    case AlgirithmBinType::ALGORITHM_NONE:
+      break;
+  }
+  return BinImage();
+}
+
+bool Binarizer::getTypeByName(const char* name, AlgirithmBinType& type) {
+  if (strcmp(name, "sauvola") == 0)
+    type = AlgirithmBinType::ALGORITHM_SAUVOLA;
+  else if (strcmp(name, "fast") == 0)
+    type = AlgirithmBinType::ALGORITHM_SAUVOLA_FAST;
+  else if (strcmp(name, "leptonica") == 0)
+    type = AlgirithmBinType::ALGORITHM_LEPTONICA;
+  else if (strcmp(name, "none") == 0)
+    type = AlgirithmBinType::ALGORITHM_NONE;
+  else
+    return false;
+  return true;
+}
+
+BinImage Binarizer::createLeptonicaBinarization(QImage&       imageSrc,
+                                              const int     neibSize,
+                                              const float   factor) {
+
+  PIX* pixSrc = nullptr;
+  PIX* pixDest = nullptr;
+  PIX* pixThr = nullptr;
+
+  pixSrc = BmpQImageToPix(imageSrc);
+  assert(pixSrc);
+
+  #ifdef DEEP_DEBUG
+    pixWrite("log/src_for_lepto.png", pixSrc, IFF_PNG);
+  #endif
+
+  const int subdivTiles = 4;
+  {
+    TRACE_ZONE("leptonica");
+    pixSauvolaBinarizeTiled(pixSrc, neibSize * 2 + 1, factor, subdivTiles,
+                            subdivTiles, &pixThr, &pixDest);
+  }
+
+  #ifdef DEEP_DEBUG
+    pixWrite("log/bin_lepto.png", pixDest, IFF_PNG);
+  #endif
+
+  BinImage imageBin = BmpPixToBinImage(pixDest);
+
+  #ifdef DEEP_DEBUG
+    imageBin.getQImage().save("log/qimg_bina.png");
+  #endif
+
+  pixDestroy(&pixDest);
+  pixDestroy(&pixThr);
+  pixDestroy(&pixSrc);
+  return imageBin;
+}
+
+
+BinImage Binarizer::createSauvola(QImage& imageSrc, const int neibSize,
+                                  const float factor) {
+  //
+  // According to https://craftofcoding.wordpress.com/2021/10/06/thresholding-algorithms-sauvola-local/
+  // threshold value is calculated as:
+  // t = M * (1 + k * ((S/128) - 1))
+  // t: result threshold
+  // M: media value
+  // S: standard deviation value
+  // k: factor in [0.2 .. 0.5]
+
+  FImage imageFloatSrc(imageSrc);
+
+  FImage imageFloatMean = imageFloatSrc.getWindowedMean(neibSize * 2 + 1);
+  FImage imageFloatStdDev = imageFloatSrc.getWindowedStdDev(imageFloatMean, neibSize * 2 + 1);
+  FImage imageFloatThresholds =
+      imageFloatMean.getSauvolaThreshold(imageFloatStdDev, factor);
+
+  BinImage imageBin = imageFloatSrc.applyThresholdsBin(imageFloatThresholds);
+  return imageBin;
+}
+
+BinImage Binarizer::createSauvolaFast(QImage& imageSrc, const int neibSize,
+                                      const float factor) {
+  FImage imageFloatSrc(imageSrc);
+  BinImage imageBin(imageFloatSrc.width(), imageFloatSrc.height());
+
+  // exact integer window sums: float sums of squares lose precision
+  // on large pages
+  IntegralImage integral(imageFloatSrc);
+
+  // mean, std dev and thresholds are not stored: single pass directly
+  // into destination image
+  FastMeanStd::getSauvolaFused(imageFloatSrc, integral, neibSize * 2 + 1,
+                               factor, imageBin);
+  return imageBin;
+}
@@ -0,0 +1,39 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _BINARIZER_H__
+#define _BINARIZER_H__
+
+#include <QtGui/QImage>
+
+#include "BinImage.h"
+
+enum class AlgirithmBinType {
+  ALGORITHM_SAUVOLA = 0,
+  ALGORITHM_SAUVOLA_FAST = 1,
+  ALGORITHM_LEPTONICA = 2,
+  ALGORITHM_NONE = 3,
+};
+
+// Page binarization by one of the algorithms. Functions have no state and
+// can be called from any thread.
+class Binarizer {
+ public:
+  // window of Sauvola is (neibSize * 2 + 1) pixels.
+  // ALGORITHM_NONE gives null image: source image is recognized as is
+  static BinImage binarize(const QImage& imageSrc, AlgirithmBinType type,
+                           int neibSize, float factor);
+
+  static BinImage createSauvola(QImage& imageSrc, int neibSize,
+                                float factor);
+  static BinImage createSauvolaFast(QImage& imageSrc, int neibSize,
+                                    float factor);
+  static BinImage createLeptonicaBinarization(QImage& imageSrc, int neibSize,
+                                              float factor);
+
+  // "sauvola", "fast", "leptonica", "none". false for unknown name
+  static bool getTypeByName(const char* name, AlgirithmBinType& type);
+};
+
+#endif
@@ -5,6 +5,10 @@
 #include <cassert>
 
 #include "Bmp.h"
+#include "BinImage.h"
+#include "FImage.h"
+#include "Simd.h"
+#include "Trace.h"
 
 
 Bmp::Bmp() {
@@ -79,6 +83,159 @@ int Bmp::initFromQImage(QImage& img) {
   return 0;
 }
 
+// Leptonica keeps 8 bpp pixels in 32-bit words, leftmost pixel in the
+// most significant byte. So 4 pixels (p0, p1, p2, p3) are one word
+static inline uint32_t packGrayWord(uint32_t p0, uint32_t p1, uint32_t p2,
+                                    uint32_t p3) {
+  return (p0 << 24) | (p1 << 16) | (p2 << 8) | p3;
+}
+
+static inline uint32_t getGrayRgb(const uint8_t *pixel) {
+  return ((uint32_t)pixel[0] + pixel[1] + pixel[2]) / 3;
+}
+
+static void convertRowRgb32(const uint8_t *src, uint32_t *dst, int w) {
+  int x = 0;
+#if defined(IMB_SIMD_AVX2)
+  const __m256i maskByte = _mm256_set1_epi32(0xff);
+  // (s * 21846) >> 16 == s / 3 for s in [0..765]
+  const __m256i div3 = _mm256_set1_epi32(21846);
+  // per 128-bit lane: gray in byte 0 of each dword, reversed into one word
+  const __m256i shuffle = _mm256_setr_epi8(
+      12, 8, 4, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      12, 8, 4, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  for (; x + 8 <= w; x += 8) {
+    const __m256i bgra = _mm256_loadu_si256((const __m256i *)(src + x * 4));
+    const __m256i b = _mm256_and_si256(bgra, maskByte);
+    const __m256i g = _mm256_and_si256(_mm256_srli_epi32(bgra, 8), maskByte);
+    const __m256i r = _mm256_and_si256(_mm256_srli_epi32(bgra, 16), maskByte);
+    __m256i sum = _mm256_add_epi32(_mm256_add_epi32(b, g), r);
+    sum = _mm256_srli_epi32(_mm256_mullo_epi32(sum, div3), 16);
+    const __m256i words = _mm256_shuffle_epi8(sum, shuffle);
+    dst[x / 4] = (uint32_t)_mm256_extract_epi32(words, 0);
+    dst[x / 4 + 1] = (uint32_t)_mm256_extract_epi32(words, 4);
+  }
+#endif
+  for (; x + 4 <= w; x += 4) {
+    const uint8_t *pixel = src + x * 4;
+    dst[x / 4] = packGrayWord(getGrayRgb(pixel), getGrayRgb(pixel + 4),
+                              getGrayRgb(pixel + 8), getGrayRgb(pixel + 12));
+  }
+  if (x < w) {
+    uint32_t gray[4] = {0, 0, 0, 0};
+    for (int i = 0; x + i < w; i++) {
+      gray[i] = getGrayRgb(src + (x + i) * 4);
+    }
+    dst[x / 4] = packGrayWord(gray[0], gray[1], gray[2], gray[3]);
+  }
+}
+
+static void convertRowGray8(const uint8_t *src, uint32_t *dst, int w) {
+  int x = 0;
+#if defined(IMB_SIMD_AVX2)
+  // byte swap of each dword
+  const __m256i shuffle = _mm256_setr_epi8(
+      3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+      3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  for (; x + 32 <= w; x += 32) {
+    const __m256i gray = _mm256_loadu_si256((const __m256i *)(src + x));
+    _mm256_storeu_si256((__m256i *)(dst + x / 4),
+                        _mm256_shuffle_epi8(gray, shuffle));
+  }
+#endif
+  for (; x + 4 <= w; x += 4) {
+    dst[x / 4] = packGrayWord(src[x], src[x + 1], src[x + 2], src[x + 3]);
+  }
+  if (x < w) {
+    uint32_t gray[4] = {0, 0, 0, 0};
+    for (int i = 0; x + i < w; i++) {
+      gray[i] = src[x + i];
+    }
+    dst[x / 4] = packGrayWord(gray[0], gray[1], gray[2], gray[3]);
+  }
+}
+
+static inline uint32_t getGrayFloat(float val) {
+  val = (val < 0.0F) ? 0.0F : ((val > 255.0F) ? 255.0F : val);
+  return (uint32_t)(val + 0.5F);
+}
+
+static void convertRowFloat(const float *src, uint32_t *dst, int w) {
+  int x = 0;
+#if defined(IMB_SIMD_AVX2)
+  const __m256 valMin = _mm256_setzero_ps();
+  const __m256 valMax = _mm256_set1_ps(255.0F);
+  const __m256 half = _mm256_set1_ps(0.5F);
+  const __m256i shuffle = _mm256_setr_epi8(
+      12, 8, 4, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      12, 8, 4, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  for (; x + 8 <= w; x += 8) {
+    __m256 val = _mm256_loadu_ps(src + x);
+    val = _mm256_min_ps(_mm256_max_ps(val, valMin), valMax);
+    const __m256i gray = _mm256_cvttps_epi32(_mm256_add_ps(val, half));
+    const __m256i words = _mm256_shuffle_epi8(gray, shuffle);
+    dst[x / 4] = (uint32_t)_mm256_extract_epi32(words, 0);
+    dst[x / 4 + 1] = (uint32_t)_mm256_extract_epi32(words, 4);
+  }
+#endif
+  for (; x + 4 <= w; x += 4) {
+    dst[x / 4] = packGrayWord(getGrayFloat(src[x]), getGrayFloat(src[x + 1]),
+                              getGrayFloat(src[x + 2]),
+                              getGrayFloat(src[x + 3]));
+  }
+  if (x < w) {
+    uint32_t gray[4] = {0, 0, 0, 0};
+    for (int i = 0; x + i < w; i++) {
+      gray[i] = getGrayFloat(src[x + i]);
+    }
+    dst[x / 4] = packGrayWord(gray[0], gray[1], gray[2], gray[3]);
+  }
+}
+
+PIX *BmpQImageToPix(const QImage &img) {
+  TRACE_ZONE("grayToPix");
+  const int w = img.width();
+  const int h = img.height();
+  const QImage::Format fmt = img.format();
+  assert((fmt == QImage::Format::Format_RGB32) ||
+         (fmt == QImage::Format::Format_Grayscale8));
+
+  PIX *pix = pixCreateNoInit(w, h, 8);
+  if (pix == nullptr)
+    return nullptr;
+  uint32_t *pixelsDst = pixGetData(pix);
+  const int wpl = pixGetWpl(pix);
+
+  for (int y = 0; y < h; y++) {
+    const uint8_t *lineSrc = img.constScanLine(y);
+    uint32_t *lineDst = pixelsDst + (size_t)y * wpl;
+    if (fmt == QImage::Format::Format_RGB32)
+      convertRowRgb32(lineSrc, lineDst, w);
+    else
+      convertRowGray8(lineSrc, lineDst, w);
+  }  // for y
+  return pix;
+}
+
+PIX *BmpFImageToPix(const FImage &img) {
+  TRACE_ZONE("grayToPix");
+  const int w = img.width();
+  const int h = img.height();
+
+  PIX *pix = pixCreateNoInit(w, h, 8);
+  if (pix == nullptr)
+    return nullptr;
+  uint32_t *pixelsDst = pixGetData(pix);
+  const int wpl = pixGetWpl(pix);
+  const float *pixelsSrc = img.getBits();
+
+  for (int y = 0; y < h; y++) {
+    convertRowFloat(pixelsSrc + (size_t)y * w, pixelsDst + (size_t)y * wpl,
+                    w);
+  }  // for y
+  return pix;
+}
+
 QImage BmpPixToQImage(PIX *pixSrc) {
   const int w = pixGetWidth(pixSrc);
   const int h = pixGetHeight(pixSrc);
@@ -121,6 +278,67 @@ QImage BmpPixToQImage(PIX *pixSrc) {
 
   return image;
 }
+static inline uint32_t swapBytes(uint32_t v) {
+  return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+}
+
+BinImage BmpPixToBinImage(PIX *pixSrc) {
+  TRACE_ZONE("pixToBin");
+  const int w = pixGetWidth(pixSrc);
+  const int h = pixGetHeight(pixSrc);
+  assert(pixGetDepth(pixSrc) == 1);
+  const uint32_t *pixelsSrc = pixGetData(pixSrc);
+  const int wplSrc = pixGetWpl(pixSrc);
+
+  BinImage image(w, h);
+  const int wplDst = image.getWordsPerLine();
+  // valid pixels of the last word: padding bits should stay zero
+  uint64_t maskLast = 0;
+  for (int x = (wplDst - 1) * 64; x < w; x++) {
+    maskLast |= BinImage::getMask(x);
+  }
+
+  for (int y = 0; y < h; y++) {
+    const uint32_t *lineSrc = pixelsSrc + (size_t)y * wplSrc;
+    uint64_t *lineDst = image.getLine(y);
+    for (int i = 0; i < wplDst; i++) {
+      // Leptonica word: leftmost pixel in the most significant bit
+      const uint64_t lo = swapBytes(lineSrc[i * 2]);
+      const uint64_t hi =
+          (i * 2 + 1 < wplSrc) ? swapBytes(lineSrc[i * 2 + 1]) : 0;
+      lineDst[i] = ~(lo | (hi << 32));
+    }
+    lineDst[wplDst - 1] &= maskLast;
+  }  // for y
+  return image;
+}
+
+PIX *BmpBinImageToPix(const BinImage& image) {
+  TRACE_ZONE("binToPix");
+  const int w = image.width();
+  const int h = image.height();
+  PIX *pixDst = pixCreateNoInit(w, h, 1);
+  if (pixDst == nullptr)
+    return nullptr;
+  uint32_t *pixelsDst = pixGetData(pixDst);
+  const int wplDst = pixGetWpl(pixDst);
+  const int wplSrc = image.getWordsPerLine();
+
+  for (int y = 0; y < h; y++) {
+    const uint64_t *lineSrc = image.getLine(y);
+    uint32_t *lineDst = pixelsDst + (size_t)y * wplDst;
+    for (int i = 0; i < wplSrc; i++) {
+      const uint64_t black = ~lineSrc[i];
+      lineDst[i * 2] = swapBytes((uint32_t)black);
+      if (i * 2 + 1 < wplDst)
+        lineDst[i * 2 + 1] = swapBytes((uint32_t)(black >> 32));
+    }
+  }  // for y
+  // inverted zero padding of BinImage became black
+  pixSetPadBits(pixDst, 0);
+  return pixDst;
+}
+
 QImage BmpFzPixToQImage(fz_pixmap *pixSrc) {
   const int w = pixSrc->w;
   const int h = pixSrc->h;
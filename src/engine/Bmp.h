@@ -81,7 +81,22 @@ public:
   uint32_t        m_sizeInMem;
 };
 
+class FImage;
+class BinImage;
+
+// direct 8 bpp gray PIX, without BMP encode / decode.
+// RGB32: gray = (r + g + b) / 3, same as Bmp::initFromQImage
+PIX *BmpQImageToPix(const QImage& img);
+// pixels are rounded and clamped to [0..255]
+PIX *BmpFImageToPix(const FImage& img);
+
 QImage BmpPixToQImage(PIX *pixSrc);
+// 1 bpp PIX (1 is black) to BinImage (1 is white): byte swap and invert
+// of whole words, no per pixel work
+BinImage BmpPixToBinImage(PIX *pixSrc);
+// BinImage to 1 bpp PIX, same word level conversion in other direction.
+// Tesseract takes such PIX as already binarized (no own thresholding)
+PIX *BmpBinImageToPix(const BinImage& image);
 QImage BmpFzPixToQImage(fz_pixmap *pixSrc);
 
 #endif 
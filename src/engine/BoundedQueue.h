@@ -0,0 +1,98 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _BOUNDED_QUEUE_H__
+#define _BOUNDED_QUEUE_H__
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+// Blocking queue with limited capacity between pipeline stages, any number
+// of producers and consumers. Full queue blocks producers (backpressure):
+// fast stage waits for slow one instead of piling up pages in memory.
+template <typename T>
+class BoundedQueue
+{
+public:
+  explicit BoundedQueue(size_t capacity) {
+    m_capacity = (capacity > 0) ? capacity : 1;
+    m_closed = false;
+  }
+
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+  // waits while queue is full. false (item is dropped) if queue is closed
+  bool push(T&& item) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condNotFull.wait(lock, [this] {
+      return m_closed || (m_items.size() < m_capacity);
+    });
+    if (m_closed)
+      return false;
+    m_items.push_back(std::move(item));
+    lock.unlock();
+    m_condNotEmpty.notify_one();
+    return true;
+  }
+
+  // no wait: false (item is untouched) if queue is full or closed
+  bool tryPush(T&& item) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_closed || (m_items.size() >= m_capacity))
+        return false;
+      m_items.push_back(std::move(item));
+    }
+    m_condNotEmpty.notify_one();
+    return true;
+  }
+
+  // waits while queue is empty and not closed. false if queue is closed
+  // and all items are taken
+  bool pop(T& item) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condNotEmpty.wait(lock, [this] {
+      return m_closed || !m_items.empty();
+    });
+    if (m_items.empty())
+      return false;
+    item = std::move(m_items.front());
+    m_items.pop_front();
+    lock.unlock();
+    m_condNotFull.notify_one();
+    return true;
+  }
+
+  // no more items: consumers take the rest, producers are released
+  void close() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_closed = true;
+    }
+    m_condNotEmpty.notify_all();
+    m_condNotFull.notify_all();
+  }
+
+  size_t getSize() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_items.size();
+  }
+  size_t getCapacity() const {
+    return m_capacity;
+  }
+
+private:
+  size_t                    m_capacity;
+  std::mutex                m_mutex;
+  std::condition_variable   m_condNotEmpty;
+  std::condition_variable   m_condNotFull;
+  std::deque<T>             m_items;
+  bool                      m_closed;
+};
+
+#endif
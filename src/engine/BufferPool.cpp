@@ -0,0 +1,117 @@
+//
+// Copyright 2022 Vlad
+//
+
+#include "BufferPool.h"
+
+// default limit for cached memory: enough for a set of float images
+// of a 600 DPI A4 page (about 140 Mb each)
+const int64_t POOL_MAX_CACHED_BYTES_DEFAULT = (int64_t)1024 * 1024 * 1024;
+// buffers up to this size are rounded to power of 2
+const int64_t POOL_SMALL_BUCKET = 4096;
+// larger buffers are rounded to 1/8 of their power of 2 range
+const int POOL_BUCKET_SUBDIV_BITS = 3;
+
+
+BufferPool& BufferPool::instance() {
+  static BufferPool pool;
+  return pool;
+}
+
+BufferPool::BufferPool() {
+  m_cachedBytes = 0;
+  m_maxCachedBytes = POOL_MAX_CACHED_BYTES_DEFAULT;
+  m_numHits = 0;
+  m_numMisses = 0;
+}
+
+BufferPool::~BufferPool() {
+  clear();
+}
+
+int64_t BufferPool::getBucketSize(int64_t numElements) {
+  int64_t sz = 1;
+  while (sz < numElements)
+    sz <<= 1;
+  if (sz <= POOL_SMALL_BUCKET)
+    return sz;
+  // sz is next power of 2: split range (sz/2 .. sz] into
+  // 2^POOL_BUCKET_SUBDIV_BITS steps to limit wasted memory by 12.5%
+  const int64_t step = (sz >> 1) >> POOL_BUCKET_SUBDIV_BITS;
+  return (numElements + step - 1) / step * step;
+}
+
+float* BufferPool::acquire(int64_t numElements) {
+  const int64_t bucket = getBucketSize(numElements);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_freeLists.find(bucket);
+    if ((it != m_freeLists.end()) && !it->second.empty()) {
+      float* buf = it->second.back();
+      it->second.pop_back();
+      m_cachedBytes -= bucket * (int64_t)sizeof(float);
+      m_numHits++;
+      return buf;
+    }
+  }
+  m_numMisses++;
+  return new float[bucket];
+}
+
+void BufferPool::release(float* buf, int64_t numElements) {
+  if (buf == nullptr)
+    return;
+  const int64_t bucket = getBucketSize(numElements);
+  const int64_t numBytes = bucket * (int64_t)sizeof(float);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_cachedBytes + numBytes <= m_maxCachedBytes) {
+      m_freeLists[bucket].push_back(buf);
+      m_cachedBytes += numBytes;
+      return;
+    }
+  }
+  delete[] buf;
+}
+
+void BufferPool::setMaxCachedBytes(int64_t numBytes) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_maxCachedBytes = numBytes;
+  // drop largest buffers first, until fit into new limit
+  for (auto it = m_freeLists.rbegin();
+       (it != m_freeLists.rend()) && (m_cachedBytes > m_maxCachedBytes);
+       ++it) {
+    std::vector<float*>& bufs = it->second;
+    while (!bufs.empty() && (m_cachedBytes > m_maxCachedBytes)) {
+      delete[] bufs.back();
+      bufs.pop_back();
+      m_cachedBytes -= it->first * (int64_t)sizeof(float);
+    }
+  }
+}
+
+int64_t BufferPool::getMaxCachedBytes() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_maxCachedBytes;
+}
+
+int64_t BufferPool::getCachedBytes() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_cachedBytes;
+}
+
+void BufferPool::clear() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto& bucket : m_freeLists) {
+    for (float* buf : bucket.second) {
+      delete[] buf;
+    }
+  }
+  m_freeLists.clear();
+  m_cachedBytes = 0;
+}
+
+void BufferPool::resetCounters() {
+  m_numHits = 0;
+  m_numMisses = 0;
+}
@@ -0,0 +1,64 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _BUFFER_POOL_H__
+#define _BUFFER_POOL_H__
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+// Process-wide cache of float buffers used as FImage storage.
+// Buffers are grouped into size buckets; a released buffer is kept in the
+// free list of its bucket and given back on the next request of the same
+// bucket. So repeated processing of same-sized pages does no heap
+// allocation after the first (warm-up) run.
+class BufferPool
+{
+public:
+  static BufferPool& instance();
+
+  // get buffer for at least numElements floats. Content is uninitialized
+  float*    acquire(int64_t numElements);
+  // return buffer, previously received via acquire(numElements)
+  void      release(float* buf, int64_t numElements);
+
+  // limit of memory, kept in free lists. Extra buffers are deleted on release
+  void      setMaxCachedBytes(int64_t numBytes);
+  int64_t   getMaxCachedBytes() const;
+  int64_t   getCachedBytes() const;
+  // delete all cached (currently not used) buffers
+  void      clear();
+
+  // statistics
+  int64_t   getNumHits() const {
+    return m_numHits;
+  }
+  int64_t   getNumMisses() const {
+    return m_numMisses;
+  }
+  void      resetCounters();
+
+  static int64_t getBucketSize(int64_t numElements);
+
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+private:
+  BufferPool();
+  ~BufferPool();
+
+  mutable std::mutex                        m_mutex;
+  // bucket size (in floats) -> free buffers of this bucket
+  std::map<int64_t, std::vector<float*>>    m_freeLists;
+  int64_t                                   m_cachedBytes;
+  int64_t                                   m_maxCachedBytes;
+
+  std::atomic<int64_t>                      m_numHits;
+  std::atomic<int64_t>                      m_numMisses;
+};
+
+#endif
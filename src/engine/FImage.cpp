@@ -2,15 +2,21 @@
 // Copyright 2022 Vlad
 //
 
+#include <algorithm>
 #include <cassert>
-#include <thread>
+#include <complex>
 #include <vector>
 #include <list>
 
 #include <QtCore/QDebug>
 
 #include "FImage.h"
+#include "BinImage.h"
 #include "ImageConv.h"
+#include "BufferPool.h"
+#include "ThreadPool.h"
+#include "Simd.h"
+#include "Trace.h"
 
 
 FImage::FImage() {
@@ -22,17 +28,18 @@ FImage::FImage() {
 FImage::FImage(int w, int h) {
   m_wImage = w;
   m_hImage = h;
-  m_bits = new float[(int64_t)w * h];
+  m_bits = BufferPool::instance().acquire((int64_t)w * h);
 }
 
 
 FImage::FImage(QImage& imageSrc) {
+  TRACE_ZONE("gray");
   m_wImage = imageSrc.width();
   m_hImage = imageSrc.height();
   assert(m_wImage > 0);
   assert(m_hImage > 0);
   const int numPixels = m_wImage * m_hImage;
-  m_bits = new float[numPixels];
+  m_bits = BufferPool::instance().acquire(numPixels);
   const uchar *pixSrc = imageSrc.bits();
   const QImage::Format fmt = imageSrc.format();
   if ( (fmt == QImage::Format::Format_RGB32) ||
@@ -47,7 +54,29 @@ FImage::FImage(QImage& imageSrc) {
       m_bits[i] = (r + g + b) / 3.0F;
       pixSrc++; // skip a
     } // for i , all pixels
-  } else { // if format is argb32
+  } else if (fmt == QImage::Format::Format_Grayscale8) {
+    // lines are 4 bytes aligned
+    for (int y = 0; y < m_hImage; y++) {
+      const uchar *lineSrc = imageSrc.constScanLine(y);
+      float *lineDst = m_bits + (int64_t)y * m_wImage;
+      for (int x = 0; x < m_wImage; x++) {
+        lineDst[x] = (float)lineSrc[x];
+      }
+    } // for y
+  } else if (fmt == QImage::Format::Format_Mono) {
+    // first pixel is the most significant bit
+    const bool isWhiteOne = (imageSrc.color(1) == qRgb(255, 255, 255));
+    const float valOne = isWhiteOne ? 255.0F : 0.0F;
+    const float valZero = 255.0F - valOne;
+    for (int y = 0; y < m_hImage; y++) {
+      const uchar *lineSrc = imageSrc.constScanLine(y);
+      float *lineDst = m_bits + (int64_t)y * m_wImage;
+      for (int x = 0; x < m_wImage; x++) {
+        const bool isOne = ((lineSrc[x >> 3] >> (7 - (x & 7))) & 1) != 0;
+        lineDst[x] = isOne ? valOne : valZero;
+      }
+    } // for y
+  } else {
     // unsupported format
     assert(fmt == QImage::Format::Format_RGB32);
   }
@@ -57,7 +86,7 @@ FImage::FImage(const FImage& imageSrc) {
   // qInfo() << "FImage copy constructor is called: deep copy";
   m_wImage = imageSrc.m_wImage;
   m_hImage = imageSrc.m_hImage;
-  m_bits = new float[(uint64_t)m_wImage * m_hImage];
+  m_bits = BufferPool::instance().acquire((int64_t)m_wImage * m_hImage);
   memcpy(m_bits, imageSrc.m_bits,
          (uint64_t)m_wImage * m_hImage * sizeof(float));
 }
@@ -89,32 +118,39 @@ QImage FImage::getQImage()
 
 FImage ::~FImage() {
   if (m_bits)
-    delete [] m_bits;
+    BufferPool::instance().release(m_bits, (int64_t)m_wImage * m_hImage);
   m_bits = nullptr;
   m_wImage = m_hImage = 0;
 }
 
 FImage FImage::getWindowedMean(int winSize) {
-  FImage imageDst(*this);
+  FImage imageDst(m_wImage, m_hImage);
   ImageConvolutions::getWindowedMean(*this, imageDst, winSize);
   return imageDst;
 }
 
 FImage FImage::getWindowedStdDev(const FImage& imageFloatMean,
                                  int winSize) {
-  FImage imageDst(*this);
+  FImage imageDst(m_wImage, m_hImage);
   ImageConvolutions::getWindowedStdDev(*this, imageFloatMean, imageDst,
                                        winSize);
   return imageDst;
 }
 FImage FImage::getSauvolaThreshold(const FImage& imageFloatStdDev, float factor) {
-  FImage imageDst(*this);
+  FImage imageDst(m_wImage, m_hImage);
   ImageConvolutions::getSauvolaThreshold(*this, imageFloatStdDev,
                                          factor, imageDst);
   return imageDst;
 }
 FImage FImage::applyThresholds(const FImage& imageFloatThresholds) {
-  FImage imageDst(*this);
+  FImage imageDst(m_wImage, m_hImage);
+  ImageConvolutions::applyThresholds(*this, imageFloatThresholds,
+                                     imageDst);
+  return imageDst;
+}
+
+BinImage FImage::applyThresholdsBin(const FImage& imageFloatThresholds) {
+  BinImage imageDst(m_wImage, m_hImage);
   ImageConvolutions::applyThresholds(*this, imageFloatThresholds,
                                      imageDst);
   return imageDst;
@@ -152,9 +188,41 @@ FImage getGaussianKernel(const int w, const int h, const float sigma) {
   return image;
 }
 
-FImage FImage::getGaussSmooth(FImage &imageKernel, float *timeMsec) const {
+FImage getGaussianKernel1D(const int w, const float sigma) {
+  assert((w & 1) == 1);
+
+  const int xc = w / 2;
+  FImage image(w, 1);
+  float *mat = image.getBits();
+
+  float ks = 1.0F / (2 * sigma * sigma);
+
+  float sum = 0.0F;
+  for (int x = 0; x < w; x++) {
+    float dx = (xc > 0) ? (float)(x - xc) / xc : 0.0F;
+    float we = expf(-(dx * dx) * ks);
+    mat[x] = we;
+    sum += we;
+  }  // for x
+  // normalize
+  float scale = 1.0F / sum;
+  for (int x = 0; x < w; x++) {
+    mat[x] = mat[x] * scale;
+  }
+  return image;
+}
+
+FImage getGaussianKernel1DPx(const float sigmaPx) {
+  const int rad = (int)ceilf(3.0F * sigmaPx);
+  if (rad < 1)
+    return getGaussianKernel1D(1, 1.0F);
+  // getGaussianKernel1D sigma is relative to kernel radius
+  return getGaussianKernel1D(rad * 2 + 1, sigmaPx / rad);
+}
+
+FImage FImage::getGaussSmooth(FImage &imageKernel) const {
   // init result
-  FImage imageDst(*this);
+  FImage imageDst(m_wImage, m_hImage);
   float *matDst = imageDst.getBits();
   const float *matGauss = imageKernel.getBits();
   const float *matImage = getBits();
@@ -166,9 +234,7 @@ FImage FImage::getGaussSmooth(FImage &imageKernel, float *timeMsec) const {
   const int xRad = wGauss / 2;
   const int yRad = hGauss / 2;
 
-  // timing
-  std::chrono::high_resolution_clock::time_point timeS, timeE;
-  timeS = std::chrono::high_resolution_clock::now();
+  TRACE_ZONE("gaussSmooth");
 
   int k = 0; // dest index
   for (int y = 0; y < m_hImage; y++) {
@@ -203,13 +269,6 @@ FImage FImage::getGaussSmooth(FImage &imageKernel, float *timeMsec) const {
     } // for x
   } // for y
 
-  // timing
-  timeE = std::chrono::high_resolution_clock::now();
-  std::chrono::duration<double, std::milli> timeSpan = timeE - timeS;
-  auto difMs = (float)timeSpan.count();
-  if (timeMsec != nullptr) 
-    *timeMsec = difMs;
-
   return imageDst;
 }
 
@@ -255,63 +314,465 @@ static void gaussProcessRows( const float *matSrc,
   } // for y, all rows
 } // end process rows
 
-FImage FImage::getGaussSmoothViaThreads(FImage &imageKernel,
-                                        float *timeMsec) const {
+FImage FImage::getGaussSmoothViaThreads(FImage &imageKernel) const {
   // init result image
-  FImage imageDst(*this);
-
-  // timing
-  std::chrono::high_resolution_clock::time_point timeS, timeE;
-  timeS = std::chrono::high_resolution_clock::now();
-
-
-  const int numCpuCores = std::thread::hardware_concurrency();
-  const int numPrc = (numCpuCores - 2 >= 1) ? numCpuCores - 2: 1;
-  // divide height by numPrc and 
-  // use parallel threads to speed up
-  if (numPrc >= 2) {
-    const int numParts = numPrc;
-    float *matSrc = m_bits;
-    float *matDst = imageDst.getBits();
-    float *matKernel = imageKernel.getBits();
-    const int wSrc = m_wImage;
-    const int hSrc = m_hImage;
-    const int wKernel = imageKernel.width();
-
-    std::vector<std::thread> vecThreads;
-
-    int yStart = 0;
-    for (int i = 0; i < numParts; i++) {
-      // calculate end of image part (low row)
-      const int yEnd = (i + 1) * m_hImage / numParts;
-      std::thread th(gaussProcessRows, matSrc, matKernel, matDst, wSrc, hSrc,
-                     wKernel, yStart, yEnd);
-      vecThreads.push_back(std::move(th));
-      //  next part of image
-      yStart = yEnd;
+  FImage imageDst(m_wImage, m_hImage);
+
+  TRACE_ZONE("gaussSmoothThreads");
+
+  // process image rows on engine thread pool
+  const float *matSrc = m_bits;
+  float *matDst = imageDst.getBits();
+  const float *matKernel = imageKernel.getBits();
+  const int wSrc = m_wImage;
+  const int hSrc = m_hImage;
+  const int wKernel = imageKernel.width();
+
+  ThreadPool::instance().parallelFor(0, m_hImage,
+                                     [=](int yStart, int yEnd) {
+    gaussProcessRows(matSrc, matKernel, matDst, wSrc, hSrc, wKernel, yStart,
+                     yEnd);
+  });
+
+  return imageDst;
+}
+
+
+// dst[x] = sum(kernel[t] * src[x + t]), t in [0 .. wKernel),
+// x in [xStart .. xEnd)
+static void gaussConvolveSpan(const float *src, const float *matKernel,
+                              const int wKernel, float *dst,
+                              const int xStart, const int xEnd) {
+  int x = xStart;
+#if defined(IMB_SIMD_AVX2)
+  for (; x + 8 <= xEnd; x += 8) {
+    __m256 acc = _mm256_setzero_ps();
+    for (int t = 0; t < wKernel; t++) {
+      const __m256 v = _mm256_loadu_ps(src + x + t);
+      acc = _mm256_add_ps(acc, _mm256_mul_ps(v, _mm256_set1_ps(matKernel[t])));
+    }
+    _mm256_storeu_ps(dst + x, acc);
+  }
+#elif defined(IMB_SIMD_SSE2)
+  for (; x + 4 <= xEnd; x += 4) {
+    __m128 acc = _mm_setzero_ps();
+    for (int t = 0; t < wKernel; t++) {
+      const __m128 v = _mm_loadu_ps(src + x + t);
+      acc = _mm_add_ps(acc, _mm_mul_ps(v, _mm_set1_ps(matKernel[t])));
     }
-    // run threads and process all image parts simultaneously
-    for (auto &t: vecThreads) {
-      t.join();
+    _mm_storeu_ps(dst + x, acc);
+  }
+#endif
+  for (; x < xEnd; x++) {
+    float sum = 0.0F;
+    for (int t = 0; t < wKernel; t++) {
+      sum += src[x + t] * matKernel[t];
+    }
+    dst[x] = sum;
+  }
+}
+
+// horizontal pass for rows [yStart .. yEnd)
+static void gaussSeparableRowsH(const float *matSrc, const float *matKernel,
+                                float *matDst, const int wSrc,
+                                const int wKernel, const int yStart,
+                                const int yEnd) {
+  const int rad = wKernel / 2;
+  // interior: window fits into row
+  const int xInStart = (rad < wSrc) ? rad : wSrc;
+  const int xInEnd = (wSrc - rad > xInStart) ? wSrc - rad : xInStart;
+
+  for (int y = yStart; y < yEnd; y++) {
+    const float *src = matSrc + (int64_t)y * wSrc;
+    float *dst = matDst + (int64_t)y * wSrc;
+
+    // border pixels: skip outside taps and renormalize
+    auto processBorderPixel = [=](int x) {
+      float sum = 0.0F, sumWeights = 0.0F;
+      for (int dx = -rad; dx <= rad; dx++) {
+        const int xx = x + dx;
+        if ((xx < 0) || (xx >= wSrc))
+          continue;
+        const float we = matKernel[dx + rad];
+        sum += src[xx] * we;
+        sumWeights += we;
+      }
+      dst[x] = sum / sumWeights;
+    };
+    for (int x = 0; x < xInStart; x++) {
+      processBorderPixel(x);
+    }
+    for (int x = xInEnd; x < wSrc; x++) {
+      processBorderPixel(x);
+    }
+
+    // interior pixels: no checks, kernel is normalized
+    gaussConvolveSpan(src - rad, matKernel, wKernel, dst, xInStart, xInEnd);
+  }  // for y
+}
+
+// vertical pass for rows [yStart .. yEnd). Taps outside image are
+// skipped with renormalization, which is the same for the whole row
+static void gaussSeparableRowsV(const float *matSrc, const float *matKernel,
+                                float *matDst, const int wSrc,
+                                const int hSrc, const int wKernel,
+                                const int yStart, const int yEnd) {
+  const int rad = wKernel / 2;
+  for (int y = yStart; y < yEnd; y++) {
+    float *dst = matDst + (int64_t)y * wSrc;
+    const int tMin = (y - rad < 0) ? rad - y : 0;
+    const int tMax = (y + rad >= hSrc) ? rad + (hSrc - 1 - y) : wKernel - 1;
+    const bool isBorder = (tMin > 0) || (tMax < wKernel - 1);
+
+    float sumWeights = 0.0F;
+    for (int t = tMin; t <= tMax; t++) {
+      sumWeights += matKernel[t];
+    }
+    const float scale = isBorder ? 1.0F / sumWeights : 1.0F;
+
+    int x = 0;
+#if defined(IMB_SIMD_AVX2)
+    const __m256 scale8 = _mm256_set1_ps(scale);
+    for (; x + 8 <= wSrc; x += 8) {
+      __m256 acc = _mm256_setzero_ps();
+      for (int t = tMin; t <= tMax; t++) {
+        const float *src = matSrc + (int64_t)(y - rad + t) * wSrc;
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(src + x),
+                                               _mm256_set1_ps(matKernel[t])));
+      }
+      _mm256_storeu_ps(dst + x, _mm256_mul_ps(acc, scale8));
+    }
+#elif defined(IMB_SIMD_SSE2)
+    const __m128 scale4 = _mm_set1_ps(scale);
+    for (; x + 4 <= wSrc; x += 4) {
+      __m128 acc = _mm_setzero_ps();
+      for (int t = tMin; t <= tMax; t++) {
+        const float *src = matSrc + (int64_t)(y - rad + t) * wSrc;
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(src + x),
+                                         _mm_set1_ps(matKernel[t])));
+      }
+      _mm_storeu_ps(dst + x, _mm_mul_ps(acc, scale4));
+    }
+#endif
+    for (; x < wSrc; x++) {
+      float sum = 0.0F;
+      for (int t = tMin; t <= tMax; t++) {
+        sum += matSrc[(int64_t)(y - rad + t) * wSrc + x] * matKernel[t];
+      }
+      dst[x] = sum * scale;
+    }
+  }  // for y
+}
+
+FImage FImage::getGaussSmoothSeparable(
+    const FImage &imageKernel1D) const {
+  assert(imageKernel1D.height() == 1);
+  assert((imageKernel1D.width() & 1) == 1);
+
+  FImage imageTmp(m_wImage, m_hImage);
+  FImage imageDst(m_wImage, m_hImage);
+
+  TRACE_ZONE("gaussSmoothSeparable");
+
+  const float *matSrc = m_bits;
+  float *matTmp = imageTmp.getBits();
+  float *matDst = imageDst.getBits();
+  const float *matKernel = imageKernel1D.getBits();
+  const int wSrc = m_wImage;
+  const int hSrc = m_hImage;
+  const int wKernel = imageKernel1D.width();
+
+  ThreadPool::instance().parallelFor(0, m_hImage,
+                                     [=](int yStart, int yEnd) {
+    gaussSeparableRowsH(matSrc, matKernel, matTmp, wSrc, wKernel, yStart,
+                        yEnd);
+  });
+  ThreadPool::instance().parallelFor(0, m_hImage,
+                                     [=](int yStart, int yEnd) {
+    gaussSeparableRowsV(matTmp, matKernel, matDst, wSrc, hSrc, wKernel,
+                        yStart, yEnd);
+  });
+
+  return imageDst;
+}
+
+// Deriche 4th order recursive gauss: sum of causal and anticausal parts
+// causal:     yp[n] = sum(k=0..3) n_k x[n-k] - sum(k=1..4) d_k yp[n-k]
+// anticausal: ym[n] = sum(k=1..4) m_k x[n+k] - sum(k=1..4) d_k ym[n+k]
+// Poles are close to 1 for large sigma, so coefficients and recursion state
+// are kept in double: float rounding would shift the filter gain
+struct GaussIirCoeffs {
+  double n[4];
+  double m[5];      // m[0] unused
+  double d[5];      // d[0] == 1, unused
+  double gainP;     // causal response to constant 1
+  double gainM;     // anticausal response to constant 1
+};
+
+static GaussIirCoeffs getGaussIirCoeffs(float sigmaPx) {
+  using Complex = std::complex<double>;
+  const double sigma = (sigmaPx < 0.5F) ? 0.5 : sigmaPx;
+  // Deriche 1993 fit: h(n) = (a0 cos(w0 n / s) + a1 sin(w0 n / s)) *
+  //   exp(-b0 n / s) + (c0 cos(w1 n / s) + c1 sin(w1 n / s)) * exp(-b1 n / s)
+  const double a0 = 1.680, a1 = 3.735, b0 = 1.783, w0 = 0.6318;
+  const double c0 = -0.6803, c1 = -0.2598, b1 = 1.723, w1 = 1.997;
+
+  // causal impulse response as sum(k) alpha_k * pole_k ^ n
+  Complex alpha[4], pole[4];
+  pole[0] = std::exp(Complex(-b0 / sigma, w0 / sigma));
+  pole[1] = std::conj(pole[0]);
+  pole[2] = std::exp(Complex(-b1 / sigma, w1 / sigma));
+  pole[3] = std::conj(pole[2]);
+  alpha[0] = Complex(a0, -a1) * 0.5;
+  alpha[1] = std::conj(alpha[0]);
+  alpha[2] = Complex(c0, -c1) * 0.5;
+  alpha[3] = std::conj(alpha[2]);
+
+  // denominator: prod(k) (1 - pole_k z^-1)
+  Complex den[5] = {1.0, 0.0, 0.0, 0.0, 0.0};
+  for (int k = 0; k < 4; k++) {
+    for (int i = k + 1; i >= 1; i--) {
+      den[i] -= pole[k] * den[i - 1];
     }
-  } else {
-    // in case of single - thread PC, use default, slow function
-    return this->getGaussSmooth(imageKernel, timeMsec);
   }
+  // numerator: sum(k) alpha_k * prod(j != k) (1 - pole_j z^-1)
+  Complex num[4] = {0.0, 0.0, 0.0, 0.0};
+  for (int k = 0; k < 4; k++) {
+    Complex t[4] = {1.0, 0.0, 0.0, 0.0};
+    int order = 0;
+    for (int j = 0; j < 4; j++) {
+      if (j == k)
+        continue;
+      order++;
+      for (int i = order; i >= 1; i--) {
+        t[i] -= pole[j] * t[i - 1];
+      }
+    }
+    for (int i = 0; i < 4; i++) {
+      num[i] += alpha[k] * t[i];
+    }
+  }  // for k
 
-  // timing
-  timeE = std::chrono::high_resolution_clock::now();
-  std::chrono::duration<double, std::milli> timeSpan = timeE - timeS;
-  auto difMs = (float)timeSpan.count();
-  if (timeMsec != nullptr)
-    *timeMsec= difMs;
+  double n[4], m[5], d[5];
+  for (int i = 0; i < 5; i++) {
+    d[i] = den[i].real();
+  }
+  for (int i = 0; i < 4; i++) {
+    n[i] = num[i].real();
+  }
+  // anticausal part is the mirrored causal one without its center tap
+  m[0] = 0.0;
+  for (int i = 1; i < 4; i++) {
+    m[i] = n[i] - d[i] * n[0];
+  }
+  m[4] = -d[4] * n[0];
+
+  // normalize to unit gain
+  double sumN = 0.0, sumM = 0.0, sumD = 0.0;
+  for (int i = 0; i < 5; i++) {
+    sumN += (i < 4) ? n[i] : 0.0;
+    sumM += m[i];
+    sumD += d[i];
+  }
+  const double scale = sumD / (sumN + sumM);
+
+  GaussIirCoeffs coeffs;
+  for (int i = 0; i < 5; i++) {
+    if (i < 4)
+      coeffs.n[i] = n[i] * scale;
+    coeffs.m[i] = m[i] * scale;
+    coeffs.d[i] = d[i];
+  }
+  coeffs.gainP = sumN * scale / sumD;
+  coeffs.gainM = sumM * scale / sumD;
+  return coeffs;
+}
+
+// rows [yStart, yEnd) of src into dst; borders are replicated.
+// Recursion is a serial dependency chain along x, so NUM_LANES rows are
+// filtered together to keep independent chains in flight
+static void gaussIirRowsH(const float *matSrc, float *matDst,
+                          const GaussIirCoeffs &co, int wSrc, int yStart,
+                          int yEnd) {
+  const int NUM_LANES = 4;
+  const double n0 = co.n[0], n1 = co.n[1], n2 = co.n[2], n3 = co.n[3];
+  const double m1 = co.m[1], m2 = co.m[2], m3 = co.m[3], m4 = co.m[4];
+  const double d1 = co.d[1], d2 = co.d[2], d3 = co.d[3], d4 = co.d[4];
+
+  for (int y = yStart; y < yEnd; y += NUM_LANES) {
+    const int numLanes = std::min(NUM_LANES, yEnd - y);
+    const float *src[NUM_LANES];
+    float *dst[NUM_LANES];
+    for (int k = 0; k < NUM_LANES; k++) {
+      // missing lanes repeat the last row, their result is not stored
+      const int yy = y + std::min(k, numLanes - 1);
+      src[k] = matSrc + (size_t)yy * wSrc;
+      dst[k] = matDst + (size_t)yy * wSrc;
+    }
+    double x1[NUM_LANES], x2[NUM_LANES], x3[NUM_LANES], x4[NUM_LANES];
+    double y1[NUM_LANES], y2[NUM_LANES], y3[NUM_LANES], y4[NUM_LANES];
+
+    // causal, history in steady state of the first pixel
+    for (int k = 0; k < NUM_LANES; k++) {
+      x1[k] = x2[k] = x3[k] = src[k][0];
+      y1[k] = y2[k] = y3[k] = y4[k] = src[k][0] * co.gainP;
+    }
+    for (int x = 0; x < wSrc; x++) {
+      for (int k = 0; k < NUM_LANES; k++) {
+        const double x0 = src[k][x];
+        const double y0 = n0 * x0 + n1 * x1[k] + n2 * x2[k] + n3 * x3[k] -
+                          d1 * y1[k] - d2 * y2[k] - d3 * y3[k] - d4 * y4[k];
+        if (k < numLanes)
+          dst[k][x] = (float)y0;
+        x3[k] = x2[k]; x2[k] = x1[k]; x1[k] = x0;
+        y4[k] = y3[k]; y3[k] = y2[k]; y2[k] = y1[k]; y1[k] = y0;
+      }
+    }  // for x, causal
+
+    // anticausal, history in steady state of the last pixel
+    for (int k = 0; k < NUM_LANES; k++) {
+      x1[k] = x2[k] = x3[k] = x4[k] = src[k][wSrc - 1];
+      y1[k] = y2[k] = y3[k] = y4[k] = src[k][wSrc - 1] * co.gainM;
+    }
+    for (int x = wSrc - 1; x >= 0; x--) {
+      for (int k = 0; k < NUM_LANES; k++) {
+        const double y0 = m1 * x1[k] + m2 * x2[k] + m3 * x3[k] +
+                          m4 * x4[k] - d1 * y1[k] - d2 * y2[k] -
+                          d3 * y3[k] - d4 * y4[k];
+        if (k < numLanes)
+          dst[k][x] += (float)y0;
+        x4[k] = x3[k]; x3[k] = x2[k]; x2[k] = x1[k]; x1[k] = src[k][x];
+        y4[k] = y3[k]; y3[k] = y2[k]; y2[k] = y1[k]; y1[k] = y0;
+      }
+    }  // for x, anticausal
+  }  // for y
+}
+
+// columns [xStart, xEnd) of src into dst; borders are replicated.
+// Each row step updates the whole column strip, so memory is read row by
+// row and the inner loops vectorize over x
+static void gaussIirColsV(const float *matSrc, float *matDst,
+                          const GaussIirCoeffs &co, int wSrc, int hSrc,
+                          int xStart, int xEnd) {
+  const int numCols = xEnd - xStart;
+  const float *colSrc = matSrc + xStart;
+  float *colDst = matDst + xStart;
+
+  // replicated border rows and ring of the last 4 filtered rows
+  std::vector<float> borderX(numCols);
+  std::vector<double> buffer((size_t)numCols * 5);
+  double *borderY = buffer.data();
+  double *ring = borderY + numCols;
+
+  auto getSrcRow = [&](int y) -> const float * {
+    return ((y >= 0) && (y < hSrc)) ? colSrc + (size_t)y * wSrc
+                                    : borderX.data();
+  };
+  // y + 4 and y share the ring row: each x is read before it is written
+  auto getRingRow = [&](int y) -> double * {
+    return ((y >= 0) && (y < hSrc)) ? ring + (size_t)(y & 3) * numCols
+                                    : borderY;
+  };
+
+  // causal
+  for (int x = 0; x < numCols; x++) {
+    borderX[x] = colSrc[x];
+    borderY[x] = colSrc[x] * co.gainP;
+  }
+  for (int y = 0; y < hSrc; y++) {
+    const float *x0 = getSrcRow(y);
+    const float *x1 = getSrcRow(y - 1);
+    const float *x2 = getSrcRow(y - 2);
+    const float *x3 = getSrcRow(y - 3);
+    const double *y1 = getRingRow(y - 1);
+    const double *y2 = getRingRow(y - 2);
+    const double *y3 = getRingRow(y - 3);
+    const double *y4 = getRingRow(y - 4);
+    double *y0 = ring + (size_t)(y & 3) * numCols;
+    float *dst = colDst + (size_t)y * wSrc;
+    for (int x = 0; x < numCols; x++) {
+      const double val = co.n[0] * x0[x] + co.n[1] * x1[x] +
+                         co.n[2] * x2[x] + co.n[3] * x3[x] -
+                         co.d[1] * y1[x] - co.d[2] * y2[x] -
+                         co.d[3] * y3[x] - co.d[4] * y4[x];
+      y0[x] = val;
+      dst[x] = (float)val;
+    }
+  }  // for y, causal
+
+  // anticausal
+  const float *last = colSrc + (size_t)(hSrc - 1) * wSrc;
+  for (int x = 0; x < numCols; x++) {
+    borderX[x] = last[x];
+    borderY[x] = last[x] * co.gainM;
+  }
+  for (int y = hSrc - 1; y >= 0; y--) {
+    const float *x1 = getSrcRow(y + 1);
+    const float *x2 = getSrcRow(y + 2);
+    const float *x3 = getSrcRow(y + 3);
+    const float *x4 = getSrcRow(y + 4);
+    const double *y1 = getRingRow(y + 1);
+    const double *y2 = getRingRow(y + 2);
+    const double *y3 = getRingRow(y + 3);
+    const double *y4 = getRingRow(y + 4);
+    double *y0 = ring + (size_t)(y & 3) * numCols;
+    float *dst = colDst + (size_t)y * wSrc;
+    for (int x = 0; x < numCols; x++) {
+      const double val = co.m[1] * x1[x] + co.m[2] * x2[x] +
+                         co.m[3] * x3[x] + co.m[4] * x4[x] -
+                         co.d[1] * y1[x] - co.d[2] * y2[x] -
+                         co.d[3] * y3[x] - co.d[4] * y4[x];
+      y0[x] = val;
+      dst[x] += (float)val;
+    }
+  }  // for y, anticausal
+}
+
+FImage FImage::getGaussSmoothIir(float sigmaPx) const {
+  // columns per vertical strip: history rows of a strip stay in L1
+  const int STRIP_COLS = 64;
+
+  FImage imageTmp(m_wImage, m_hImage);
+  FImage imageDst(m_wImage, m_hImage);
+
+  TRACE_ZONE("gaussSmoothIir");
+
+  const GaussIirCoeffs coeffs = getGaussIirCoeffs(sigmaPx);
+  const float *matSrc = m_bits;
+  float *matTmp = imageTmp.getBits();
+  float *matDst = imageDst.getBits();
+  const int wSrc = m_wImage;
+  const int hSrc = m_hImage;
+
+  if ((wSrc > 0) && (hSrc > 0)) {
+    ThreadPool::instance().parallelFor(0, hSrc,
+                                       [=](int yStart, int yEnd) {
+      gaussIirRowsH(matSrc, matTmp, coeffs, wSrc, yStart, yEnd);
+    });
+    const int numStrips = (wSrc + STRIP_COLS - 1) / STRIP_COLS;
+    ThreadPool::instance().parallelFor(0, numStrips,
+                                       [=](int sStart, int sEnd) {
+      for (int s = sStart; s < sEnd; s++) {
+        const int xStart = s * STRIP_COLS;
+        const int xEnd = std::min(xStart + STRIP_COLS, wSrc);
+        gaussIirColsV(matTmp, matDst, coeffs, wSrc, hSrc, xStart, xEnd);
+      }
+    });
+  }
 
   return imageDst;
 }
 
+FImage FImage::getGaussSmoothSigma(float sigmaPx) const {
+  if (sigmaPx >= cGaussIirSigmaMin)
+    return getGaussSmoothIir(sigmaPx);
+  FImage imageKernel1D = getGaussianKernel1DPx(sigmaPx);
+  return getGaussSmoothSeparable(imageKernel1D);
+}
 
 FImage FImage::getIntegralImage() const { 
-  FImage imageDst(*this);
+  TRACE_ZONE("integral");
+  FImage imageDst(m_wImage, m_hImage);
 
   const float *pixelsSrc = this->getBits();
   float *pixelsDst = imageDst.getBits();
@@ -362,7 +823,8 @@ float FImage::getSum(int xMin, int yMin, int xMax,
 }
 
 FImage FImage::getIntegralImage2() const {
-  FImage imageDst(*this);
+  TRACE_ZONE("integral2");
+  FImage imageDst(m_wImage, m_hImage);
 
   const float *pixelsSrc = this->getBits();
   float *pixelsDst = imageDst.getBits();
@@ -7,11 +7,15 @@
 
 #include <QtGui/QImage>
 
+class BinImage;
+
 class FImage
 {
 public:
   FImage();
+  // pixels are not initialized: storage is taken from BufferPool
   explicit FImage(int w, int h);
+  // RGB32, ARGB32, Grayscale8 or Mono (0 / 255) source
   explicit FImage(QImage& imageSrc);
 
   // copy constructor
@@ -38,6 +42,8 @@ public:
   FImage getWindowedStdDev(const FImage& imageFloatMean, int winSize);
   FImage getSauvolaThreshold(const FImage& imageFloatStdDev, float factor);
   FImage applyThresholds(const FImage& imageFloatThresholds);
+  // same, 1 bit per pixel result
+  BinImage applyThresholdsBin(const FImage& imageFloatThresholds);
 
   // interface to optimized stddev image calculation
   FImage getIntegralImage() const;
@@ -46,8 +52,19 @@ public:
   float  getSum2(int xMin, int yMin, int xMax, int yMax) const;
 
   // gauss smooth
-  FImage getGaussSmooth(FImage& imageKernel, float* timeMsec = nullptr) const;
-  FImage getGaussSmoothViaThreads(FImage& imageKernel, float *timeMsec = nullptr) const;
+  // reference implementation: full 2d kernel
+  FImage getGaussSmooth(FImage& imageKernel) const;
+  FImage getGaussSmoothViaThreads(FImage& imageKernel) const;
+  // separable: horizontal, then vertical pass with 1d kernel
+  // (see getGaussianKernel1D), SIMD and thread pool. Same result as
+  // getGaussSmooth with the 2d kernel of the same size and sigma
+  FImage getGaussSmoothSeparable(const FImage& imageKernel1D) const;
+  // recursive (IIR, Deriche 4th order) approximation, cost does not
+  // depend on sigma. Sigma is in pixels. Borders are replicated
+  FImage getGaussSmoothIir(float sigmaPx) const;
+  // sigma in pixels: separable FIR for small sigma, IIR from
+  // cGaussIirSigmaMin
+  FImage getGaussSmoothSigma(float sigmaPx) const;
 
 
 private:
@@ -57,6 +74,14 @@ private:
 };
 
 FImage    getGaussianKernel(int w, int h, float sigma);
+// 1d kernel (w x 1), 2d kernel of getGaussianKernel is its outer product
+FImage    getGaussianKernel1D(int w, float sigma);
+// 1d kernel with sigma in pixels, size covers +-3 sigma
+FImage    getGaussianKernel1DPx(float sigmaPx);
+
+// sigma (pixels) from which IIR gauss is faster than separable FIR
+// (see TestInterface::testGaussIir benchmark)
+constexpr float cGaussIirSigmaMin = 8.0F;
 
 
 #endif
\ No newline at end of file
@@ -1,76 +1,230 @@
  
 
+ #include <cassert>
+
  #include "FastMeanStd.h"
+ #include "ParallelRows.h"
+ #include "Trace.h"
 
- void FastMeanStd::getFastMeanStd( const FImage& imageSrc,
-                                  FImage& imageMean,
-                                  FImage& imageStd,
-                                  int neibSize) {
-  FImage imageSum = imageSrc.getIntegralImage();
-  FImage imageSum2 = imageSrc.getIntegralImage2();
+// Window mean and std dev by float integral images
+class FloatWindowSums {
+public:
+  explicit FloatWindowSums(const FImage& imageSrc)
+      : m_imageSum(imageSrc.getIntegralImage()),
+        m_imageSum2(imageSrc.getIntegralImage2()) {}
+
+  void getMeanStd(int xMin, int yMin, int xMax, int yMax, float& mean,
+                  float& std) const {
+    const int numPixInNeib = (xMax - xMin + 1) * (yMax - yMin + 1);
+    const float sumVal = m_imageSum.getSum(xMin, yMin, xMax, yMax);
+    const float sumVal2 = m_imageSum2.getSum2(xMin, yMin, xMax, yMax);
+    mean = sumVal / numPixInNeib;
+    std = sumVal2 - 2.0F * mean * sumVal + mean * mean * numPixInNeib;
+    std = sqrtf(std / numPixInNeib);
+  }
+
+private:
+  FImage m_imageSum;
+  FImage m_imageSum2;
+};
+
+// Window mean and std dev by exact integer integral images
+class ExactWindowSums {
+public:
+  explicit ExactWindowSums(const IntegralImage& integral)
+      : m_integral(integral) {}
+
+  void getMeanStd(int xMin, int yMin, int xMax, int yMax, float& mean,
+                  float& std) const {
+    const double numPixInNeib = (double)(xMax - xMin + 1) * (yMax - yMin + 1);
+    const double sumVal = m_integral.getSum(xMin, yMin, xMax, yMax);
+    const double sumVal2 = (double)m_integral.getSum2(xMin, yMin, xMax, yMax);
+    const double m = sumVal / numPixInNeib;
+    const double var = sumVal2 / numPixInNeib - m * m;
+    mean = (float)m;
+    std = (var > 0.0) ? (float)sqrt(var) : 0.0F;
+  }
+
+private:
+  const IntegralImage& m_integral;
+};
+
+// Per-pixel stage for rows [yStart .. yEnd): op(k, x, y, mean, std) is
+// called for every pixel k = y * w + x, in row order. Window bounds are clamped only for border pixels,
+// interior pixels use the whole window without any checks
+template <typename TWindowSums, typename TPixelOp>
+static void processRows(const TWindowSums& sums, const int w, const int h,
+                        const int ns2, const int yStart, const int yEnd,
+                        const TPixelOp& op) {
+  // interior columns: window fits into image horizontally
+  const int xInStart = (ns2 < w) ? ns2 : w;
+  const int xInEnd = (w - ns2 > xInStart) ? w - ns2 : xInStart;
+
+  float mean, std;
+  for (int y = yStart; y < yEnd; y++) {
+    const int yMin = (y - ns2 < 0) ? 0 : y - ns2;
+    const int yMax = (y + ns2 >= h) ? h - 1 : y + ns2;
+    int k = y * w;  // dest index
+
+    // left border
+    for (int x = 0; x < xInStart; x++, k++) {
+      const int xMax = (x + ns2 >= w) ? w - 1 : x + ns2;
+      sums.getMeanStd(0, yMin, xMax, yMax, mean, std);
+      op(k, x, y, mean, std);
+    }
+    // interior
+    for (int x = xInStart; x < xInEnd; x++, k++) {
+      sums.getMeanStd(x - ns2, yMin, x + ns2, yMax, mean, std);
+      op(k, x, y, mean, std);
+    }
+    // right border
+    for (int x = xInEnd; x < w; x++, k++) {
+      const int xMin = (x - ns2 < 0) ? 0 : x - ns2;
+      sums.getMeanStd(xMin, yMin, w - 1, yMax, mean, std);
+      op(k, x, y, mean, std);
+    }
+  }  // for y
+}
+
+template <typename TWindowSums>
+static void meanStd(const TWindowSums& sums, const int w, const int h,
+                    const int neibSize, FImage& imageMean,
+                    FImage& imageStd) {
+  assert((neibSize & 1) == 1);  // check this is odd value
+  const int ns2 = neibSize / 2;
+
+  float* pixMean = imageMean.getBits();
+  float* pixStd = imageStd.getBits();
 
-  assert((neibSize & 1) == 1); // check this is odd value
+  ParallelRows::run(h, ParallelRows::getNumBands(h),
+                    [&](int, int yStart, int yEnd) {
+    processRows(sums, w, h, ns2, yStart, yEnd,
+                [pixMean, pixStd](int k, int, int, float mean, float std) {
+      pixMean[k] = mean;
+      pixStd[k] = std;
+    });
+  });
+}
+
+template <typename TWindowSums>
+static void sauvolaFused(const TWindowSums& sums, const FImage& imageSrc,
+                         const int neibSize, const float factor,
+                         FImage& imageDst, FImage* imageMean,
+                         FImage* imageStd, FImage* imageThresholds) {
+  assert((neibSize & 1) == 1);  // check this is odd value
   const int ns2 = neibSize / 2;
 
   const int w = imageSrc.width();
   const int h = imageSrc.height();
 
-  float* pixMean = imageMean.getBits();
-  float* pixStd = imageStd.getBits();
+  const float* pixSrc = imageSrc.getBits();
+  float* pixDst = imageDst.getBits();
+  float* pixMean = (imageMean != nullptr) ? imageMean->getBits() : nullptr;
+  float* pixStd = (imageStd != nullptr) ? imageStd->getBits() : nullptr;
+  float* pixThr =
+      (imageThresholds != nullptr) ? imageThresholds->getBits() : nullptr;
 
-  int k = 0; // dest index
-  for (int y = 0; y < h; y++) {
-    for (int x = 0; x < w; x++) {
-      int xMin = x - ns2;
-      if (xMin < 0)
-        xMin = 0;
-      int xMax = x + ns2;
-      if (xMax >= w)
-        xMax = w - 1;
-      int yMin = y - ns2;
-      if (yMin < 0) 
-        yMin = 0;
-      int yMax = y + ns2;
-      if (yMax >= h) 
-        yMax = h - 1;
-      float m = imageSum.getSum(xMin, yMin, xMax, yMax);
-      const int numPixInNeib = (xMax - xMin + 1) * (yMax - yMin + 1);
-      m = m / numPixInNeib;
-      pixMean[k++] = m;
-    } // for x
-  } // for y
-
-  k = 0;
-  for (int y = 0; y < h; y++) {
-    for (int x = 0; x < w; x++) {
-      int xMin = x - ns2;
-      if (xMin < 0) 
-        xMin = 0;
-      int xMax = x + ns2;
-      if (xMax >= w) 
-        xMax = w - 1;
-      int yMin = y - ns2;
-      if (yMin < 0) 
-        yMin = 0;
-      int yMax = y + ns2;
-      if (yMax >= h) 
-        yMax = h - 1;
-
-      const int numPixInNeib = (xMax - xMin + 1) * (yMax - yMin + 1);
-
-      float sumVal = imageSum.getSum(xMin, yMin, xMax, yMax);
-      float sumVal2 = imageSum2.getSum2(xMin, yMin, xMax, yMax);
-      float mean = pixMean[k];
-
-      float std = sumVal2 - 2.0F * mean * sumVal + mean * mean * numPixInNeib;
-      std = std / numPixInNeib;
-      std = sqrtf(std);
+  ParallelRows::run(h, ParallelRows::getNumBands(h),
+                    [&](int, int yStart, int yEnd) {
+    processRows(sums, w, h, ns2, yStart, yEnd,
+                [&](int k, int, int, float mean, float std) {
+      // sauvola threshold, see ImageConvolutions::getSauvolaThreshold
+      const float t = mean * (1.0 + factor * ((std / 128.0) - 1.0));
+      pixDst[k] = (pixSrc[k] < t) ? 0.0F : 255.0F;
 
-      pixStd[k] = std;
-      k++;
+      if (pixMean != nullptr)
+        pixMean[k] = mean;
+      if (pixStd != nullptr)
+        pixStd[k] = std;
+      if (pixThr != nullptr)
+        pixThr[k] = t;
+    });
+  });
+}
+
+template <typename TWindowSums>
+static void sauvolaFusedBin(const TWindowSums& sums, const FImage& imageSrc,
+                            const int neibSize, const float factor,
+                            BinImage& imageDst) {
+  assert((neibSize & 1) == 1);  // check this is odd value
+  const int ns2 = neibSize / 2;
+
+  const int w = imageSrc.width();
+  const int h = imageSrc.height();
+  assert(imageDst.width() == w);
+  assert(imageDst.height() == h);
+
+  const float* pixSrc = imageSrc.getBits();
+
+  // destination is zero (black) initialized, every band owns its rows
+  ParallelRows::run(h, ParallelRows::getNumBands(h),
+                    [&](int, int yStart, int yEnd) {
+    processRows(sums, w, h, ns2, yStart, yEnd,
+                [&](int k, int x, int y, float mean, float std) {
+      const float t = mean * (1.0 + factor * ((std / 128.0) - 1.0));
+      if (pixSrc[k] >= t)
+        imageDst.setWhite(x, y);
+    });
+  });
+}
+
+ void FastMeanStd::getFastMeanStd( const FImage& imageSrc,
+                                  FImage& imageMean,
+                                  FImage& imageStd,
+                                  int neibSize) {
+  TRACE_ZONE("meanStd");
+  // mean and std dev are calculated in a single pass
+  FloatWindowSums sums(imageSrc);
+  meanStd(sums, imageSrc.width(), imageSrc.height(), neibSize, imageMean,
+          imageStd);
+}
+
+void FastMeanStd::getFastMeanStd(const IntegralImage& integral,
+                                 FImage& imageMean, FImage& imageStd,
+                                 int neibSize) {
+  TRACE_ZONE("meanStd");
+  ExactWindowSums sums(integral);
+  meanStd(sums, integral.width(), integral.height(), neibSize, imageMean,
+          imageStd);
+}
 
-    } // for x
-  } // for y
+void FastMeanStd::getSauvolaFused(const FImage& imageSrc,
+                                  const int neibSize,
+                                  const float factor,
+                                  FImage& imageDst,
+                                  FImage* imageMean,
+                                  FImage* imageStd,
+                                  FImage* imageThresholds) {
+  TRACE_ZONE("sauvolaFused");
+  FloatWindowSums sums(imageSrc);
+  sauvolaFused(sums, imageSrc, neibSize, factor, imageDst, imageMean,
+               imageStd, imageThresholds);
+}
 
+void FastMeanStd::getSauvolaFused(const FImage& imageSrc,
+                                  const IntegralImage& integral,
+                                  const int neibSize,
+                                  const float factor,
+                                  FImage& imageDst,
+                                  FImage* imageMean,
+                                  FImage* imageStd,
+                                  FImage* imageThresholds) {
+  TRACE_ZONE("sauvolaFused");
+  assert(integral.width() == imageSrc.width());
+  assert(integral.height() == imageSrc.height());
+  ExactWindowSums sums(integral);
+  sauvolaFused(sums, imageSrc, neibSize, factor, imageDst, imageMean,
+               imageStd, imageThresholds);
+}
 
- }
\ No newline at end of file
+void FastMeanStd::getSauvolaFused(const FImage& imageSrc,
+                                  const IntegralImage& integral,
+                                  const int neibSize,
+                                  const float factor,
+                                  BinImage& imageDst) {
+  TRACE_ZONE("sauvolaFused");
+  assert(integral.width() == imageSrc.width());
+  assert(integral.height() == imageSrc.height());
+  ExactWindowSums sums(integral);
+  sauvolaFusedBin(sums, imageSrc, neibSize, factor, imageDst);
+}
@@ -5,12 +5,43 @@
 #ifndef _FAST_MEAN_H__
 #define _FAST_MEAN_H__
 
+#include "BinImage.h"
 #include "FImage.h"
+#include "IntegralImage.h"
 
+// Mean / std dev by integral images. All functions process image by row
+// bands in parallel on ThreadPool
 class FastMeanStd {
  public:
   static void getFastMeanStd(const FImage& imageSrc, FImage& imageMean,
                              FImage& imageStd,  int neibSize);
+  // same by exact integer integral image of 8-bit source
+  static void getFastMeanStd(const IntegralImage& integral, FImage& imageMean,
+                             FImage& imageStd, int neibSize);
+
+  // Fused Sauvola binarization: mean, std dev, threshold and black/white
+  // decision are computed in a single pass over integral images and written
+  // straight into imageDst (0 or 255). Mean, std dev and threshold images
+  // are filled only if provided (debug purposes).
+  static void getSauvolaFused(const FImage& imageSrc, int neibSize,
+                              float factor, FImage& imageDst,
+                              FImage* imageMean = nullptr,
+                              FImage* imageStd = nullptr,
+                              FImage* imageThresholds = nullptr);
+  // same, window sums are taken from exact integral image, built from
+  // imageSrc. Should be used for large pages and windows, where float
+  // sums of squares lose precision
+  static void getSauvolaFused(const FImage& imageSrc,
+                              const IntegralImage& integral, int neibSize,
+                              float factor, FImage& imageDst,
+                              FImage* imageMean = nullptr,
+                              FImage* imageStd = nullptr,
+                              FImage* imageThresholds = nullptr);
+  // same, 1 bit per pixel destination. imageDst should be just created
+  // (all black), only white pixels are written
+  static void getSauvolaFused(const FImage& imageSrc,
+                              const IntegralImage& integral, int neibSize,
+                              float factor, BinImage& imageDst);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,42 @@
+//
+// Copyright 2022 Vlad
+//
+
+#include <QtCore/QDebug>
+
+#include "FzLocks.h"
+
+FzLocks::FzLocks() {
+  m_locks.user = this;
+  m_locks.lock = &FzLocks::lock;
+  m_locks.unlock = &FzLocks::unlock;
+}
+
+void FzLocks::lock(void* user, int lock) {
+  static_cast<FzLocks*>(user)->m_mutexes[lock].lock();
+}
+
+void FzLocks::unlock(void* user, int lock) {
+  static_cast<FzLocks*>(user)->m_mutexes[lock].unlock();
+}
+
+fz_context* FzLocks::newContext(size_t maxStore) const {
+  fz_context* ctx = fz_new_context(nullptr, &m_locks, maxStore);
+  if (ctx == nullptr) {
+    qWarning() << "FzLocks: cannot create mupdf context";
+    return nullptr;
+  }
+  bool ok = true;
+  fz_try(ctx) {
+    fz_register_document_handlers(ctx);
+  }
+  fz_catch(ctx) {
+    ok = false;
+  }
+  // not inside fz_catch: context owns its exception stack
+  if (!ok) {
+    fz_drop_context(ctx);
+    return nullptr;
+  }
+  return ctx;
+}
@@ -0,0 +1,49 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _FZ_LOCKS_H__
+#define _FZ_LOCKS_H__
+
+#include <mutex>
+
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable : 4100)
+#pragma warning(disable : 4611)
+#endif
+
+#include "mupdf/fitz.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+// Mutexes for mupdf lock callbacks. Context created with them shares
+// allocator, store and glyph cache safely with its clones
+// (fz_clone_context), one clone per thread.
+// Should live longer than the context and all its clones.
+class FzLocks
+{
+public:
+  FzLocks();
+
+  FzLocks(const FzLocks&) = delete;
+  FzLocks& operator=(const FzLocks&) = delete;
+
+  const fz_locks_context* get() const {
+    return &m_locks;
+  }
+  // context for clones, with document handlers registered.
+  // nullptr on mupdf error
+  fz_context* newContext(size_t maxStore = FZ_STORE_DEFAULT) const;
+
+private:
+  static void lock(void* user, int lock);
+  static void unlock(void* user, int lock);
+
+  std::mutex          m_mutexes[FZ_LOCK_MAX];
+  fz_locks_context    m_locks;
+};
+
+#endif
@@ -3,12 +3,16 @@
 //
 
 #include <cassert>
+#include <mutex>
 
 #include "ImageConv.h"
 #include "FImage.h"
+#include "ThreadPool.h"
+#include "Trace.h"
 
 void ImageConvolutions::getWindowedMean(FImage &imageSrc, FImage &imageDst,
                                         int wSize) {
+  TRACE_ZONE("mean");
   float *floatSrc = imageSrc.getBits();
   float *floatDst = imageDst.getBits();
 
@@ -16,37 +20,39 @@ void ImageConvolutions::getWindowedMean(FImage &imageSrc, FImage &imageDst,
   const int hSrc = imageSrc.height();
 
   assert((wSize & 1) == 1);
-  const int numNeighbours = wSize * wSize;
   const int rad = wSize / 2;
 
-  int k = 0;  // dest offset
-  for (int y = 0; y < hSrc; y++) {
-    for (int x = 0; x < wSrc; x++) {
-      float sum = 0.0;
-      int numNeibs = 0;
-
-      for (int dy = -rad; dy <= rad; dy++) {
-        int yy = y + dy;
-        if ( (yy < 0) || (yy >= hSrc))
-          continue;
-        const int yyOff = yy * wSrc;
-
-        for (int dx = -rad; dx <= rad; dx++) {
-          int xx = x + dx;
-          if ((xx < 0) || (xx >= wSrc)) 
-            continue;
+  ThreadPool::instance().parallelFor(0, hSrc, [&](int yStart, int yEnd) {
+    int k = yStart * wSrc;  // dest offset
+    for (int y = yStart; y < yEnd; y++) {
+      for (int x = 0; x < wSrc; x++) {
+        float sum = 0.0;
+        int numNeibs = 0;
 
-          sum += floatSrc[xx + yyOff];
-          numNeibs++;
-        }  // for dx
-      }    // for dy
-      floatDst[k++] = sum / numNeibs;
-    }  // for x
-  }    // for y
+        for (int dy = -rad; dy <= rad; dy++) {
+          int yy = y + dy;
+          if ( (yy < 0) || (yy >= hSrc))
+            continue;
+          const int yyOff = yy * wSrc;
+
+          for (int dx = -rad; dx <= rad; dx++) {
+            int xx = x + dx;
+            if ((xx < 0) || (xx >= wSrc)) 
+              continue;
+
+            sum += floatSrc[xx + yyOff];
+            numNeibs++;
+          }  // for dx
+        }    // for dy
+        floatDst[k++] = sum / numNeibs;
+      }  // for x
+    }    // for y
+  });
 }
 void ImageConvolutions::getWindowedStdDev(const FImage &imageSrc,
                                           const FImage &imageMean,
                                           FImage &imageDst, int wSize) {
+  TRACE_ZONE("stdDev");
   float *floatSrc = imageSrc.getBits();
   float *floatMean = imageMean.getBits();
   float *floatDst = imageDst.getBits();
@@ -56,38 +62,46 @@ void ImageConvolutions::getWindowedStdDev(const FImage &imageSrc,
 
   float valMin = 100000.0F;
   float valMax = 0.0F;
+  std::mutex mutexMinMax;
 
   assert((wSize & 1) == 1);
   const int rad = wSize / 2;
 
-  int k = 0;  // dest offset
-  for (int y = 0; y < hSrc; y++) {
-    for (int x = 0; x < wSrc; x++) {
-      const float valMean = floatMean[k];
-      float sum = 0.0;
-      int numNeibs = 0;
-
-      for (int dy = -rad; dy <= rad; dy++) {
-        int yy = y + dy;
-        if ((yy < 0) || (yy >= hSrc)) 
-          continue;
-        const int yyOff = yy * wSrc;
-        for (int dx = -rad; dx <= rad; dx++) {
-          int xx = x + dx;
-          if ((xx < 0) || (xx >= wSrc)) 
+  ThreadPool::instance().parallelFor(0, hSrc, [&](int yStart, int yEnd) {
+    float valMinRows = 100000.0F;
+    float valMaxRows = 0.0F;
+    int k = yStart * wSrc;  // dest offset
+    for (int y = yStart; y < yEnd; y++) {
+      for (int x = 0; x < wSrc; x++) {
+        const float valMean = floatMean[k];
+        float sum = 0.0;
+        int numNeibs = 0;
+
+        for (int dy = -rad; dy <= rad; dy++) {
+          int yy = y + dy;
+          if ((yy < 0) || (yy >= hSrc)) 
             continue;
-
-          const float dv = floatSrc[xx + yyOff] - valMean;
-          sum += dv * dv;
-          numNeibs++;
-        }  // for dx
-      }    // for dy
-      const float s = sqrt(sum / numNeibs);
-      floatDst[k++] = s;
-      valMin = (s < valMin) ? s : valMin;
-      valMax = (s > valMax) ? s : valMax;
-    }  // for x
-  }    // for y
+          const int yyOff = yy * wSrc;
+          for (int dx = -rad; dx <= rad; dx++) {
+            int xx = x + dx;
+            if ((xx < 0) || (xx >= wSrc)) 
+              continue;
+
+            const float dv = floatSrc[xx + yyOff] - valMean;
+            sum += dv * dv;
+            numNeibs++;
+          }  // for dx
+        }    // for dy
+        const float s = sqrt(sum / numNeibs);
+        floatDst[k++] = s;
+        valMinRows = (s < valMinRows) ? s : valMinRows;
+        valMaxRows = (s > valMaxRows) ? s : valMaxRows;
+      }  // for x
+    }    // for y
+    std::lock_guard<std::mutex> lock(mutexMinMax);
+    valMin = (valMinRows < valMin) ? valMinRows : valMin;
+    valMax = (valMaxRows > valMax) ? valMaxRows : valMax;
+  });
   valMax += 1.0F;
 
   const bool NORMALIZE_STDDEV = false;
@@ -104,40 +118,76 @@ void ImageConvolutions::getSauvolaThreshold(const FImage &imageFloatMean,
                                             const FImage &imageFloatStdDev,
                                             float factor,
                                             FImage &imageFloatThresholds) {
+  TRACE_ZONE("threshold");
   float *floatMean = imageFloatMean.getBits();
   float *floatStd = imageFloatStdDev.getBits();
   float *floatDst = imageFloatThresholds.getBits();
 
   const int wSrc = imageFloatMean.width();
   const int hSrc = imageFloatMean.height();
-  const int numPixels = wSrc * hSrc;
-  for (int i = 0; i < numPixels; i++) {
-    // According to
-    // https://craftofcoding.wordpress.com/2021/10/06/thresholding-algorithms-sauvola-local/
-    // threshold value is calculated as:
-    // t = M * (1 + k * ((S/128) - 1))
-    // t: result threshold
-    // M: media value
-    // S: standard deviation value
-    // k: factor in [0.2 .. 0.5]
-    const float t =
-        floatMean[i] * (1.0 + factor * ((floatStd[i] / 128.0) - 1.0));
-    floatDst[i] = t;
-  }  // for i
+  ThreadPool::instance().parallelFor(0, hSrc, [&](int yStart, int yEnd) {
+    const int iEnd = yEnd * wSrc;
+    for (int i = yStart * wSrc; i < iEnd; i++) {
+      // According to
+      // https://craftofcoding.wordpress.com/2021/10/06/thresholding-algorithms-sauvola-local/
+      // threshold value is calculated as:
+      // t = M * (1 + k * ((S/128) - 1))
+      // t: result threshold
+      // M: media value
+      // S: standard deviation value
+      // k: factor in [0.2 .. 0.5]
+      const float t =
+          floatMean[i] * (1.0 + factor * ((floatStd[i] / 128.0) - 1.0));
+      floatDst[i] = t;
+    }  // for i
+  });
 }
 
 void ImageConvolutions::applyThresholds(const FImage &imageFloatSrc,
                                         const FImage &imageFloatThresholds,
                                         FImage &imageFloatDest) {
+  TRACE_ZONE("applyThresholds");
   float *floatSrc = imageFloatSrc.getBits();
   float *floatThr = imageFloatThresholds.getBits();
   float *floatDst = imageFloatDest.getBits();
 
   const int wSrc = imageFloatSrc.width();
   const int hSrc = imageFloatSrc.height();
-  const int numPixels = wSrc * hSrc;
-  for (int i = 0; i < numPixels; i++) {
-    const float t = (floatSrc[i] < floatThr[i]) ? 0.0F : 255.0F;
-    floatDst[i] = t;
-  }  // for i
+  ThreadPool::instance().parallelFor(0, hSrc, [&](int yStart, int yEnd) {
+    const int iEnd = yEnd * wSrc;
+    for (int i = yStart * wSrc; i < iEnd; i++) {
+      const float t = (floatSrc[i] < floatThr[i]) ? 0.0F : 255.0F;
+      floatDst[i] = t;
+    }  // for i
+  });
+}
+
+void ImageConvolutions::applyThresholds(const FImage &imageFloatSrc,
+                                        const FImage &imageFloatThresholds,
+                                        BinImage &imageBinDest) {
+  TRACE_ZONE("applyThresholds");
+  const float *floatSrc = imageFloatSrc.getBits();
+  const float *floatThr = imageFloatThresholds.getBits();
+
+  const int wSrc = imageFloatSrc.width();
+  const int hSrc = imageFloatSrc.height();
+  assert(imageBinDest.width() == wSrc);
+  assert(imageBinDest.height() == hSrc);
+  ThreadPool::instance().parallelFor(0, hSrc, [&](int yStart, int yEnd) {
+    for (int y = yStart; y < yEnd; y++) {
+      const float *lineSrc = floatSrc + (int64_t)y * wSrc;
+      const float *lineThr = floatThr + (int64_t)y * wSrc;
+      uint64_t *lineDst = imageBinDest.getLine(y);
+      // whole words are written: no read-modify-write of shared memory
+      for (int xWord = 0; xWord < wSrc; xWord += 64) {
+        const int xEnd = (xWord + 64 < wSrc) ? xWord + 64 : wSrc;
+        uint64_t word = 0;
+        for (int x = xWord; x < xEnd; x++) {
+          if (lineSrc[x] >= lineThr[x])
+            word |= BinImage::getMask(x);
+        }
+        lineDst[xWord >> 6] = word;
+      }  // for xWord
+    }    // for y
+  });
 }
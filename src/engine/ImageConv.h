@@ -6,6 +6,7 @@
 #define _IMAGE_CONV_H__
 
 #include "FImage.h"
+#include "BinImage.h"
 
 class ImageConvolutions 
 {
@@ -21,6 +22,10 @@ public:
   static void applyThresholds(const FImage& imageFloatSrc, 
                               const FImage& imageFloatThresholds,
                               FImage& imageFloatDest);
+  // same, 1 bit per pixel destination
+  static void applyThresholds(const FImage& imageFloatSrc,
+                              const FImage& imageFloatThresholds,
+                              BinImage& imageBinDest);
 };
 
 #endif
\ No newline at end of file
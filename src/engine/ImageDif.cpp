@@ -3,20 +3,24 @@
 //
 
 #include "ImageDif.h"
+#include "ThreadPool.h"
 
 #define USE_THREADS
 
-void ImageDiff ::getDiff(const FImage &imageA, const FImage &imageB,
-                         float distBarrier, FImage &imageDiff) {
-
-  FImage imageKernel = getGaussianKernel(7, 7, 0.4F);
+static FImage getSmooth(const FImage &image) {
   #ifdef USE_THREADS
-    FImage smoothA = imageA.getGaussSmoothViaThreads(imageKernel);
-    FImage smoothB = imageB.getGaussSmoothViaThreads(imageKernel);
+    FImage imageKernel1D = getGaussianKernel1D(7, 0.4F);
+    return image.getGaussSmoothSeparable(imageKernel1D);
   #else
-    FImage smoothA = imageA.getGaussSmooth(imageKernel);
-    FImage smoothB = imageB.getGaussSmooth(imageKernel);
+    FImage imageKernel = getGaussianKernel(7, 7, 0.4F);
+    return image.getGaussSmooth(imageKernel);
   #endif
+}
+
+void ImageDiff ::getDiff(const FImage &imageA, const FImage &imageB,
+                         float distBarrier, FImage &imageDiff) {
+  FImage smoothA = getSmooth(imageA);
+  FImage smoothB = getSmooth(imageB);
 
   #ifdef DEEP_DEBUG
     QImage imgA = smoothA.getQImage();
@@ -25,7 +29,6 @@ void ImageDiff ::getDiff(const FImage &imageA, const FImage &imageB,
     imgB.save("log/smooth_b.png");
   #endif
 
-
   const float *floatA = smoothA.getBits();
   const float *floatB = smoothB.getBits();
   float *floatDiff = imageDiff.getBits();
@@ -35,17 +38,50 @@ void ImageDiff ::getDiff(const FImage &imageA, const FImage &imageB,
 
   const float distBarrier2 = (float)distBarrier * distBarrier;
 
-  int k = 0;  // dest offset
-  for (int y = 0; y < hSrc; y++) {
-    for (int x = 0; x < wSrc; x++) {
-
-      float dif = floatA[k] - floatB[k];
-      if (dif * dif <= distBarrier2) {
-        floatDiff[k] = 0.0F;
-      } else {
-        floatDiff[k] = 255.0F;
-      }
-      k++;
-    }  // for x
-  }    // for y
+  ThreadPool::instance().parallelFor(0, hSrc, [&](int yStart, int yEnd) {
+    int k = yStart * wSrc;  // dest offset
+    for (int y = yStart; y < yEnd; y++) {
+      for (int x = 0; x < wSrc; x++) {
+
+        float dif = floatA[k] - floatB[k];
+        if (dif * dif <= distBarrier2) {
+          floatDiff[k] = 0.0F;
+        } else {
+          floatDiff[k] = 255.0F;
+        }
+        k++;
+      }  // for x
+    }    // for y
+  });
+}
+
+void ImageDiff ::getDiff(const FImage &imageA, const FImage &imageB,
+                         float distBarrier, BinImage &imageDiff) {
+  FImage smoothA = getSmooth(imageA);
+  FImage smoothB = getSmooth(imageB);
+
+  const float *floatA = smoothA.getBits();
+  const float *floatB = smoothB.getBits();
+
+  const int wSrc = imageA.width();
+  const int hSrc = imageA.height();
+
+  const float distBarrier2 = (float)distBarrier * distBarrier;
+
+  ThreadPool::instance().parallelFor(0, hSrc, [&](int yStart, int yEnd) {
+    for (int y = yStart; y < yEnd; y++) {
+      const int k = y * wSrc;  // row offset
+      uint64_t *lineDiff = imageDiff.getLine(y);
+      for (int xWord = 0; xWord < wSrc; xWord += 64) {
+        const int xEnd = (xWord + 64 < wSrc) ? xWord + 64 : wSrc;
+        uint64_t word = 0;
+        for (int x = xWord; x < xEnd; x++) {
+          const float dif = floatA[k + x] - floatB[k + x];
+          if (dif * dif > distBarrier2)
+            word |= BinImage::getMask(x);
+        }
+        lineDiff[xWord >> 6] = word;
+      }  // for xWord
+    }    // for y
+  });
 }
@@ -5,12 +5,16 @@
 #ifndef _IMAGE_DIFF_H__
 #define _IMAGE_DIFF_H__
 
+#include "BinImage.h"
 #include "FImage.h"
 
 class ImageDiff {
  public:
   static void getDiff(const FImage& imageA, const FImage& imageB,
                       float distBarrier, FImage& imageDiff);
+  // different pixels are white (1), equal are black (0)
+  static void getDiff(const FImage& imageA, const FImage& imageB,
+                      float distBarrier, BinImage& imageDiff);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,184 @@
+//
+// Copyright 2022 Vlad
+//
+
+#include <cassert>
+#include <vector>
+
+#include "IntegralImage.h"
+#include "BufferPool.h"
+#include "ParallelRows.h"
+#include "Simd.h"
+#include "Trace.h"
+
+// Tables are kept in BufferPool float buffers:
+// uint32_t takes 1 float, uint64_t takes 2 floats
+static_assert(sizeof(uint32_t) == sizeof(float), "unexpected float size");
+
+// dst[x] += src[x], x in [xStart .. xEnd)
+static void addRows(uint32_t* dst, const uint32_t* src, uint64_t* dst2,
+                    const uint64_t* src2, const int xStart, const int xEnd) {
+  int x = xStart;
+#if defined(IMB_SIMD_AVX2)
+  for (; x + 8 <= xEnd; x += 8) {
+    const __m256i s = _mm256_add_epi32(
+        _mm256_loadu_si256((const __m256i*)(dst + x)),
+        _mm256_loadu_si256((const __m256i*)(src + x)));
+    _mm256_storeu_si256((__m256i*)(dst + x), s);
+    const __m256i sa = _mm256_add_epi64(
+        _mm256_loadu_si256((const __m256i*)(dst2 + x)),
+        _mm256_loadu_si256((const __m256i*)(src2 + x)));
+    const __m256i sb = _mm256_add_epi64(
+        _mm256_loadu_si256((const __m256i*)(dst2 + x + 4)),
+        _mm256_loadu_si256((const __m256i*)(src2 + x + 4)));
+    _mm256_storeu_si256((__m256i*)(dst2 + x), sa);
+    _mm256_storeu_si256((__m256i*)(dst2 + x + 4), sb);
+  }
+#elif defined(IMB_SIMD_SSE2)
+  for (; x + 4 <= xEnd; x += 4) {
+    const __m128i s =
+        _mm_add_epi32(_mm_loadu_si128((const __m128i*)(dst + x)),
+                      _mm_loadu_si128((const __m128i*)(src + x)));
+    _mm_storeu_si128((__m128i*)(dst + x), s);
+    const __m128i sa =
+        _mm_add_epi64(_mm_loadu_si128((const __m128i*)(dst2 + x)),
+                      _mm_loadu_si128((const __m128i*)(src2 + x)));
+    const __m128i sb =
+        _mm_add_epi64(_mm_loadu_si128((const __m128i*)(dst2 + x + 2)),
+                      _mm_loadu_si128((const __m128i*)(src2 + x + 2)));
+    _mm_storeu_si128((__m128i*)(dst2 + x), sa);
+    _mm_storeu_si128((__m128i*)(dst2 + x + 2), sb);
+  }
+#endif
+  for (; x < xEnd; x++) {
+    dst[x] += src[x];
+    dst2[x] += src2[x];
+  }
+}
+
+IntegralImage::IntegralImage() {
+  m_wImage = 0;
+  m_hImage = 0;
+  m_stride = 0;
+  m_sum = nullptr;
+  m_sum2 = nullptr;
+}
+
+IntegralImage::IntegralImage(const uint8_t* pixels, int w, int h,
+                             int stride) {
+  allocate(w, h);
+  build([pixels, stride](int y, uint8_t*) {
+    return pixels + (int64_t)y * stride;
+  });
+}
+
+IntegralImage::IntegralImage(const FImage& imageSrc) {
+  const int w = imageSrc.width();
+  allocate(w, imageSrc.height());
+
+  const float* pixels = imageSrc.getBits();
+  build([pixels, w](int y, uint8_t* row) {
+    const float* pixSrc = pixels + (int64_t)y * w;
+    for (int x = 0; x < w; x++) {
+      const float v = pixSrc[x] + 0.5F;
+      row[x] = (v <= 0.0F) ? 0 : ((v >= 255.0F) ? 255 : (uint8_t)v);
+    }
+    return (const uint8_t*)row;
+  });
+}
+
+IntegralImage::IntegralImage(IntegralImage&& src) noexcept {
+  m_wImage = src.m_wImage;
+  m_hImage = src.m_hImage;
+  m_stride = src.m_stride;
+  m_sum = src.m_sum;
+  m_sum2 = src.m_sum2;
+  src.m_sum = nullptr;
+  src.m_sum2 = nullptr;
+}
+
+IntegralImage::~IntegralImage() {
+  const int64_t numElements = (int64_t)m_stride * (m_hImage + 1);
+  if (m_sum)
+    BufferPool::instance().release((float*)m_sum, numElements);
+  if (m_sum2)
+    BufferPool::instance().release((float*)m_sum2, numElements * 2);
+  m_sum = nullptr;
+  m_sum2 = nullptr;
+}
+
+void IntegralImage::allocate(int w, int h) {
+  assert(w > 0);
+  assert(h > 0);
+  m_wImage = w;
+  m_hImage = h;
+  m_stride = w + 1;
+  const int64_t numElements = (int64_t)m_stride * (h + 1);
+  m_sum = (uint32_t*)BufferPool::instance().acquire(numElements);
+  m_sum2 = (uint64_t*)BufferPool::instance().acquire(numElements * 2);
+  // zero top row. Left column is zeroed row by row
+  for (int x = 0; x < m_stride; x++) {
+    m_sum[x] = 0;
+    m_sum2[x] = 0;
+  }
+}
+
+void IntegralImage::build(const GetRowFunc& getRow) {
+  TRACE_ZONE("integral");
+  // Two-level scan.
+  // 1) every band of rows is accumulated independently, as if it
+  //    is placed on the image top
+  const int numBands = ParallelRows::getNumBands(m_hImage);
+  ParallelRows::run(m_hImage, numBands, [&](int, int yStart, int yEnd) {
+    std::vector<uint8_t> rowTmp(m_wImage);
+    for (int y = yStart; y < yEnd; y++) {
+      buildRow(getRow(y, rowTmp.data()), y, y > yStart);
+    }
+  });
+  if (numBands == 1)
+    return;
+
+  // 2) make last row of each band final: add final last row of the
+  //    previous band. Sequential, but only one row per band
+  for (int i = 1; i < numBands; i++) {
+    const int yPrev = i * m_hImage / numBands - 1;
+    const int yLast = (i + 1) * m_hImage / numBands - 1;
+    addRows(getRowSum(yLast), getRowSum(yPrev), getRowSum2(yLast),
+            getRowSum2(yPrev), 1, m_stride);
+  }
+
+  // 3) add final row above the band to the rest rows of band
+  ParallelRows::run(m_hImage, numBands,
+                    [&](int indexBand, int yStart, int yEnd) {
+    if (indexBand == 0)
+      return;
+    const int yPrev = yStart - 1;
+    for (int y = yStart; y < yEnd - 1; y++) {
+      addRows(getRowSum(y), getRowSum(yPrev), getRowSum2(y),
+              getRowSum2(yPrev), 1, m_stride);
+    }
+  });
+}
+
+void IntegralImage::buildRow(const uint8_t* pixels, int y, bool addAbove) {
+  uint32_t* dst = getRowSum(y);
+  uint64_t* dst2 = getRowSum2(y);
+
+  // running sums along row
+  uint32_t sum = 0;
+  uint64_t sum2 = 0;
+  dst[0] = 0;
+  dst2[0] = 0;
+  for (int x = 0; x < m_wImage; x++) {
+    const uint32_t v = pixels[x];
+    sum += v;
+    sum2 += v * v;
+    dst[x + 1] = sum;
+    dst2[x + 1] = sum2;
+  }
+
+  // add row above: independent per column, so vectorized
+  if (addAbove) {
+    addRows(dst, dst - m_stride, dst2, dst2 - m_stride, 1, m_stride);
+  }
+}
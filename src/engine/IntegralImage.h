@@ -0,0 +1,77 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _INTEGRAL_IMAGE_H__
+#define _INTEGRAL_IMAGE_H__
+
+#include <cstdint>
+#include <functional>
+
+#include "FImage.h"
+
+// Exact summed-area tables (sum and sum of squares) for 8-bit gray image.
+// Tables are stored with extra zero top row and left column, so window sums
+// need no branches. Sums are accumulated modulo 2^32 (2^64 for squares):
+// table values may wrap on large pages, but any window sum below 2^32 is
+// still exact, i.e. windows up to 16 M pixels.
+// Tables are built by row bands in parallel (see ParallelRows).
+class IntegralImage
+{
+public:
+  IntegralImage();
+  // build from 8-bit gray pixels, stride in bytes
+  IntegralImage(const uint8_t* pixels, int w, int h, int stride);
+  // build from float image: values are rounded and clamped to [0..255]
+  explicit IntegralImage(const FImage& imageSrc);
+
+  IntegralImage(const IntegralImage&) = delete;
+  IntegralImage& operator=(const IntegralImage&) = delete;
+  IntegralImage(IntegralImage&& src) noexcept;
+
+  ~IntegralImage();
+
+  int width() const {
+    return m_wImage;
+  }
+  int height() const {
+    return m_hImage;
+  }
+
+  // sum of pixels in window [xMin..xMax] x [yMin..yMax], bounds inclusive
+  uint32_t getSum(int xMin, int yMin, int xMax, int yMax) const {
+    const uint32_t* rowMin = m_sum + (int64_t)yMin * m_stride;
+    const uint32_t* rowMax = m_sum + ((int64_t)yMax + 1) * m_stride;
+    return rowMax[xMax + 1] - rowMax[xMin] - rowMin[xMax + 1] + rowMin[xMin];
+  }
+  // sum of squared pixels in window, bounds inclusive
+  uint64_t getSum2(int xMin, int yMin, int xMax, int yMax) const {
+    const uint64_t* rowMin = m_sum2 + (int64_t)yMin * m_stride;
+    const uint64_t* rowMax = m_sum2 + ((int64_t)yMax + 1) * m_stride;
+    return rowMax[xMax + 1] - rowMax[xMin] - rowMin[xMax + 1] + rowMin[xMin];
+  }
+
+private:
+  // returns 8-bit pixels of row y, may use given temporary row buffer
+  using GetRowFunc = std::function<const uint8_t*(int, uint8_t*)>;
+
+  void allocate(int w, int h);
+  void build(const GetRowFunc& getRow);
+  void buildRow(const uint8_t* pixels, int y, bool addAbove);
+  // table rows of image row y
+  uint32_t* getRowSum(int y) const {
+    return m_sum + ((int64_t)y + 1) * m_stride;
+  }
+  uint64_t* getRowSum2(int y) const {
+    return m_sum2 + ((int64_t)y + 1) * m_stride;
+  }
+
+  int         m_wImage;
+  int         m_hImage;
+  // elements per table row: m_wImage + 1
+  int         m_stride;
+  uint32_t*   m_sum;
+  uint64_t*   m_sum2;
+};
+
+#endif
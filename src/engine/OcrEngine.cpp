@@ -0,0 +1,190 @@
+//
+// Copyright 2022 Vlad
+//
+
+#include <cassert>
+
+#include <QtCore/QDebug>
+
+#include "tesseract/baseapi.h"
+#include "tesseract/ocrclass.h"
+#include "tesseract/publictypes.h"
+#include "tesseract/resultiterator.h"
+
+#include "Bmp.h"
+#include "OcrEngine.h"
+#include "Trace.h"
+
+// one Recognize call, cancel_this of tesseract monitor
+struct OcrMonitor {
+  OcrProgress*  progress;
+  // trace times: Recognize start (-1: tracing is off) and first word.
+  // Tesseract calls monitor only from word loop, so everything before
+  // the first call is layout analysis
+  int64_t       timeStart;
+  int64_t       timeWords;
+};
+
+static void onWord(OcrMonitor* monitor) {
+  if ((monitor->timeStart >= 0) && (monitor->timeWords < 0))
+    monitor->timeWords = Trace::getTimeNs();
+}
+
+// tesseract progress monitor
+static bool onProgress(tesseract::ETEXT_DESC* monitor, int, int, int, int) {
+  auto* state = (OcrMonitor*)monitor->cancel_this;
+  onWord(state);
+  if (state->progress != nullptr)
+    state->progress->percent.store(monitor->progress);
+  return true;
+}
+
+// called by tesseract between words
+static bool onCancel(void* cancelThis, int) {
+  auto* state = (OcrMonitor*)cancelThis;
+  onWord(state);
+  return (state->progress != nullptr) && state->progress->isCancelled();
+}
+
+OcrEngine::OcrEngine() {
+  m_api = nullptr;
+}
+
+OcrEngine::~OcrEngine() {
+  if (m_api) {
+    m_api->End();
+    delete m_api;
+    m_api = nullptr;
+  }
+}
+
+bool OcrEngine::init(const char* dataPath, const char* lang) {
+  assert(m_api == nullptr);
+  auto* api = new tesseract::TessBaseAPI();
+  const int res = api->Init(dataPath,
+                            0,
+                            lang,
+                            tesseract::OcrEngineMode::OEM_LSTM_ONLY,
+                            nullptr, 0,
+                            nullptr, nullptr,
+                            false, // set_only_non_debug_params
+                            nullptr);
+  if (res != 0) {
+    qWarning() << "OcrEngine: cannot load model" << lang << "from" << dataPath;
+    delete api;
+    return false;
+  }
+  m_api = api;
+  return true;
+}
+
+SharedPix OcrEngine::getPix(const BinImage& image) {
+  return SharedPix(BmpBinImageToPix(image), [](Pix* pix) {
+    if (pix != nullptr)
+      pixDestroy(&pix);
+  });
+}
+
+std::vector<TextBox> OcrEngine::recognize(const BinImage& image,
+                                          OcrProgress* progress,
+                                          int hPage) {
+  return recognize(getPix(image), QRect(), progress, hPage);
+}
+
+std::vector<TextBox> OcrEngine::recognize(const SharedPix& pix,
+                                          const QRect& rect,
+                                          OcrProgress* progress,
+                                          int hPage) {
+  if (!pix)
+    return std::vector<TextBox>();
+  assert(pixGetDepth(pix.get()) == 1);
+  // 1 bpp PIX is taken as already binarized: thresholder only copies it,
+  // no gray conversion and Otsu pass. Copy reads pix without clone, so the
+  // same pix can be set on several engines at once
+  m_api->SetImage(pix.get());
+  if (!rect.isNull())
+    m_api->SetRectangle(rect.x(), rect.y(), rect.width(), rect.height());
+  return recognizeWords((hPage > 0) ? hPage : pixGetHeight(pix.get()),
+                        progress);
+}
+
+std::vector<TextBox> OcrEngine::recognize(const QImage& image,
+                                          OcrProgress* progress,
+                                          int hPage) {
+  QImage imageGray;
+  {
+    TRACE_ZONE("gray");
+    imageGray = image.convertToFormat(QImage::Format::Format_Grayscale8);
+  }
+  m_api->SetImage(imageGray.constBits(), imageGray.width(),
+                  imageGray.height(), 1, imageGray.bytesPerLine());
+  return recognizeWords((hPage > 0) ? hPage : imageGray.height(), progress);
+}
+
+std::vector<TextBox> OcrEngine::recognizeWords(const int h,
+                                               OcrProgress* progress) {
+  std::vector<TextBox> textBoxes;
+
+  // layout analysis and recognition of all words: one pass per page
+  OcrMonitor state;
+  state.progress = progress;
+  state.timeStart = Trace::isEnabled() ? Trace::getTimeNs() : -1;
+  state.timeWords = -1;
+  tesseract::ETEXT_DESC monitor;
+  monitor.cancel_this = &state;
+  monitor.progress_callback2 = &onProgress;
+  monitor.cancel = &onCancel;
+  if ((progress != nullptr) && progress->isCancelled()) {
+    m_api->Clear();
+    return textBoxes;
+  }
+  const int res = m_api->Recognize(&monitor);
+  if (state.timeStart >= 0) {
+    const int64_t timeEnd = Trace::getTimeNs();
+    const int64_t timeWords =
+        (state.timeWords >= 0) ? state.timeWords : timeEnd;
+    Trace::addEvent("ocrLayout", state.timeStart, timeWords);
+    Trace::addEvent("ocrRecognize", timeWords, timeEnd);
+  }
+  if ((res != 0) || ((progress != nullptr) && progress->isCancelled())) {
+    if ((progress == nullptr) || !progress->isCancelled())
+      qWarning() << "OcrEngine: recognition failed";
+    m_api->Clear();
+    return textBoxes;
+  }
+
+  // prevent too narrow (by height) text boxes. h is page height: region
+  // of page upscaled for recognition keeps words of its text line
+  const int hMax = h / 8;
+  tesseract::ResultIterator* it = m_api->GetIterator();
+  const tesseract::PageIteratorLevel level = tesseract::RIL_WORD;
+  if (it != nullptr) {
+    do {
+      int x0, y0, x1, y1;
+      if (!it->BoundingBox(level, &x0, &y0, &x1, &y1))
+        continue;
+      if (y1 - y0 > hMax)
+        continue;
+
+      char* outText = it->GetUTF8Text(level);
+      if (outText == nullptr)
+        continue;
+      QString strRecognized = QString::fromUtf8(outText);
+      delete[] outText;
+      if (strRecognized.length() == 0)
+        continue;
+
+      TextBox tBox;
+      tBox.m_rect = QRect(x0, y0, x1 - x0, y1 - y0);
+      tBox.m_text = strRecognized;
+      tBox.m_confidence = it->Confidence(level);
+      textBoxes.push_back(tBox);
+    } while (it->Next(level));
+    delete it;
+  }
+  // release page image and recognition results
+  m_api->Clear();
+  if (progress != nullptr)
+    progress->percent.store(100);
+  return textBoxes;
+}
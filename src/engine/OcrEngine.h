@@ -0,0 +1,86 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _OCR_ENGINE_H__
+#define _OCR_ENGINE_H__
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <QtGui/QImage>
+
+#include "BinImage.h"
+#include "RecogRes.h"
+
+namespace tesseract {
+class TessBaseAPI;
+}
+struct Pix;
+
+// binarized page as 1 bpp leptonica PIX, shared by engines which
+// recognize its blocks. Engines only read it, last owner destroys it
+using SharedPix = std::shared_ptr<Pix>;
+
+// state of one recognition, shared by caller and engine thread
+struct OcrProgress {
+  // percent of recognized words, written by engine
+  std::atomic<int>          percent{0};
+  // optional owner flag: recognition stops as soon as it is set.
+  // May be shared by all regions of one page
+  const std::atomic<bool>*  cancel = nullptr;
+
+  bool isCancelled() const {
+    return (cancel != nullptr) && cancel->load();
+  }
+};
+
+// One initialized Tesseract (LSTM) engine. Not thread-safe: every engine
+// should be used by one thread at a time (see OcrPool).
+// Leptonica memory functions should be set before init (set_leptonica_mem).
+class OcrEngine
+{
+public:
+  OcrEngine();
+  ~OcrEngine();
+
+  OcrEngine(const OcrEngine&) = delete;
+  OcrEngine& operator=(const OcrEngine&) = delete;
+
+  // load trained model lang from dataPath directory
+  bool init(const char* dataPath, const char* lang);
+  bool isInit() const {
+    return m_api != nullptr;
+  }
+
+  // 1 bpp PIX of binarized page, built once for all its blocks
+  static SharedPix getPix(const BinImage& image);
+
+  // words of the whole page in a single recognition pass.
+  // progress (optional) receives percent of recognized words and can
+  // cancel recognition: cancelled page has no words.
+  // hPage: height of the whole page in image pixels, words taller than
+  // 1/8 of it are dropped (graphics); 0: image is the whole page
+  std::vector<TextBox> recognize(const BinImage& image,
+                                 OcrProgress* progress = nullptr,
+                                 int hPage = 0);
+  // binarized page (see getPix): tesseract skips its own thresholding.
+  // With not null rect words of the page region only (SetRectangle),
+  // boxes are in page coordinates
+  std::vector<TextBox> recognize(const SharedPix& pix, const QRect& rect,
+                                 OcrProgress* progress = nullptr,
+                                 int hPage = 0);
+  // not binarized page: gray or RGB32
+  std::vector<TextBox> recognize(const QImage& image,
+                                 OcrProgress* progress = nullptr,
+                                 int hPage = 0);
+
+private:
+  std::vector<TextBox> recognizeWords(int hImage,
+                                      OcrProgress* progress);
+
+  tesseract::TessBaseAPI*   m_api;
+};
+
+#endif
@@ -0,0 +1,178 @@
+//
+// Copyright 2022 Vlad
+//
+
+#include <cassert>
+
+#include <QtCore/QDebug>
+
+#include "OcrPool.h"
+#include "Trace.h"
+
+OcrPool::OcrPool() {
+  m_stop = false;
+}
+
+OcrPool::~OcrPool() {
+  destroy();
+}
+
+int OcrPool::getPoolSize(const OcrPoolConfig& config, int numCores) {
+  int numEngines = (config.numEngines > 0) ? config.numEngines : numCores;
+  if ((config.memoryBudgetMb > 0) && (config.engineMemoryMb > 0)) {
+    const int numFit = config.memoryBudgetMb / config.engineMemoryMb;
+    if (numEngines > numFit)
+      numEngines = numFit;
+  }
+  // at least one engine, even over budget
+  return (numEngines < 1) ? 1 : numEngines;
+}
+
+bool OcrPool::init(const OcrPoolConfig& config) {
+  assert(m_threads.empty());
+  m_config = config;
+  m_stop = false;
+
+  int numCores = (int)std::thread::hardware_concurrency();
+  if (numCores < 1)
+    numCores = 1;
+  const int numEngines = getPoolSize(config, numCores);
+
+  // model loading takes most of the start time: all engines in parallel
+  std::vector<std::future<bool>> initResults;
+  for (int i = 0; i < numEngines; i++) {
+    std::promise<bool> initDone;
+    initResults.push_back(initDone.get_future());
+    m_threads.emplace_back(&OcrPool::workerLoop, this, std::move(initDone));
+  }
+  bool ok = true;
+  for (auto& res : initResults) {
+    ok = res.get() && ok;
+  }
+  if (!ok) {
+    destroy();
+    return false;
+  }
+  qInfo() << "OcrPool: " << numEngines << "engines, about"
+          << numEngines * config.engineMemoryMb << "Mb";
+  return true;
+}
+
+void OcrPool::destroy() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_cond.notify_all();
+  for (auto& t : m_threads) {
+    t.join();
+  }
+  m_threads.clear();
+}
+
+void OcrPool::workerLoop(std::promise<bool> initDone) {
+  Trace::setThreadName("ocr engine");
+  // engine lives on its own thread only
+  OcrEngine engine;
+  const bool okInit =
+      engine.init(m_config.dataPath.c_str(), m_config.lang.c_str());
+  initDone.set_value(okInit);
+  if (!okInit)
+    return;
+
+  for (;;) {
+    std::unique_ptr<Job> job;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+      // queued jobs are finished before stop
+      if (m_jobs.empty())
+        return;
+      job = std::move(m_jobs.front());
+      m_jobs.pop_front();
+    }
+    // job cancelled while queued: no engine time
+    if ((job->progress != nullptr) && job->progress->isCancelled())
+      job->result.set_value(std::vector<TextBox>());
+    else if (job->pix)
+      job->result.set_value(
+          engine.recognize(job->pix, job->rect, job->progress, job->hPage));
+    else
+      job->result.set_value(
+          engine.recognize(job->image, job->progress, job->hPage));
+  }
+}
+
+std::future<std::vector<TextBox>> OcrPool::push(std::unique_ptr<Job> job) {
+  std::future<std::vector<TextBox>> res = job->result.get_future();
+  if (m_threads.empty()) {
+    qWarning() << "OcrPool: no engines, page is not recognized";
+    job->result.set_value(std::vector<TextBox>());
+    return res;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobs.push_back(std::move(job));
+  }
+  m_cond.notify_one();
+  return res;
+}
+
+std::future<std::vector<TextBox>> OcrPool::submit(const BinImage& image,
+    OcrProgress* progress, int hPage) {
+  auto job = std::make_unique<Job>();
+  // conversion on caller thread: only word copy, engines stay busy with OCR
+  job->pix = OcrEngine::getPix(image);
+  job->progress = progress;
+  job->hPage = hPage;
+  return push(std::move(job));
+}
+
+std::future<std::vector<TextBox>> OcrPool::submit(const QImage& image,
+    OcrProgress* progress, int hPage) {
+  auto job = std::make_unique<Job>();
+  job->image = image;
+  job->progress = progress;
+  job->hPage = hPage;
+  return push(std::move(job));
+}
+
+std::future<std::vector<TextBox>> OcrPool::submit(const SharedPix& pix,
+    const QRect& rect, OcrProgress* progress) {
+  auto job = std::make_unique<Job>();
+  job->pix = pix;
+  job->rect = rect;
+  job->progress = progress;
+  return push(std::move(job));
+}
+
+std::vector<std::vector<TextBox>> OcrPool::recognizePages(
+    const std::vector<BinImage>& pages) {
+  std::vector<std::future<std::vector<TextBox>>> results;
+  results.reserve(pages.size());
+  for (const BinImage& page : pages) {
+    results.push_back(submit(page));
+  }
+  std::vector<std::vector<TextBox>> words;
+  words.reserve(pages.size());
+  for (auto& res : results) {
+    words.push_back(res.get());
+  }
+  return words;
+}
+
+std::vector<TextBox> OcrPool::recognizeBlocks(const BinImage& image,
+    const std::vector<QRect>& blocks) {
+  std::vector<std::future<std::vector<TextBox>>> results;
+  results.reserve(blocks.size());
+  const SharedPix pix = OcrEngine::getPix(image);
+  for (const QRect& rect : blocks) {
+    results.push_back(submit(pix, rect));
+  }
+  std::vector<TextBox> words;
+  for (auto& res : results) {
+    std::vector<TextBox> wordsBlock = res.get();
+    words.insert(words.end(), wordsBlock.begin(), wordsBlock.end());
+  }
+  return words;
+}
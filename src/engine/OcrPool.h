@@ -0,0 +1,108 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _OCR_POOL_H__
+#define _OCR_POOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <QtCore/QRect>
+#include <QtGui/QImage>
+
+#include "BinImage.h"
+#include "OcrEngine.h"
+#include "RecogRes.h"
+
+struct OcrPoolConfig {
+  // trained models directory and language, same for all engines
+  std::string   dataPath = "data/models/";
+  std::string   lang = "rus";
+  // number of engines, 0 means all CPU cores
+  int           numEngines = 0;
+  // memory estimation of one initialized LSTM engine
+  int           engineMemoryMb = 40;
+  // limit of memory for all engines, 0 means no limit
+  int           memoryBudgetMb = 0;
+};
+
+// Pool of pre-initialized Tesseract engines. Every engine is owned by one
+// worker thread, jobs (pages) are taken by idle workers from the common
+// queue. Results are returned by futures, so the caller keeps document
+// order regardless of which engine finished first.
+class OcrPool
+{
+public:
+  OcrPool();
+  ~OcrPool();
+
+  OcrPool(const OcrPool&) = delete;
+  OcrPool& operator=(const OcrPool&) = delete;
+
+  // start workers, engines are initialized in parallel. Returns false
+  // (and starts nothing) if any engine fails to load the model
+  bool init(const OcrPoolConfig& config);
+  // finish queued jobs and stop workers
+  void destroy();
+
+  int getNumEngines() const {
+    return (int)m_threads.size();
+  }
+  // number of engines for config: numEngines limited by memory budget
+  static int getPoolSize(const OcrPoolConfig& config, int numCores);
+
+  // recognize whole page on the first idle engine.
+  // progress (optional) should live until job is finished, its cancel
+  // flag drops the job from queue or stops its engine.
+  // hPage: see OcrEngine::recognize, for image that is a part of page
+  std::future<std::vector<TextBox>> submit(const BinImage& image,
+      OcrProgress* progress = nullptr, int hPage = 0);
+  std::future<std::vector<TextBox>> submit(const QImage& image,
+      OcrProgress* progress = nullptr, int hPage = 0);
+  // recognize page region only. Page PIX (OcrEngine::getPix) is shared
+  // by all its regions
+  std::future<std::vector<TextBox>> submit(const SharedPix& pix,
+      const QRect& rect, OcrProgress* progress = nullptr);
+
+  // words of every page, in pages order
+  std::vector<std::vector<TextBox>> recognizePages(
+      const std::vector<BinImage>& pages);
+  // blocks of one page (see PageLayout) on separate engines, words are
+  // merged in blocks order
+  std::vector<TextBox> recognizeBlocks(const BinImage& image,
+                                       const std::vector<QRect>& blocks);
+
+private:
+  struct Job {
+    // binarized page, or image if pix is null
+    SharedPix                           pix;
+    QImage                              image;
+    // page region, whole page if null
+    QRect                               rect;
+    OcrProgress*                        progress;
+    // page height for word filter, 0: image height
+    int                                 hPage = 0;
+    std::promise<std::vector<TextBox>>  result;
+  };
+
+  std::future<std::vector<TextBox>> push(std::unique_ptr<Job> job);
+  void workerLoop(std::promise<bool> initDone);
+
+  OcrPoolConfig                       m_config;
+  std::vector<std::thread>            m_threads;
+
+  std::mutex                          m_mutex;
+  std::condition_variable             m_cond;
+  std::deque<std::unique_ptr<Job>>    m_jobs;
+  bool                                m_stop;
+};
+
+#endif
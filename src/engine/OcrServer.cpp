@@ -0,0 +1,285 @@
+//
+// Copyright 2022 Vlad
+//
+
+#include <chrono>
+#include <cstring>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDebug>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QSharedMemory>
+
+#include "OcrServer.h"
+#include "ResultWriter.h"
+#include "Trace.h"
+
+static QByteArray getReplyLine(const QJsonObject& reply) {
+  QByteArray line = QJsonDocument(reply).toJson(QJsonDocument::Compact);
+  line.append('\n');
+  return line;
+}
+
+OcrServer::OcrServer(fz_context* ctx, OcrPool* pool)
+    : m_jobs(OCR_SERVER_MAX_JOBS) {
+  m_ctx = ctx;
+  m_pool = pool;
+  m_stop = false;
+}
+
+OcrServer::~OcrServer() {
+  stop();
+}
+
+bool OcrServer::start(const OcrServerConfig& config) {
+  m_config = config;
+  const QString name = QString::fromStdString(config.name);
+  // socket file of crashed server
+  QLocalServer::removeServer(name);
+  if (!m_server.listen(name)) {
+    qWarning() << "OcrServer: cannot listen" << name << ":"
+               << m_server.errorString();
+    return false;
+  }
+  QObject::connect(&m_server, &QLocalServer::newConnection, &m_server,
+                   [this] { onNewConnection(); });
+
+  m_stop = false;
+  const int numThreads =
+      (config.numJobThreads > 0) ? config.numJobThreads : 1;
+  for (int i = 0; i < numThreads; i++) {
+    m_threads.emplace_back(&OcrServer::jobLoop, this);
+  }
+  qInfo() << "OcrServer: listening" << m_server.fullServerName() << ","
+          << m_pool->getNumEngines() << "engines," << numThreads
+          << "job threads";
+  return true;
+}
+
+void OcrServer::stop() {
+  m_stop = true;
+  m_jobs.close();
+  for (std::thread& thread : m_threads) {
+    thread.join();
+  }
+  m_threads.clear();
+  m_server.close();
+}
+
+void OcrServer::onNewConnection() {
+  while (m_server.hasPendingConnections()) {
+    QLocalSocket* socket = m_server.nextPendingConnection();
+    auto cancel = std::make_shared<std::atomic<bool>>(false);
+    QObject::connect(socket, &QLocalSocket::readyRead, socket,
+                     [this, socket, cancel] { onReadyRead(socket, cancel); });
+    // jobs of the client are not needed any more
+    QObject::connect(socket, &QLocalSocket::disconnected, socket,
+                     [socket, cancel] {
+                       *cancel = true;
+                       socket->deleteLater();
+                     });
+  }
+}
+
+void OcrServer::onReadyRead(QLocalSocket* socket,
+    const std::shared_ptr<std::atomic<bool>>& cancel) {
+  while (socket->canReadLine()) {
+    const QByteArray line = socket->readLine().trimmed();
+    if (line.isEmpty())
+      continue;
+    QJsonParseError errorParse;
+    const QJsonDocument doc = QJsonDocument::fromJson(line, &errorParse);
+    auto job = std::make_shared<Job>();
+    job->socket = socket;
+    job->cancel = cancel;
+    if (!doc.isObject()) {
+      sendError(*job, "request is not a JSON object: " +
+                          errorParse.errorString());
+      continue;
+    }
+    job->request = doc.object();
+    job->id = job->request.value("id").toInt();
+    if (job->request.value("command").toString() == "quit") {
+      qInfo() << "OcrServer: quit requested";
+      QCoreApplication::quit();
+      return;
+    }
+    if (!m_jobs.tryPush(std::shared_ptr<Job>(job)))
+      sendError(*job, "server is busy");
+  }
+  if (socket->bytesAvailable() > OCR_SERVER_MAX_REQUEST) {
+    qWarning() << "OcrServer: too long request, client is disconnected";
+    socket->abort();
+  }
+}
+
+void OcrServer::jobLoop() {
+  Trace::setThreadName("server job");
+  // mupdf context is not shared between threads, its clone shares store
+  fz_context* ctx = fz_clone_context(m_ctx);
+  if (ctx == nullptr) {
+    qWarning() << "OcrServer: context has no locks, jobs are not run";
+    return;
+  }
+  std::shared_ptr<Job> job;
+  while (m_jobs.pop(job)) {
+    if (isCancelled(*job))
+      continue;
+    runJob(*job, ctx);
+    job.reset();
+  }
+  fz_drop_context(ctx);
+}
+
+void OcrServer::runJob(Job& job, fz_context* ctx) {
+  const auto timeStart = std::chrono::steady_clock::now();
+  BatchConfig config;
+  QString error;
+  if (!getBatchConfig(job.request, m_config.batch, config, error)) {
+    sendError(job, error);
+    return;
+  }
+
+  BatchStats stats;
+  if (job.request.contains("shm")) {
+    if (!runSharedImage(job, config, error)) {
+      sendError(job, error);
+      return;
+    }
+    stats.numPages = 1;
+  } else {
+    const std::string path =
+        job.request.value("file").toString().toStdString();
+    const std::vector<std::string> files =
+        BatchPipeline::getSourceFiles({path});
+    if (files.empty()) {
+      sendError(job, "no file or shm in request, or file is not found");
+      return;
+    }
+    BatchPipeline pipeline(config, ctx, m_pool);
+    stats = pipeline.run(files, [this, &job, &pipeline](BatchPage& page) {
+      if (isCancelled(job)) {
+        pipeline.cancel();
+        return;
+      }
+      sendReply(job, getPageReply(job.id, page));
+    });
+  }
+  if (isCancelled(job))
+    return;
+
+  const std::chrono::duration<double, std::milli> timeJob =
+      std::chrono::steady_clock::now() - timeStart;
+  QJsonObject reply;
+  reply["id"] = job.id;
+  reply["done"] = true;
+  reply["pages"] = stats.numPages;
+  reply["failed"] = stats.numFailed;
+  reply["ms"] = timeJob.count();
+  sendReply(job, getReplyLine(reply));
+}
+
+bool OcrServer::runSharedImage(Job& job, const BatchConfig& config,
+                               QString& error) {
+  const QString key = job.request.value("shm").toString();
+  const int w = job.request.value("width").toInt();
+  const int h = job.request.value("height").toInt();
+  const int bytesPerLine = job.request.value("bytesPerLine").toInt(w);
+  QSharedMemory memory(key);
+  if (!memory.attach(QSharedMemory::ReadOnly)) {
+    error = "cannot attach shared memory " + key;
+    return false;
+  }
+  if ((w <= 0) || (h <= 0) || (bytesPerLine < w) ||
+      ((qint64)bytesPerLine * h > (qint64)memory.size())) {
+    error = "image size does not match shared memory";
+    return false;
+  }
+  // client may reuse memory as soon as reply comes: pixels are copied
+  QImage image(w, h, QImage::Format::Format_Grayscale8);
+  memory.lock();
+  const uchar* src = (const uchar*)memory.constData();
+  for (int y = 0; y < h; y++) {
+    memcpy(image.scanLine(y), src + (size_t)y * bytesPerLine, w);
+  }
+  memory.unlock();
+  memory.detach();
+
+  BatchPage page;
+  page.fileName = key.toStdString();
+  page.size = image.size();
+  page.imageBin = Binarizer::binarize(image, config.algorithm,
+                                      config.neibSize, config.factor);
+  std::future<std::vector<TextBox>> words =
+      page.imageBin.isNull() ? m_pool->submit(image)
+                             : m_pool->submit(page.imageBin);
+  page.words = words.get();
+  if (!isCancelled(job))
+    sendReply(job, getPageReply(job.id, page));
+  return true;
+}
+
+void OcrServer::sendReply(const Job& job, const QByteArray& line) {
+  const QPointer<QLocalSocket> socket = job.socket;
+  // socket is used on its thread only; disconnected client: line is lost
+  QMetaObject::invokeMethod(&m_server, [socket, line] {
+    if (socket != nullptr)
+      socket->write(line);
+  }, Qt::QueuedConnection);
+}
+
+void OcrServer::sendError(const Job& job, const QString& error) {
+  QJsonObject reply;
+  reply["id"] = job.id;
+  reply["error"] = error;
+  sendReply(job, getReplyLine(reply));
+}
+
+bool OcrServer::getBatchConfig(const QJsonObject& request,
+                               const BatchConfig& configDefault,
+                               BatchConfig& config, QString& error) {
+  config = configDefault;
+  if (request.contains("algorithm")) {
+    const QByteArray name = request.value("algorithm").toString().toUtf8();
+    if (!Binarizer::getTypeByName(name.constData(), config.algorithm)) {
+      error = "unknown algorithm";
+      return false;
+    }
+  }
+  if (request.contains("range"))
+    config.neibSize = request.value("range").toInt(config.neibSize);
+  if (request.contains("factor"))
+    config.factor = (float)request.value("factor").toDouble(config.factor);
+  if (request.contains("scale")) {
+    const QJsonValue scale = request.value("scale");
+    if (scale.toString() == "auto")
+      config.scale = 0.0F;
+    else
+      config.scale = (float)scale.toDouble(config.scale);
+  }
+  if (request.contains("text")) {
+    const QString text = request.value("text").toString();
+    if (text == "ocr") {
+      config.textLayerPolicy = TextLayerPolicy::ALWAYS_OCR;
+    } else if (text == "auto") {
+      config.textLayerPolicy = TextLayerPolicy::AUTO;
+    } else if (text == "layer") {
+      config.textLayerPolicy = TextLayerPolicy::TEXT_LAYER_ONLY;
+    } else {
+      error = "unknown text layer usage";
+      return false;
+    }
+  }
+  if ((config.neibSize < 1) || (config.factor <= 0.0F) ||
+      (config.scale < 0.0F)) {
+    error = "invalid binarization or scale parameters";
+    return false;
+  }
+  return true;
+}
+
+QByteArray OcrServer::getPageReply(int id, const BatchPage& page) {
+  QJsonObject reply = ResultWriter::getPageJson(page);
+  reply["id"] = id;
+  return getReplyLine(reply);
+}
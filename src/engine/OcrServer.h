@@ -0,0 +1,129 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _OCR_SERVER_H__
+#define _OCR_SERVER_H__
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QJsonObject>
+#include <QtCore/QPointer>
+#include <QtCore/QString>
+#include <QtNetwork/QLocalServer>
+#include <QtNetwork/QLocalSocket>
+
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable : 4100)
+#pragma warning(disable : 4611)
+#endif
+
+#include "mupdf/fitz.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+#include "BatchPipeline.h"
+#include "BoundedQueue.h"
+#include "OcrPool.h"
+
+// jobs running at the same time, they share engines of the pool
+#define OCR_SERVER_JOB_THREADS  2
+// pending jobs of all clients, more are rejected
+#define OCR_SERVER_MAX_JOBS     64
+// longer request line: client is disconnected
+#define OCR_SERVER_MAX_REQUEST  65536
+
+struct OcrServerConfig {
+  // local socket name: Unix domain socket (in temp directory if not
+  // absolute path) or Windows named pipe
+  std::string   name = "imb-ocr";
+  int           numJobThreads = OCR_SERVER_JOB_THREADS;
+  // job parameters missing in request
+  BatchConfig   batch;
+};
+
+// Resident recognizer: mupdf context and Tesseract engines are initialized
+// once, so a request costs only its own compute. Clients connect to local
+// socket and send requests, one JSON object per line:
+//   {"id": 1, "file": "/path/doc.pdf"}
+//   {"id": 2, "shm": "key", "width": 1700, "height": 2200,
+//    "bytesPerLine": 1700}              gray 8 bpp image in QSharedMemory
+// optional parameters: "algorithm": "sauvola|fast|leptonica|none",
+// "range": 7, "factor": 0.25, "scale": 2.0 or "auto",
+// "text": "ocr|auto|layer".
+//   {"command": "quit"}                 stops the server
+// Every page is sent back as soon as it is recognized, then the job end:
+//   {"id": 1, "file": ..., "page": 0, "width": ..., "height": ...,
+//    "textLayer": false, "words": [{"box": [x, y, w, h], "text": ...,
+//    "conf": 91.5}, ...]}
+//   {"id": 1, "done": true, "pages": 3, "failed": 0, "ms": 812.5}
+// or {"id": 1, "error": "..."}. Jobs of a disconnected client are
+// cancelled.
+// Lives on the thread with Qt event loop, jobs run on own threads.
+class OcrServer
+{
+public:
+  // ctx should be created with locks (FzLocks), every job works on its
+  // clone. Pool should be initialized, both should outlive the server
+  OcrServer(fz_context* ctx, OcrPool* pool);
+  ~OcrServer();
+
+  OcrServer(const OcrServer&) = delete;
+  OcrServer& operator=(const OcrServer&) = delete;
+
+  // false if socket cannot be listened
+  bool start(const OcrServerConfig& config);
+  // cancel jobs, wait for job threads, close connections
+  void stop();
+
+  // request parameters over config defaults. false (and error text) for
+  // invalid parameter
+  static bool getBatchConfig(const QJsonObject& request,
+                             const BatchConfig& configDefault,
+                             BatchConfig& config, QString& error);
+  // one line of reply for page of job id: ResultWriter::getPageJson
+  // with id
+  static QByteArray getPageReply(int id, const BatchPage& page);
+
+private:
+  struct Job {
+    int                                 id = 0;
+    QJsonObject                         request;
+    // dereferenced on server thread only
+    QPointer<QLocalSocket>              socket;
+    std::shared_ptr<std::atomic<bool>>  cancel;
+  };
+
+  void onNewConnection();
+  // cancel is shared by all jobs of the connection
+  void onReadyRead(QLocalSocket* socket,
+                   const std::shared_ptr<std::atomic<bool>>& cancel);
+  void jobLoop();
+  void runJob(Job& job, fz_context* ctx);
+  // image from shared memory is recognized as one page
+  bool runSharedImage(Job& job, const BatchConfig& config, QString& error);
+  bool isCancelled(const Job& job) const {
+    return m_stop || job.cancel->load();
+  }
+  // any thread: line is written by server thread, if client is connected
+  void sendReply(const Job& job, const QByteArray& line);
+  void sendError(const Job& job, const QString& error);
+
+  fz_context*                         m_ctx;
+  OcrPool*                            m_pool;
+  OcrServerConfig                     m_config;
+  QLocalServer                        m_server;
+  BoundedQueue<std::shared_ptr<Job>>  m_jobs;
+  std::vector<std::thread>            m_threads;
+  std::atomic<bool>                   m_stop;
+};
+
+#endif
@@ -0,0 +1,86 @@
+//
+// Copyright 2022 Vlad
+//
+
+#include "PageCache.h"
+
+static size_t getImageBytes(const QImage& image) {
+  return (size_t)image.bytesPerLine() * (size_t)image.height();
+}
+
+PageCache::PageCache(size_t budgetBytes) : m_budgetBytes(budgetBytes) {
+  m_sizeBytes = 0;
+}
+
+bool PageCache::get(const PageKey& key, QImage& image) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+    if (it->key == key) {
+      m_entries.splice(m_entries.begin(), m_entries, it);
+      image = m_entries.front().image;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool PageCache::contains(const PageKey& key) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (const Entry& entry : m_entries) {
+    if (entry.key == key)
+      return true;
+  }
+  return false;
+}
+
+void PageCache::put(const PageKey& key, const QImage& image) {
+  const size_t bytes = getImageBytes(image);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+    if (it->key == key) {
+      m_sizeBytes -= getImageBytes(it->image);
+      m_entries.erase(it);
+      break;
+    }
+  }
+  if (image.isNull() || (bytes > m_budgetBytes))
+    return;
+  m_entries.push_front(Entry{key, image});
+  m_sizeBytes += bytes;
+  evict();
+}
+
+void PageCache::evict() {
+  while ((m_sizeBytes > m_budgetBytes) && !m_entries.empty()) {
+    m_sizeBytes -= getImageBytes(m_entries.back().image);
+    m_entries.pop_back();
+  }
+}
+
+void PageCache::removeDocument(int docId) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto it = m_entries.begin(); it != m_entries.end();) {
+    if (it->key.docId == docId) {
+      m_sizeBytes -= getImageBytes(it->image);
+      it = m_entries.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void PageCache::clear() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_entries.clear();
+  m_sizeBytes = 0;
+}
+
+size_t PageCache::getSizeBytes() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_sizeBytes;
+}
+
+int PageCache::getNumPages() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return (int)m_entries.size();
+}
@@ -0,0 +1,66 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _PAGE_CACHE_H__
+#define _PAGE_CACHE_H__
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+
+#include <QtGui/QImage>
+
+// rendered page identity: same key gives the same pixels
+struct PageKey {
+  // document serial number (not pointer: addresses are reused)
+  int       docId = 0;
+  int       pageIndex = 0;
+  float     scale = 1.0F;
+  float     rotate = 0.0F;
+
+  bool operator==(const PageKey& other) const {
+    return (docId == other.docId) && (pageIndex == other.pageIndex) &&
+           (scale == other.scale) && (rotate == other.rotate);
+  }
+};
+
+// Thread-safe LRU cache of rendered pages, limited by pixels memory.
+// Images are implicitly shared: hit returns without pixels copy.
+class PageCache
+{
+public:
+  explicit PageCache(size_t budgetBytes);
+
+  // true and image on hit, page becomes most recently used
+  bool get(const PageKey& key, QImage& image);
+  bool contains(const PageKey& key);
+  // least recently used pages are evicted over budget. Page larger than
+  // the whole budget is not stored
+  void put(const PageKey& key, const QImage& image);
+  void removeDocument(int docId);
+  void clear();
+
+  size_t getSizeBytes();
+  int getNumPages();
+  size_t getBudgetBytes() const {
+    return m_budgetBytes;
+  }
+
+private:
+  struct Entry {
+    PageKey   key;
+    QImage    image;
+  };
+
+  // under m_mutex
+  void evict();
+
+  std::mutex          m_mutex;
+  // front is most recently used
+  std::list<Entry>    m_entries;
+  size_t              m_sizeBytes;
+  const size_t        m_budgetBytes;
+};
+
+#endif
@@ -0,0 +1,184 @@
+//
+// Copyright 2022 Vlad
+//
+
+#include <algorithm>
+#include <bitset>
+
+#include "PageLayout.h"
+#include "Trace.h"
+
+// recursion limit of XY-cut
+constexpr int cPageLayoutMaxDepth = 16;
+
+struct ProfileGap {
+  // first index of white run and its length
+  int start = 0;
+  int length = 0;
+};
+
+// black pixels count of every row and column of rc
+static void getProfiles(const BinImage& image, const QRect& rc,
+                        std::vector<int>& rows, std::vector<int>& cols) {
+  const int x0 = rc.left();
+  const int x1 = rc.right();
+  rows.assign(rc.height(), 0);
+  cols.assign(rc.width(), 0);
+
+  // masks of valid pixels in the first and the last words
+  const int indexWordFirst = x0 >> 6;
+  const int indexWordLast = x1 >> 6;
+  uint64_t maskFirst = 0;
+  uint64_t maskLast = 0;
+  for (int x = x0; (x <= x1) && ((x >> 6) == indexWordFirst); x++) {
+    maskFirst |= BinImage::getMask(x);
+  }
+  for (int x = indexWordLast * 64; x <= x1; x++) {
+    maskLast |= BinImage::getMask(x);
+  }
+
+  for (int y = rc.top(); y <= rc.bottom(); y++) {
+    const uint64_t* line = image.getLine(y);
+    int numBlack = 0;
+    for (int i = indexWordFirst; i <= indexWordLast; i++) {
+      uint64_t mask = ~(uint64_t)0;
+      if (i == indexWordFirst)
+        mask &= maskFirst;
+      if (i == indexWordLast)
+        mask &= maskLast;
+      const uint64_t black = ~line[i] & mask;
+      if (black == 0)
+        continue;
+      numBlack += (int)std::bitset<64>(black).count();
+      // byte b of word holds pixels i * 64 + b * 8 .. + 7, msb first
+      for (int b = 0; b < 8; b++) {
+        const auto val = (uint32_t)((black >> (b * 8)) & 0xff);
+        if (val == 0)
+          continue;
+        const int xByte = i * 64 + b * 8 - x0;
+        for (int bit = 0; bit < 8; bit++) {
+          if ((val >> (7 - bit)) & 1)
+            cols[xByte + bit]++;
+        }
+      }  // for b
+    }    // for i
+    rows[y - rc.top()] = numBlack;
+  }  // for y
+}
+
+// first and last non zero profile values, false if all zero
+static bool getContentRange(const std::vector<int>& profile, int& first,
+                            int& last) {
+  const int num = (int)profile.size();
+  first = 0;
+  while ((first < num) && (profile[first] == 0))
+    first++;
+  if (first == num)
+    return false;
+  last = num - 1;
+  while (profile[last] == 0)
+    last--;
+  return true;
+}
+
+// widest white run inside [first .. last]
+static ProfileGap getWidestGap(const std::vector<int>& profile, int first,
+                               int last) {
+  ProfileGap gap;
+  int runStart = -1;
+  for (int i = first; i <= last; i++) {
+    if (profile[i] == 0) {
+      if (runStart < 0)
+        runStart = i;
+      continue;
+    }
+    if ((runStart >= 0) && (i - runStart > gap.length)) {
+      gap.start = runStart;
+      gap.length = i - runStart;
+    }
+    runStart = -1;
+  }
+  return gap;
+}
+
+static void cutBlock(const BinImage& image, const QRect& rc,
+                     const PageLayoutParams& params, int minGapX,
+                     int minGapY, int depth, std::vector<QRect>& blocks) {
+  std::vector<int> rows, cols;
+  getProfiles(image, rc, rows, cols);
+
+  // trim white borders
+  int yFirst, yLast, xFirst, xLast;
+  if (!getContentRange(rows, yFirst, yLast))
+    return;
+  getContentRange(cols, xFirst, xLast);
+  const QRect rcContent(rc.left() + xFirst, rc.top() + yFirst,
+                        xLast - xFirst + 1, yLast - yFirst + 1);
+  if ((rcContent.width() < params.minBlockSize) ||
+      (rcContent.height() < params.minBlockSize))
+    return;
+
+  const ProfileGap gapY = getWidestGap(rows, yFirst, yLast);
+  const ProfileGap gapX = getWidestGap(cols, xFirst, xLast);
+  const bool canSplitY = gapY.length >= minGapY;
+  const bool canSplitX = gapX.length >= minGapX;
+  if ((depth >= cPageLayoutMaxDepth) || (!canSplitY && !canSplitX)) {
+    blocks.push_back(rcContent);
+    return;
+  }
+
+  // wider gap (relative to its threshold) first
+  const bool isSplitY =
+      canSplitY &&
+      (!canSplitX || ((int64_t)gapY.length * minGapX >=
+                      (int64_t)gapX.length * minGapY));
+  if (isSplitY) {
+    const int ySplit = rc.top() + gapY.start;
+    const int yNext = ySplit + gapY.length;
+    cutBlock(image,
+             QRect(rcContent.left(), rcContent.top(), rcContent.width(),
+                   ySplit - rcContent.top()),
+             params, minGapX, minGapY, depth + 1, blocks);
+    cutBlock(image,
+             QRect(rcContent.left(), yNext, rcContent.width(),
+                   rcContent.bottom() + 1 - yNext),
+             params, minGapX, minGapY, depth + 1, blocks);
+  } else {
+    const int xSplit = rc.left() + gapX.start;
+    const int xNext = xSplit + gapX.length;
+    cutBlock(image,
+             QRect(rcContent.left(), rcContent.top(),
+                   xSplit - rcContent.left(), rcContent.height()),
+             params, minGapX, minGapY, depth + 1, blocks);
+    cutBlock(image,
+             QRect(xNext, rcContent.top(), rcContent.right() + 1 - xNext,
+                   rcContent.height()),
+             params, minGapX, minGapY, depth + 1, blocks);
+  }
+}
+
+std::vector<QRect> PageLayout::getTextBlocks(const BinImage& image,
+    const PageLayoutParams& params) {
+  TRACE_ZONE("pageLayout");
+  std::vector<QRect> blocks;
+  if (image.isNull())
+    return blocks;
+  const int w = image.width();
+  const int h = image.height();
+  int minGapX = params.minGapX;
+  if (minGapX <= 0)
+    minGapX = std::max(w / PAGE_LAYOUT_GAP_DIV_X, 2);
+  int minGapY = params.minGapY;
+  if (minGapY <= 0)
+    minGapY = std::max(h / PAGE_LAYOUT_GAP_DIV_Y, 2);
+
+  const QRect rcPage(0, 0, w, h);
+  cutBlock(image, rcPage, params, minGapX, minGapY, 0, blocks);
+
+  for (QRect& rc : blocks) {
+    rc = rc.adjusted(-params.margin, -params.margin, params.margin,
+                     params.margin)
+             .intersected(rcPage);
+  }
+  return blocks;
+}
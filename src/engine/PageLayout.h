@@ -0,0 +1,40 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _PAGE_LAYOUT_H__
+#define _PAGE_LAYOUT_H__
+
+#include <vector>
+
+#include <QtCore/QRect>
+
+#include "BinImage.h"
+
+struct PageLayoutParams {
+  // white gap (pixels), which separates columns / blocks.
+  // 0 means relative to page size (see PAGE_LAYOUT_GAP_DIV)
+  int     minGapX = 0;
+  int     minGapY = 0;
+  // blocks with smaller width or height are noise
+  int     minBlockSize = 4;
+  // white border added around every block (clipped by page)
+  int     margin = 4;
+};
+
+// page size / gap for default gap sizes
+#define PAGE_LAYOUT_GAP_DIV_X   50
+#define PAGE_LAYOUT_GAP_DIV_Y   60
+
+// Cheap text block segmentation of binarized page by recursive XY-cut:
+// block is split by the widest white gap of its horizontal or vertical
+// black pixels projection profile, while gap is wide enough.
+// Profiles are counted by 64-bit words, white words are skipped.
+class PageLayout {
+ public:
+  // blocks in reading order: top to bottom, columns left to right
+  static std::vector<QRect> getTextBlocks(const BinImage& image,
+      const PageLayoutParams& params = PageLayoutParams());
+};
+
+#endif
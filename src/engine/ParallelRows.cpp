@@ -0,0 +1,33 @@
+//
+// Copyright 2022 Vlad
+//
+
+#include "ParallelRows.h"
+#include "ThreadPool.h"
+
+// too thin bands are not worth a thread
+const int PARALLEL_MIN_ROWS_PER_BAND = 16;
+
+int ParallelRows::getNumBands(int numRows) {
+  int numBands = numRows / PARALLEL_MIN_ROWS_PER_BAND;
+  const int numThreads = ThreadPool::instance().getNumWorkers();
+  if (numBands > numThreads)
+    numBands = numThreads;
+  return (numBands >= 1) ? numBands : 1;
+}
+
+void ParallelRows::run(int numRows, int numBands,
+                       const std::function<void(int, int, int)>& body) {
+  if (numBands <= 1) {
+    body(0, 0, numRows);
+    return;
+  }
+  ThreadPool::instance().parallelFor(0, numBands,
+                                     [&](int bandStart, int bandEnd) {
+    for (int i = bandStart; i < bandEnd; i++) {
+      const int yStart = i * numRows / numBands;
+      const int yEnd = (i + 1) * numRows / numBands;
+      body(i, yStart, yEnd);
+    }
+  });
+}
@@ -0,0 +1,26 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _PARALLEL_ROWS_H__
+#define _PARALLEL_ROWS_H__
+
+#include <functional>
+
+// Row-band parallelism for engine kernels, which need fixed band layout
+// (e.g. two-level scans): image rows are split into horizontal bands of
+// nearly equal height, processed simultaneously on ThreadPool.
+// Number of threads: see ThreadPool::setNumWorkers.
+class ParallelRows {
+ public:
+  // number of bands for numRows, limited by number of pool workers
+  static int  getNumBands(int numRows);
+
+  // process rows [0 .. numRows) by body(indexBand, yStart, yEnd) calls,
+  // one call per band. Returns after all bands are finished.
+  // Band i is [i * numRows / numBands .. (i + 1) * numRows / numBands)
+  static void run(int numRows, int numBands,
+                  const std::function<void(int, int, int)>& body);
+};
+
+#endif
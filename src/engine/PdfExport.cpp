@@ -0,0 +1,324 @@
+//
+// Copyright 2022 Vlad
+//
+
+#include <cstring>
+
+#include <QtCore/QDebug>
+
+#include "PdfExport.h"
+
+// objects written at open
+#define PDF_OBJ_CATALOG   1
+#define PDF_OBJ_PAGES     2
+
+static const char* const g_toUnicode =
+    "/CIDInit /ProcSet findresource begin\n"
+    "12 dict begin\n"
+    "begincmap\n"
+    "/CIDSystemInfo << /Registry (Adobe) /Ordering (UCS) /Supplement 0 >> "
+    "def\n"
+    "/CMapName /Adobe-Identity-UCS def\n"
+    "/CMapType 2 def\n"
+    "1 begincodespacerange\n"
+    "<0000> <FFFF>\n"
+    "endcodespacerange\n"
+    "1 beginbfrange\n"
+    "<0000> <FFFF> <0000>\n"
+    "endbfrange\n"
+    "endcmap\n"
+    "CMapName currentdict /CMap defineresource pop\n"
+    "end\n"
+    "end\n";
+
+// rows without padding, as pdf image stream wants them. numComps 0 is
+// 1 bpp image with bit 1 white (CCITT encoder input)
+static void packImage(const QImage& image, std::vector<unsigned char>& pixels,
+                      int& numComps) {
+  QImage src = image;
+  if (src.format() == QImage::Format_MonoLSB)
+    src = src.convertToFormat(QImage::Format_Mono);
+  int rowBytes = 0;
+  bool isInverted = false;
+  if (src.format() == QImage::Format_Mono) {
+    numComps = 0;
+    rowBytes = (src.width() + 7) / 8;
+    // color 0 is lighter: zero bits are white
+    isInverted = (src.colorCount() >= 2) &&
+                 (qGray(src.color(0)) > qGray(src.color(1)));
+  } else if (src.isGrayscale()) {
+    src = src.convertToFormat(QImage::Format_Grayscale8);
+    numComps = 1;
+    rowBytes = src.width();
+  } else {
+    src = src.convertToFormat(QImage::Format_RGB888);
+    numComps = 3;
+    rowBytes = src.width() * 3;
+  }
+  pixels.resize((size_t)rowBytes * src.height());
+  for (int y = 0; y < src.height(); y++) {
+    unsigned char* dst = pixels.data() + (size_t)y * rowBytes;
+    memcpy(dst, src.constScanLine(y), rowBytes);
+    if (isInverted) {
+      for (int x = 0; x < rowBytes; x++) {
+        dst[x] = (unsigned char)~dst[x];
+      }
+    }
+  }
+}
+
+// pdf operators of page: image fills the page, every word is a run of
+// invisible glyphs over its box. fz_snprintf does not depend on C locale
+static std::string getContent(int w, int h, float scale,
+                              const std::vector<TextBox>& words) {
+  const float wPage = (float)w / scale;
+  const float hPage = (float)h / scale;
+  char str[160];
+  std::string content;
+  content.reserve(64 + words.size() * 96);
+  fz_snprintf(str, sizeof(str), "q %g 0 0 %g 0 0 cm /Im0 Do Q\n", wPage,
+              hPage);
+  content.append(str);
+  if (words.empty())
+    return content;
+
+  // render mode 3: neither fill nor stroke
+  content.append("BT\n3 Tr\n");
+  for (const TextBox& tb : words) {
+    const QRect& rect = tb.m_rect;
+    const int numChars = tb.m_text.size();
+    if ((numChars == 0) || (rect.width() <= 0) || (rect.height() <= 0) ||
+        tb.m_text.trimmed().isEmpty())
+      continue;
+    const float fontSize = (float)rect.height() / scale;
+    const float wText = (float)numChars * fontSize *
+                        PDF_EXPORT_GLYPH_WIDTH / 1000.0F;
+    // horizontal stretch of glyph runs to box width, %
+    const float stretch = 100.0F * ((float)rect.width() / scale) / wText;
+    // baseline is the bottom of the box
+    const float x = (float)rect.left() / scale;
+    const float y = hPage - (float)(rect.top() + rect.height()) / scale;
+    fz_snprintf(str, sizeof(str), "/F0 %g Tf %g Tz 1 0 0 1 %g %g Tm <",
+                fontSize, stretch, x, y);
+    content.append(str);
+    // Identity-H: 2 byte codes, UTF-16 code units
+    const ushort* utf16 = tb.m_text.utf16();
+    for (int i = 0; i < numChars; i++) {
+      fz_snprintf(str, sizeof(str), "%04x", (unsigned)utf16[i]);
+      content.append(str);
+    }
+    content.append("> Tj\n");
+  }
+  content.append("ET\n");
+  return content;
+}
+
+PdfExport::PdfExport(fz_context* ctx) {
+  m_ctx = fz_clone_context(ctx);
+  m_out = nullptr;
+  m_objFont = 0;
+}
+
+PdfExport::~PdfExport() {
+  if (m_out != nullptr)
+    close();
+  if (m_ctx != nullptr)
+    fz_drop_context(m_ctx);
+}
+
+int PdfExport::newObject() {
+  m_offsets.push_back(0);
+  return (int)m_offsets.size() - 1;
+}
+
+void PdfExport::beginObject(int num) {
+  m_offsets[num] = fz_tell_output(m_ctx, m_out);
+  fz_write_printf(m_ctx, m_out, "%d 0 obj\n", num);
+}
+
+void PdfExport::writeStream(int num, const char* dict,
+                            const unsigned char* data, size_t size) {
+  beginObject(num);
+  fz_write_printf(m_ctx, m_out, "<< %s /Length %zu >>\nstream\n", dict,
+                  size);
+  fz_write_data(m_ctx, m_out, data, size);
+  fz_write_string(m_ctx, m_out, "\nendstream\nendobj\n");
+}
+
+void PdfExport::writeFont() {
+  const int objDescendant = newObject();
+  const int objDescriptor = newObject();
+  const int objToUnicode = newObject();
+  beginObject(m_objFont);
+  fz_write_printf(m_ctx, m_out,
+                  "<< /Type /Font /Subtype /Type0 /BaseFont /GlyphLessFont "
+                  "/Encoding /Identity-H /DescendantFonts [%d 0 R] "
+                  "/ToUnicode %d 0 R >>\nendobj\n",
+                  objDescendant, objToUnicode);
+  beginObject(objDescendant);
+  fz_write_printf(m_ctx, m_out,
+                  "<< /Type /Font /Subtype /CIDFontType2 "
+                  "/BaseFont /GlyphLessFont /CIDSystemInfo << /Registry "
+                  "(Adobe) /Ordering (Identity) /Supplement 0 >> "
+                  "/FontDescriptor %d 0 R /DW %d /CIDToGIDMap /Identity "
+                  ">>\nendobj\n",
+                  objDescriptor, PDF_EXPORT_GLYPH_WIDTH);
+  // font program is not embedded: glyphs are never painted
+  beginObject(objDescriptor);
+  fz_write_printf(m_ctx, m_out,
+                  "<< /Type /FontDescriptor /FontName /GlyphLessFont "
+                  "/Flags 5 /FontBBox [0 0 %d 1000] /ItalicAngle 0 "
+                  "/Ascent 1000 /Descent 0 /CapHeight 1000 /StemV 80 "
+                  ">>\nendobj\n",
+                  PDF_EXPORT_GLYPH_WIDTH);
+  writeStream(objToUnicode, "", (const unsigned char*)g_toUnicode,
+              strlen(g_toUnicode));
+}
+
+bool PdfExport::open(const char* fileName) {
+  if (m_ctx == nullptr) {
+    qWarning() << "PdfExport: context has no locks";
+    return false;
+  }
+  if (m_out != nullptr)
+    return false;
+  m_offsets.assign(1, 0);
+  m_pages.clear();
+  newObject();
+  newObject();
+  m_objFont = newObject();
+  fz_try(m_ctx) {
+    m_out = fz_new_output_with_path(m_ctx, fileName, 0);
+    // comment with high bytes: file is binary
+    fz_write_string(m_ctx, m_out, "%PDF-1.7\n%\xC2\xB5\xC2\xB6\n");
+    beginObject(PDF_OBJ_CATALOG);
+    fz_write_printf(m_ctx, m_out,
+                    "<< /Type /Catalog /Pages %d 0 R >>\nendobj\n",
+                    PDF_OBJ_PAGES);
+    writeFont();
+  }
+  fz_catch(m_ctx) {
+    qWarning() << "PdfExport: cannot write" << fileName;
+    dropOutput();
+    return false;
+  }
+  return true;
+}
+
+bool PdfExport::addPage(const QImage& image, float scale,
+                        const std::vector<TextBox>& words) {
+  if ((m_out == nullptr) || image.isNull() || (scale <= 0.0F))
+    return false;
+  // everything with destructors is prepared before mupdf calls, mupdf
+  // errors jump over C++ scopes
+  std::vector<unsigned char> pixels;
+  int numComps = 0;
+  packImage(image, pixels, numComps);
+  const std::string content =
+      getContent(image.width(), image.height(), scale, words);
+  const int w = image.width();
+  const int h = image.height();
+  char dictImage[256];
+  if (numComps == 0) {
+    fz_snprintf(dictImage, sizeof(dictImage),
+                "/Type /XObject /Subtype /Image /Width %d /Height %d "
+                "/ColorSpace /DeviceGray /BitsPerComponent 1 "
+                "/Filter /CCITTFaxDecode /DecodeParms << /K -1 /Columns %d "
+                "/Rows %d >>",
+                w, h, w, h);
+  } else {
+    fz_snprintf(dictImage, sizeof(dictImage),
+                "/Type /XObject /Subtype /Image /Width %d /Height %d "
+                "/ColorSpace %s /BitsPerComponent 8 /Filter /FlateDecode",
+                w, h, (numComps == 1) ? "/DeviceGray" : "/DeviceRGB");
+  }
+  const int objPage = newObject();
+  const int objContent = newObject();
+  const int objImage = newObject();
+
+  fz_buffer* bufFax = nullptr;
+  unsigned char* dataImage = nullptr;
+  unsigned char* dataContent = nullptr;
+  size_t sizeImage = 0;
+  size_t sizeContent = 0;
+  fz_var(bufFax);
+  fz_var(dataImage);
+  fz_var(dataContent);
+  fz_var(sizeImage);
+  fz_try(m_ctx) {
+    if (numComps == 0) {
+      bufFax = fz_compress_ccitt_fax_g4(m_ctx, pixels.data(), w, h);
+      unsigned char* data = nullptr;
+      sizeImage = fz_buffer_storage(m_ctx, bufFax, &data);
+      writeStream(objImage, dictImage, data, sizeImage);
+    } else {
+      dataImage = fz_new_deflated_data(m_ctx, &sizeImage, pixels.data(),
+                                       pixels.size(), FZ_DEFLATE_DEFAULT);
+      writeStream(objImage, dictImage, dataImage, sizeImage);
+    }
+    dataContent = fz_new_deflated_data(
+        m_ctx, &sizeContent, (const unsigned char*)content.data(),
+        content.size(), FZ_DEFLATE_DEFAULT);
+    writeStream(objContent, "/Filter /FlateDecode", dataContent,
+                sizeContent);
+    beginObject(objPage);
+    fz_write_printf(m_ctx, m_out,
+                    "<< /Type /Page /Parent %d 0 R /MediaBox [0 0 %g %g] "
+                    "/Resources << /XObject << /Im0 %d 0 R >> "
+                    "/Font << /F0 %d 0 R >> >> /Contents %d 0 R >>\n"
+                    "endobj\n",
+                    PDF_OBJ_PAGES, (float)w / scale, (float)h / scale,
+                    objImage, m_objFont, objContent);
+  }
+  fz_always(m_ctx) {
+    fz_drop_buffer(m_ctx, bufFax);
+    fz_free(m_ctx, dataImage);
+    fz_free(m_ctx, dataContent);
+  }
+  fz_catch(m_ctx) {
+    qWarning() << "PdfExport: cannot write page" << getNumPages() + 1;
+    dropOutput();
+    return false;
+  }
+  m_pages.push_back(objPage);
+  return true;
+}
+
+bool PdfExport::close() {
+  if (m_out == nullptr)
+    return false;
+  bool ok = true;
+  fz_try(m_ctx) {
+    beginObject(PDF_OBJ_PAGES);
+    fz_write_printf(m_ctx, m_out, "<< /Type /Pages /Count %d /Kids [",
+                    getNumPages());
+    for (int objPage : m_pages) {
+      fz_write_printf(m_ctx, m_out, " %d 0 R", objPage);
+    }
+    fz_write_string(m_ctx, m_out, " ] >>\nendobj\n");
+
+    const int64_t offsetXref = fz_tell_output(m_ctx, m_out);
+    const int numObjects = (int)m_offsets.size();
+    fz_write_printf(m_ctx, m_out, "xref\n0 %d\n0000000000 65535 f \n",
+                    numObjects);
+    for (int i = 1; i < numObjects; i++) {
+      fz_write_printf(m_ctx, m_out, "%010ld 00000 n \n", m_offsets[i]);
+    }
+    fz_write_printf(m_ctx, m_out,
+                    "trailer\n<< /Size %d /Root %d 0 R >>\nstartxref\n%ld\n",
+                    numObjects, PDF_OBJ_CATALOG, offsetXref);
+    fz_write_string(m_ctx, m_out, "%EOF\n");
+    fz_close_output(m_ctx, m_out);
+  }
+  fz_catch(m_ctx) {
+    qWarning() << "PdfExport: cannot finish document";
+    ok = false;
+  }
+  dropOutput();
+  return ok;
+}
+
+void PdfExport::dropOutput() {
+  fz_drop_output(m_ctx, m_out);
+  m_out = nullptr;
+}
@@ -0,0 +1,86 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _PDF_EXPORT_H__
+#define _PDF_EXPORT_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <QtGui/QImage>
+
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable : 4100)
+#pragma warning(disable : 4611)
+#endif
+
+#include "mupdf/fitz.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+#include "RecogRes.h"
+
+// glyph width of text layer font, 1/1000 of font size
+#define PDF_EXPORT_GLYPH_WIDTH  500
+
+// Searchable pdf: page image with invisible words (text render mode 3)
+// over it, so text of the scan can be searched, selected and copied.
+// Every page is written to the output as soon as it is added, only object
+// offsets stay in memory, so documents of any length are exported in
+// constant memory. Words are shown with one font without glyphs (Type0,
+// Identity-H, UTF-16 codes are glyph ids and map to the same unicode),
+// stretched by Tz to fill their boxes, like Tesseract pdf renderer does.
+class PdfExport
+{
+public:
+  // ctx is cloned (it should be created with locks, FzLocks): pages may be
+  // added by any thread, one at a time. ctx should outlive exporter
+  explicit PdfExport(fz_context* ctx);
+  // closes unfinished document
+  ~PdfExport();
+
+  PdfExport(const PdfExport&) = delete;
+  PdfExport& operator=(const PdfExport&) = delete;
+
+  // creates file and writes document header. false on error
+  bool open(const char* fileName);
+  // scale: image pixels per pdf point (pdf render scale). Format_Mono
+  // image is CCITT G4 compressed, others are deflated gray or rgb.
+  // Words are in image pixels
+  bool addPage(const QImage& image, float scale,
+               const std::vector<TextBox>& words);
+  // writes pages tree, cross reference table and trailer
+  bool close();
+
+  int getNumPages() const {
+    return (int)m_pages.size();
+  }
+  bool isOpen() const {
+    return m_out != nullptr;
+  }
+
+private:
+  // reserves number of object to be written later
+  int newObject();
+  void beginObject(int num);
+  void writeFont();
+  void writeStream(int num, const char* dict, const unsigned char* data,
+                   size_t size);
+  // error: output is dropped, file is left unfinished
+  void dropOutput();
+
+  fz_context*           m_ctx;
+  fz_output*            m_out;
+  // file offset of every object, index is object number
+  std::vector<int64_t>  m_offsets;
+  // objects of pages
+  std::vector<int>      m_pages;
+  int                   m_objFont;
+};
+
+#endif
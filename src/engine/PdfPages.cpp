@@ -0,0 +1,172 @@
+//
+// Copyright 2022 Vlad
+//
+
+#include <QtCore/QDebug>
+
+#include "PdfRender.h"
+#include "PdfPages.h"
+#include "Trace.h"
+
+PdfPages::PdfPages() {
+  m_ctx = nullptr;
+  m_ctxPrefetch = nullptr;
+  m_doc = nullptr;
+  m_docId = 0;
+  m_docNumPages = 0;
+  m_isRendering = false;
+  m_stop = false;
+  m_numHits = 0;
+  m_numMisses = 0;
+}
+
+PdfPages::~PdfPages() {
+  stop();
+}
+
+bool PdfPages::start(fz_context* ctx, size_t cacheBytes) {
+  m_ctx = ctx;
+  m_cache = std::make_unique<PageCache>(cacheBytes);
+  // without prefetch pages are still rendered and cached on caller thread
+  m_ctxPrefetch = fz_clone_context(ctx);
+  if (m_ctxPrefetch == nullptr) {
+    qWarning() << "PdfPages: cannot clone context, no prefetch";
+    return false;
+  }
+  m_stop = false;
+  m_thread = std::thread(&PdfPages::prefetchLoop, this);
+  return true;
+}
+
+void PdfPages::stop() {
+  if (m_thread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+      m_prefetch.clear();
+    }
+    m_cond.notify_all();
+    m_thread.join();
+  }
+  if (m_ctxPrefetch != nullptr) {
+    fz_drop_context(m_ctxPrefetch);
+    m_ctxPrefetch = nullptr;
+  }
+}
+
+void PdfPages::setDocument(fz_document* doc, int numPages) {
+  int docIdOld;
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_prefetch.clear();
+    m_cond.wait(lock, [this] { return !m_isRendering; });
+    docIdOld = m_docId;
+    m_doc = doc;
+    m_docNumPages = numPages;
+    m_docId++;
+  }
+  if (m_cache)
+    m_cache->removeDocument(docIdOld);
+}
+
+QImage PdfPages::getPage(int pageIndex, float scale, float rotate) {
+  TRACE_ZONE("getPage", pageIndex);
+  PageKey key;
+  fz_document* doc;
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    key.docId = m_docId;
+    key.pageIndex = pageIndex;
+    key.scale = scale;
+    key.rotate = rotate;
+    // page is prefetched right now: wait for it instead of second render
+    m_cond.wait(lock, [this, &key] {
+      return !(m_isRendering && (m_keyRendering == key));
+    });
+    doc = m_doc;
+  }
+  if (doc == nullptr)
+    return QImage();
+
+  QImage image;
+  if (m_cache->get(key, image)) {
+    m_numHits++;
+  } else {
+    m_numMisses++;
+    // document is locked for parsing only, bands are drawn in parallel
+    fz_display_list* list;
+    {
+      std::lock_guard<std::mutex> lockDoc(m_mutexDoc);
+      list = PdfRender::newDisplayList(m_ctx, doc, pageIndex);
+    }
+    if (list != nullptr) {
+      image = PdfRender::renderDisplayList(
+          m_ctx, list, PdfRender::getMatrix(scale, rotate), true);
+      fz_drop_display_list(m_ctx, list);
+    }
+    m_cache->put(key, image);
+  }
+
+  // after own render: prefetch should not delay requested page
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    schedulePrefetch(key);
+  }
+  m_cond.notify_all();
+  return image;
+}
+
+void PdfPages::schedulePrefetch(const PageKey& key) {
+  // older requests are not actual: user went elsewhere
+  m_prefetch.clear();
+  if (!m_thread.joinable())
+    return;
+  // next page first: documents are read forward more often
+  for (int delta : {1, -1}) {
+    PageKey keyNeib = key;
+    keyNeib.pageIndex = key.pageIndex + delta;
+    if ((keyNeib.pageIndex >= 0) && (keyNeib.pageIndex < m_docNumPages))
+      m_prefetch.push_back(keyNeib);
+  }
+}
+
+void PdfPages::prefetchLoop() {
+  Trace::setThreadName("prefetch");
+  for (;;) {
+    PageKey key;
+    fz_document* doc;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond.wait(lock, [this] { return m_stop || !m_prefetch.empty(); });
+      if (m_stop)
+        return;
+      key = m_prefetch.front();
+      m_prefetch.pop_front();
+      if ((key.docId != m_docId) || m_cache->contains(key))
+        continue;
+      doc = m_doc;
+      m_keyRendering = key;
+      m_isRendering = true;
+    }
+
+    QImage image;
+    fz_display_list* list;
+    {
+      std::lock_guard<std::mutex> lockDoc(m_mutexDoc);
+      list = PdfRender::newDisplayList(m_ctxPrefetch, doc, key.pageIndex);
+    }
+    // background page: one band, pool workers stay free for ui requests
+    if (list != nullptr) {
+      image = PdfRender::renderDisplayList(m_ctxPrefetch, list,
+          PdfRender::getMatrix(key.scale, key.rotate), true, 1);
+      fz_drop_display_list(m_ctxPrefetch, list);
+    }
+    m_cache->put(key, image);
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_isRendering = false;
+    }
+    m_cond.notify_all();
+  }
+}
@@ -0,0 +1,102 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _PDF_PAGES_H__
+#define _PDF_PAGES_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <QtGui/QImage>
+
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable : 4100)
+#pragma warning(disable : 4611)
+#endif
+
+#include "mupdf/fitz.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+#include "PageCache.h"
+
+// memory for rendered pages of the current document
+#define PDF_PAGES_CACHE_MB    256
+
+// Gray pages of pdf document for binarization, rendered once per
+// (document, page, scale, rotation) and kept in LRU cache. After every
+// request the neighbour pages are rendered in background on a cloned
+// context, so next / previous page is taken from cache.
+// mupdf document is used by one thread at a time: all other users
+// should lock getDocMutex.
+class PdfPages
+{
+public:
+  PdfPages();
+  ~PdfPages();
+
+  PdfPages(const PdfPages&) = delete;
+  PdfPages& operator=(const PdfPages&) = delete;
+
+  // ctx should be created with locks (FzLocks), prefetch thread renders
+  // on its clone. Returns false if context can not be cloned
+  bool start(fz_context* ctx, size_t cacheBytes);
+  void stop();
+
+  // document opened on ctx, owned by caller. Returns when prefetch does
+  // not use the previous document any more: it can be dropped
+  void setDocument(fz_document* doc, int numPages);
+
+  // Format_Grayscale8 page from cache or rendered on caller thread,
+  // null image on error. Pages pageIndex +- 1 are prefetched
+  QImage getPage(int pageIndex, float scale, float rotate);
+
+  std::mutex& getDocMutex() {
+    return m_mutexDoc;
+  }
+  int getNumHits() const {
+    return m_numHits.load();
+  }
+  int getNumMisses() const {
+    return m_numMisses.load();
+  }
+  PageCache* getCache() {
+    return m_cache.get();
+  }
+
+private:
+  void prefetchLoop();
+  // under m_mutex
+  void schedulePrefetch(const PageKey& key);
+
+  fz_context*                 m_ctx;
+  // clone of m_ctx for prefetch thread
+  fz_context*                 m_ctxPrefetch;
+  fz_document*                m_doc;
+  int                         m_docId;
+  int                         m_docNumPages;
+  std::unique_ptr<PageCache>  m_cache;
+  std::mutex                  m_mutexDoc;
+
+  std::mutex                  m_mutex;
+  std::condition_variable     m_cond;
+  std::deque<PageKey>         m_prefetch;
+  // page in work of prefetch thread
+  PageKey                     m_keyRendering;
+  bool                        m_isRendering;
+  bool                        m_stop;
+  std::thread                 m_thread;
+
+  std::atomic<int>            m_numHits;
+  std::atomic<int>            m_numMisses;
+};
+
+#endif
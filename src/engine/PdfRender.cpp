@@ -0,0 +1,274 @@
+//
+// Copyright 2022 Vlad
+//
+
+#include <QtCore/QDebug>
+
+#include "ParallelRows.h"
+#include "PdfRender.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+QImage PdfRender::renderPage(fz_context *ctx, fz_document *doc,
+                             int pageIndex, fz_matrix ctm, bool isGray) {
+  fz_page *page = nullptr;
+  QImage image;
+  fz_var(page);
+
+  fz_try(ctx) {
+    page = fz_load_page(ctx, doc, pageIndex);
+    image = renderPage(ctx, page, ctm, isGray);
+  }
+  fz_always(ctx) {
+    fz_drop_page(ctx, page);
+  }
+  fz_catch(ctx) {
+    qWarning() << "PdfRender: cannot load page" << pageIndex;
+    return QImage();
+  }
+  return image;
+}
+
+QImage PdfRender::renderPage(fz_context *ctx, fz_page *page, fz_matrix ctm,
+                             bool isGray) {
+  TRACE_ZONE("renderPage");
+  const fz_rect rect = fz_transform_rect(fz_bound_page(ctx, page), ctm);
+  const fz_irect bbox = fz_round_rect(rect);
+  const int w = bbox.x1 - bbox.x0;
+  const int h = bbox.y1 - bbox.y0;
+  if ((w <= 0) || (h <= 0))
+    return QImage();
+
+  // RGB32 is 0xffRRGGBB: B, G, R, A bytes in memory, so bgr + alpha
+  QImage image(w, h,
+               isGray ? QImage::Format::Format_Grayscale8
+                      : QImage::Format::Format_RGB32);
+  if (image.isNull())
+    return image;
+  if (!drawBand(ctx, page, nullptr, ctm, bbox, 0, h, isGray, image.bits(),
+                image.bytesPerLine())) {
+    qWarning() << "PdfRender: cannot render page";
+    return QImage();
+  }
+  return image;
+}
+
+QImage PdfRender::renderClip(fz_context *ctx, fz_document *doc,
+                             int pageIndex, fz_matrix ctm, const QRect &clip,
+                             bool isGray) {
+  TRACE_ZONE("renderClip");
+  fz_page *page = nullptr;
+  fz_irect bbox;
+  fz_var(page);
+
+  fz_try(ctx) {
+    page = fz_load_page(ctx, doc, pageIndex);
+    bbox = fz_round_rect(fz_transform_rect(fz_bound_page(ctx, page), ctm));
+  }
+  fz_catch(ctx) {
+    fz_drop_page(ctx, page);
+    qWarning() << "PdfRender: cannot load page" << pageIndex;
+    return QImage();
+  }
+
+  // image pixels to device space, see renderPage
+  fz_irect bboxClip;
+  bboxClip.x0 = bbox.x0 + clip.left();
+  bboxClip.y0 = bbox.y0 + clip.top();
+  bboxClip.x1 = bboxClip.x0 + clip.width();
+  bboxClip.y1 = bboxClip.y0 + clip.height();
+  bboxClip = fz_intersect_irect(bboxClip, bbox);
+  const int w = bboxClip.x1 - bboxClip.x0;
+  const int h = bboxClip.y1 - bboxClip.y0;
+  QImage image;
+  if ((w > 0) && (h > 0)) {
+    image = QImage(w, h,
+                   isGray ? QImage::Format::Format_Grayscale8
+                          : QImage::Format::Format_RGB32);
+  }
+  // draw device skips objects outside of clip pixmap
+  if (!image.isNull() &&
+      !drawBand(ctx, page, nullptr, ctm, bboxClip, 0, h, isGray,
+                image.bits(), image.bytesPerLine())) {
+    qWarning() << "PdfRender: cannot render page" << pageIndex << "clip";
+    image = QImage();
+  }
+  fz_drop_page(ctx, page);
+  return image;
+}
+
+bool PdfRender::drawBand(fz_context *ctx, fz_page *page,
+                         fz_display_list *list, fz_matrix ctm,
+                         const fz_irect &bbox, int y0, int y1, bool isGray,
+                         uchar *bits, int bytesPerLine) {
+  TRACE_ZONE("renderBand");
+  fz_colorspace *colorSpace = isGray ? fz_device_gray(ctx)
+                                     : fz_device_bgr(ctx);
+  const int alpha = isGray ? 0 : 1;
+  const int w = bbox.x1 - bbox.x0;
+
+  fz_pixmap *pix = nullptr;
+  fz_device *dev = nullptr;
+  bool ok = true;
+  fz_var(pix);
+  fz_var(dev);
+
+  fz_try(ctx) {
+    // samples are owned by image: not freed by fz_drop_pixmap
+    pix = fz_new_pixmap_with_data(ctx, colorSpace, w, y1 - y0, nullptr,
+                                  alpha, bytesPerLine,
+                                  bits + (size_t)y0 * bytesPerLine);
+    pix->x = bbox.x0;
+    pix->y = bbox.y0 + y0;
+    // white page, alpha 255
+    fz_clear_pixmap_with_value(ctx, pix, 0xff);
+
+    dev = fz_new_draw_device(ctx, fz_identity, pix);
+    if (list != nullptr) {
+      // objects outside of band are skipped
+      const fz_rect scissor = fz_make_rect(
+          (float)bbox.x0, (float)(bbox.y0 + y0), (float)bbox.x1,
+          (float)(bbox.y0 + y1));
+      fz_run_display_list(ctx, list, dev, ctm, scissor, nullptr);
+    } else {
+      fz_run_page(ctx, page, dev, ctm, nullptr);
+    }
+    fz_close_device(ctx, dev);
+  }
+  fz_always(ctx) {
+    fz_drop_device(ctx, dev);
+    fz_drop_pixmap(ctx, pix);
+  }
+  fz_catch(ctx) {
+    ok = false;
+  }
+  return ok;
+}
+
+fz_display_list *PdfRender::newDisplayList(fz_context *ctx,
+                                           fz_document *doc, int pageIndex) {
+  TRACE_ZONE("loadPage");
+  fz_display_list *list = nullptr;
+  fz_try(ctx) {
+    list = fz_new_display_list_from_page_number(ctx, doc, pageIndex);
+  }
+  fz_catch(ctx) {
+    qWarning() << "PdfRender: cannot load page" << pageIndex;
+    return nullptr;
+  }
+  return list;
+}
+
+QImage PdfRender::renderDisplayList(fz_context *ctx, fz_display_list *list,
+                                    fz_matrix ctm, bool isGray,
+                                    int numBands) {
+  TRACE_ZONE("renderPage");
+  const fz_rect rect =
+      fz_transform_rect(fz_bound_display_list(ctx, list), ctm);
+  const fz_irect bbox = fz_round_rect(rect);
+  const int w = bbox.x1 - bbox.x0;
+  const int h = bbox.y1 - bbox.y0;
+  if ((w <= 0) || (h <= 0))
+    return QImage();
+
+  QImage image(w, h,
+               isGray ? QImage::Format::Format_Grayscale8
+                      : QImage::Format::Format_RGB32);
+  if (image.isNull())
+    return image;
+  // not image.bits() in bands: no detach check from several threads
+  uchar *bits = image.bits();
+  const int bytesPerLine = image.bytesPerLine();
+
+  if (numBands <= 0) {
+    numBands = h / PDF_RENDER_MIN_BAND_ROWS;
+    const int numWorkers = ThreadPool::instance().getNumWorkers();
+    if (numBands > numWorkers)
+      numBands = numWorkers;
+  }
+  if (numBands < 1)
+    numBands = 1;
+
+  // own context for every band, except the single one
+  std::vector<fz_context *> ctxBands(numBands, ctx);
+  if (numBands > 1) {
+    for (int i = 0; i < numBands; i++) {
+      ctxBands[i] = fz_clone_context(ctx);
+      if (ctxBands[i] == nullptr) {
+        // context without locks can not be cloned
+        for (int k = 0; k < i; k++) {
+          fz_drop_context(ctxBands[k]);
+        }
+        numBands = 1;
+        ctxBands.assign(1, ctx);
+        break;
+      }
+    }
+  }
+
+  std::vector<char> okBands(numBands, 0);
+  ParallelRows::run(h, numBands, [&](int i, int y0, int y1) {
+    okBands[i] = drawBand(ctxBands[i], nullptr, list, ctm, bbox, y0, y1,
+                          isGray, bits, bytesPerLine) ? 1 : 0;
+  });
+
+  bool ok = true;
+  for (int i = 0; i < numBands; i++) {
+    ok = ok && (okBands[i] != 0);
+    if (ctxBands[i] != ctx)
+      fz_drop_context(ctxBands[i]);
+  }
+  if (!ok) {
+    qWarning() << "PdfRender: cannot render page";
+    return QImage();
+  }
+  return image;
+}
+
+std::vector<QImage> PdfRender::renderPages(fz_context *ctx,
+    fz_document *doc, const std::vector<int> &pageIndices, fz_matrix ctm,
+    bool isGray) {
+  const int numPages = (int)pageIndices.size();
+  std::vector<fz_display_list *> lists(numPages, nullptr);
+  for (int i = 0; i < numPages; i++) {
+    lists[i] = newDisplayList(ctx, doc, pageIndices[i]);
+  }
+
+  std::vector<QImage> images(numPages);
+  fz_context *ctxProbe = fz_clone_context(ctx);
+  if (ctxProbe == nullptr) {
+    // context without locks: pages one by one on ctx
+    for (int i = 0; i < numPages; i++) {
+      if (lists[i] != nullptr)
+        images[i] = renderDisplayList(ctx, lists[i], ctm, isGray, 1);
+      fz_drop_display_list(ctx, lists[i]);
+    }
+    return images;
+  }
+  fz_drop_context(ctxProbe);
+
+  // enough pages: one page per worker, bands otherwise
+  const int numBands =
+      (numPages >= ThreadPool::instance().getNumWorkers()) ? 1 : 0;
+  ThreadPool::instance().parallelFor(0, numPages,
+                                     [&](int pageStart, int pageEnd) {
+    fz_context *ctxPage = fz_clone_context(ctx);
+    if (ctxPage == nullptr)
+      return;
+    for (int i = pageStart; i < pageEnd; i++) {
+      if (lists[i] != nullptr)
+        images[i] = renderDisplayList(ctxPage, lists[i], ctm, isGray,
+                                      numBands);
+    }
+    fz_drop_context(ctxPage);
+  });
+
+  for (fz_display_list *list : lists) {
+    fz_drop_display_list(ctx, list);
+  }
+  return images;
+}
+
+fz_matrix PdfRender::getMatrix(float scale, float rotate) {
+  return fz_pre_rotate(fz_scale(scale, scale), rotate);
+}
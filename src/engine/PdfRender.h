@@ -0,0 +1,72 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _PDF_RENDER_H__
+#define _PDF_RENDER_H__
+
+#include <vector>
+
+#include <QtGui/QImage>
+
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable : 4100)
+#pragma warning(disable : 4611)
+#endif
+
+#include "mupdf/fitz.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+// minimal rows in one band of parallel rasterization
+#define PDF_RENDER_MIN_BAND_ROWS    128
+
+// Page rasterization with mupdf directly into QImage pixels: the draw
+// device writes into a pixmap wrapping the QImage buffer, no copy.
+// Parallel rasterization: page is parsed once into display list (document
+// is used by one thread), then list is drawn by horizontal bands, every
+// band on its own clone of the context. Context should be created with
+// locks (FzLocks), otherwise bands are drawn one by one.
+class PdfRender {
+ public:
+  // isGray == true:  Format_Grayscale8, for binarization
+  // isGray == false: Format_RGB32 (rendered as BGRA, opaque)
+  // returns null image on mupdf error
+  static QImage renderPage(fz_context* ctx, fz_document* doc, int pageIndex,
+                           fz_matrix ctm, bool isGray);
+  static QImage renderPage(fz_context* ctx, fz_page* page, fz_matrix ctm,
+                           bool isGray);
+  // clip is a rectangle of the image rendered by renderPage with the same
+  // ctm: only its pixels are rasterized. Null image on error or if clip
+  // is outside of page
+  static QImage renderClip(fz_context* ctx, fz_document* doc, int pageIndex,
+                           fz_matrix ctm, const QRect& clip, bool isGray);
+  // page to image transform: scale, then rotation in degrees
+  static fz_matrix getMatrix(float scale, float rotate);
+
+  // parsed page, nullptr on error. Drop with fz_drop_display_list
+  static fz_display_list* newDisplayList(fz_context* ctx, fz_document* doc,
+                                         int pageIndex);
+  // numBands 0: by image height and number of ThreadPool workers
+  static QImage renderDisplayList(fz_context* ctx, fz_display_list* list,
+                                  fz_matrix ctm, bool isGray,
+                                  int numBands = 0);
+  // pages of document in pageIndices order. Display lists are built one
+  // by one, then pages are rasterized in parallel (and by bands, if there
+  // are less pages than workers). Failed page is a null image
+  static std::vector<QImage> renderPages(fz_context* ctx, fz_document* doc,
+                                         const std::vector<int>& pageIndices,
+                                         fz_matrix ctm, bool isGray);
+
+ private:
+  // draw rows [y0 .. y1) of page or list (one of them is not null) into
+  // image pixels. bbox is the whole image in device space
+  static bool drawBand(fz_context* ctx, fz_page* page, fz_display_list* list,
+                       fz_matrix ctm, const fz_irect& bbox, int y0, int y1,
+                       bool isGray, uchar* bits, int bytesPerLine);
+};
+
+#endif
@@ -0,0 +1,144 @@
+//
+// Copyright 2022 Vlad
+//
+
+#include <cmath>
+
+#include <QtCore/QDebug>
+
+#include "PdfText.h"
+#include "Trace.h"
+
+static bool isSpaceChar(int c) {
+  return (c == ' ') || (c == '\t') || (c == 0xa0) || (c == 0x3000) ||
+         ((c >= 0x2000) && (c <= 0x200b));
+}
+
+// glyph without unicode mapping is extracted as one of these
+static bool isBadChar(int c) {
+  return (c == 0xfffd) || (c < 0x20) || ((c >= 0xe000) && (c <= 0xf8ff));
+}
+
+static void appendChar(QString& str, int c) {
+  if (c > 0xffff) {
+    str.append(QChar(QChar::highSurrogate((uint)c)));
+    str.append(QChar(QChar::lowSurrogate((uint)c)));
+  } else {
+    str.append(QChar(c));
+  }
+}
+
+// word is finished by space or line end
+struct WordBuilder {
+  QString   text;
+  fz_rect   rect = fz_empty_rect;
+
+  void add(int c, fz_rect rectChar) {
+    appendChar(text, c);
+    rect = fz_union_rect(rect, rectChar);
+  }
+  // rect is shifted by image origin
+  void flush(const fz_irect& bbox, std::vector<TextBox>& words) {
+    if (!text.isEmpty()) {
+      const int x0 = (int)std::floor(rect.x0) - bbox.x0;
+      const int y0 = (int)std::floor(rect.y0) - bbox.y0;
+      const int x1 = (int)std::ceil(rect.x1) - bbox.x0;
+      const int y1 = (int)std::ceil(rect.y1) - bbox.y0;
+      TextBox tBox;
+      tBox.m_rect = QRect(x0, y0, x1 - x0, y1 - y0);
+      tBox.m_text = text;
+      tBox.m_confidence = 100.0F;
+      words.push_back(tBox);
+    }
+    text.clear();
+    rect = fz_empty_rect;
+  }
+};
+
+bool PdfTextLayer::isReliable() const {
+  if (numChars < PDF_TEXT_MIN_CHARS)
+    return false;
+  return numBadChars * 100 <= numChars * PDF_TEXT_MAX_BAD_PERCENT;
+}
+
+bool PdfText::getTextLayer(fz_context* ctx, fz_document* doc, int pageIndex,
+                           fz_matrix ctm, PdfTextLayer& layer) {
+  TRACE_ZONE("textLayer");
+  fz_page* page = nullptr;
+  bool ok = false;
+  fz_var(page);
+
+  fz_try(ctx) {
+    page = fz_load_page(ctx, doc, pageIndex);
+    ok = getTextLayer(ctx, page, ctm, layer);
+  }
+  fz_always(ctx) {
+    fz_drop_page(ctx, page);
+  }
+  fz_catch(ctx) {
+    qWarning() << "PdfText: cannot load page" << pageIndex;
+    return false;
+  }
+  return ok;
+}
+
+bool PdfText::getTextLayer(fz_context* ctx, fz_page* page, fz_matrix ctm,
+                           PdfTextLayer& layer) {
+  layer = PdfTextLayer();
+  // origin of rendered image, see PdfRender::renderPage
+  const fz_irect bbox =
+      fz_round_rect(fz_transform_rect(fz_bound_page(ctx, page), ctm));
+
+  fz_stext_options options;
+  options.flags = FZ_STEXT_MEDIABOX_CLIP;
+  options.scale = 1.0F;
+  fz_stext_page* textPage = nullptr;
+  fz_try(ctx) {
+    // text device only: no glyphs are rasterized
+    textPage = fz_new_stext_page_from_page(ctx, page, &options);
+  }
+  fz_catch(ctx) {
+    qWarning() << "PdfText: cannot extract page text";
+    return false;
+  }
+
+  // walk outside of fz_try: Qt strings should not be skipped by longjmp
+  WordBuilder word;
+  for (fz_stext_block* block = textPage->first_block; block != nullptr;
+       block = block->next) {
+    if (block->type != FZ_STEXT_BLOCK_TEXT)
+      continue;
+    for (fz_stext_line* line = block->u.t.first_line; line != nullptr;
+         line = line->next) {
+      for (fz_stext_char* ch = line->first_char; ch != nullptr;
+           ch = ch->next) {
+        if (isSpaceChar(ch->c)) {
+          word.flush(bbox, layer.words);
+          continue;
+        }
+        layer.numChars++;
+        if (isBadChar(ch->c))
+          layer.numBadChars++;
+        const fz_rect rectChar =
+            fz_transform_rect(fz_rect_from_quad(ch->quad), ctm);
+        word.add(ch->c, rectChar);
+      }  // for ch
+      word.flush(bbox, layer.words);
+    }  // for line
+  }    // for block
+  fz_drop_stext_page(ctx, textPage);
+  return true;
+}
+
+bool PdfText::useTextLayer(TextLayerPolicy policy,
+                           const PdfTextLayer& layer) {
+  switch (policy) {
+    case TextLayerPolicy::ALWAYS_OCR:
+      return false;
+    case TextLayerPolicy::AUTO:
+      return layer.isReliable();
+    case TextLayerPolicy::TEXT_LAYER_ONLY:
+      return true;
+  }
+  return false;
+}
@@ -0,0 +1,65 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _PDF_TEXT_H__
+#define _PDF_TEXT_H__
+
+#include <vector>
+
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable : 4100)
+#pragma warning(disable : 4611)
+#endif
+
+#include "mupdf/fitz.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+#include "RecogRes.h"
+
+// where words of pdf page are taken from
+enum class TextLayerPolicy {
+  // rasterize, binarize and recognize every page
+  ALWAYS_OCR = 0,
+  // text layer if it is reliable, OCR otherwise
+  AUTO = 1,
+  // text layer only (possibly empty), never OCR
+  TEXT_LAYER_ONLY = 2,
+};
+
+// less characters: page is a scan (maybe with page number or header)
+#define PDF_TEXT_MIN_CHARS        32
+// more broken characters (percents): fonts without unicode mapping
+#define PDF_TEXT_MAX_BAD_PERCENT  5
+
+struct PdfTextLayer {
+  // words in rendered page pixels, confidence 100
+  std::vector<TextBox>  words;
+  // not space characters of page
+  int                   numChars = 0;
+  // characters without real unicode: U+FFFD, controls, private use area
+  int                   numBadChars = 0;
+
+  // enough text and almost all of it is readable
+  bool isReliable() const;
+};
+
+// Words of the embedded pdf text (mupdf structured text), no rendering.
+// Born-digital pages get words in milliseconds instead of OCR time.
+class PdfText {
+ public:
+  // ctm is the same as for PdfRender::renderPage: word boxes match
+  // rendered image pixels. Returns false on mupdf error
+  static bool getTextLayer(fz_context* ctx, fz_document* doc, int pageIndex,
+                           fz_matrix ctm, PdfTextLayer& layer);
+  static bool getTextLayer(fz_context* ctx, fz_page* page, fz_matrix ctm,
+                           PdfTextLayer& layer);
+  // words of text layer are used instead of OCR for this page
+  static bool useTextLayer(TextLayerPolicy policy, const PdfTextLayer& layer);
+};
+
+#endif
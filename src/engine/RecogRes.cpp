@@ -2,6 +2,8 @@
 // Copyright 2022 Vlad
 //
 
+#include <cmath>
+
 #include <QPoint>
 #include <QList>
 #include <QPolygon>
@@ -11,11 +13,15 @@
 TextBox::TextBox() {
   m_selected = false;
   m_text = "";
+  m_confidence = 0.0F;
   m_rect.setCoords(-1, -1, 0, 0);
 }
 
 RecognitionResult::RecognitionResult() { 
   m_magic = MAGIC_REC;
+  m_pageIndex = -1;
+  m_pageScale = 1.0F;
+  m_pageRotate = 0.0F;
 }
 
 int RecognitionResult::getBoxIndexInside(int x, int y) {
@@ -49,6 +55,7 @@ bool RecognitionResult::markSelectedByPoly(QVector<QPoint>& points,
     const int y = (int)(pt.y() / scaleRender);
     polyLasso.append(QPoint(x, y));
   }
+  m_rectSelected = polyLasso.boundingRect().intersected(m_image.rect());
   bool hasSelected = false;
   for (TextBox& tb : m_textBoxes) {
     QRect rc = tb.m_rect;
@@ -61,3 +68,28 @@ bool RecognitionResult::markSelectedByPoly(QVector<QPoint>& points,
   }
   return hasSelected;
 }
+
+int RecognitionResult::spliceRegion(const QRect& rect, const float scaleRegion,
+                                    const std::vector<TextBox>& boxesRegion) {
+  if (boxesRegion.empty())
+    return 0;
+  // old words of region
+  const int numBoxes = (int)m_textBoxes.size();
+  for (int i = numBoxes - 1; i >= 0; i--) {
+    if (rect.contains(m_textBoxes[i].m_rect.center()))
+      m_textBoxes.erase(m_textBoxes.begin() + i);
+  }
+  // region pixels to image pixels
+  for (const TextBox& tbRegion : boxesRegion) {
+    const QRect& r = tbRegion.m_rect;
+    const int x0 = rect.left() + (int)std::floor(r.left() / scaleRegion);
+    const int y0 = rect.top() + (int)std::floor(r.top() / scaleRegion);
+    const int x1 = rect.left() + (int)std::ceil((r.right() + 1) / scaleRegion);
+    const int y1 = rect.top() + (int)std::ceil((r.bottom() + 1) / scaleRegion);
+    TextBox tb = tbRegion;
+    tb.m_rect = QRect(x0, y0, x1 - x0, y1 - y0);
+    tb.m_selected = false;
+    m_textBoxes.push_back(tb);
+  }
+  return (int)boxesRegion.size();
+}
@@ -0,0 +1,62 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _RECOG_RES_H_
+#define _RECOG_RES_H_
+
+#pragma once
+
+#include <QtGui/QImage>
+
+class TextBox {
+public:
+  // rectangle around text
+  QRect     m_rect;
+  // recognized text
+  QString   m_text;
+  // recognition confidence [0..100]
+  float     m_confidence;
+  // is selected
+  bool      m_selected;
+
+  TextBox();
+};
+
+const int MAGIC_REC = 0x1237;
+
+class RecognitionResult {
+public:
+  // magix sign
+  int                   m_magic;         
+  // binarized image (Format_Mono, shares BinImage pixels) or source image
+  QImage                m_image;
+  // set of recognized text boxes on the binarized image
+  std::vector<TextBox>  m_textBoxes;
+  // bounding rectangle of the last lasso, clipped by image. Empty if none
+  QRect                 m_rectSelected;
+  // pdf page rendered into image, -1 if image is not from pdf (or the
+  // document is closed)
+  int                   m_pageIndex;
+  float                 m_pageScale;
+  float                 m_pageRotate;
+  // pixels of image file the result is made from, null for pdf pages
+  QImage                m_imageSource;
+
+  RecognitionResult();
+  // selection can be re-processed: pdf page can be rendered again, or
+  // source image file pixels are kept
+  bool hasSource() const {
+    return (m_pageIndex >= 0) || !m_imageSource.isNull();
+  }
+  int getBoxIndexInside(int x, int y);
+  bool markSelectedByPoly(QVector<QPoint>& points, float scaleRender);
+  void removeSelected();
+  // boxes recognized on region image (rect of m_image, upscaled by
+  // scaleRegion) replace boxes with centers inside rect. Without new
+  // boxes old ones are kept (region not recognized).
+  // Returns number of new boxes
+  int spliceRegion(const QRect& rect, float scaleRegion,
+                   const std::vector<TextBox>& boxesRegion);
+};
+#endif
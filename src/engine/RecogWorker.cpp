@@ -0,0 +1,237 @@
+//
+// Copyright 2022 Vlad
+//
+
+#include <cassert>
+#include <chrono>
+
+#include <QtCore/QDebug>
+
+#include "OcrEngine.h"
+#include "PageLayout.h"
+#include "RecogWorker.h"
+#include "Trace.h"
+
+RecogWorker::RecogWorker() : m_events(RECOG_EVENTS_CAPACITY) {
+  m_pool = nullptr;
+  m_taskCurrent = nullptr;
+  m_idNext = 1;
+  m_stop = false;
+}
+
+RecogWorker::~RecogWorker() {
+  stop();
+}
+
+void RecogWorker::start(OcrPool* pool) {
+  assert(!m_thread.joinable());
+  m_pool = pool;
+  m_stop = false;
+  m_thread = std::thread(&RecogWorker::workerLoop, this);
+}
+
+void RecogWorker::stop() {
+  if (!m_thread.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+    if (m_taskCurrent != nullptr)
+      m_taskCurrent->cancel = true;
+    m_tasks.clear();
+  }
+  m_cond.notify_all();
+  m_thread.join();
+}
+
+int RecogWorker::submit(RecogJob job) {
+  auto task = std::make_unique<Task>();
+  task->job = std::move(job);
+  int id;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    id = m_idNext++;
+    task->id = id;
+    m_tasks.push_back(std::move(task));
+  }
+  m_cond.notify_one();
+  return id;
+}
+
+void RecogWorker::cancel(int jobId) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto& task : m_tasks) {
+    if (task->id == jobId)
+      task->cancel = true;
+  }
+  if ((m_taskCurrent != nullptr) && (m_taskCurrent->id == jobId))
+    m_taskCurrent->cancel = true;
+}
+
+void RecogWorker::cancelAll() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto& task : m_tasks) {
+    task->cancel = true;
+  }
+  if (m_taskCurrent != nullptr)
+    m_taskCurrent->cancel = true;
+}
+
+bool RecogWorker::isIdle() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_tasks.empty() && (m_taskCurrent == nullptr);
+}
+
+bool RecogWorker::popEvent(RecogEvent& evt) {
+  return m_events.pop(evt);
+}
+
+std::unique_ptr<RecogWorker::Task> RecogWorker::takeTask() {
+  if (m_tasks.empty())
+    return nullptr;
+  // cancelled tasks first (reported at once), then highest priority,
+  // then oldest
+  size_t indexBest = 0;
+  for (size_t i = 1; i < m_tasks.size(); i++) {
+    const Task& best = *m_tasks[indexBest];
+    const Task& task = *m_tasks[i];
+    if (best.cancel)
+      break;
+    if (task.cancel || (task.job.priority > best.job.priority))
+      indexBest = i;
+  }
+  std::unique_ptr<Task> task = std::move(m_tasks[indexBest]);
+  m_tasks.erase(m_tasks.begin() + indexBest);
+  return task;
+}
+
+void RecogWorker::workerLoop() {
+  Trace::setThreadName("recog worker");
+  for (;;) {
+    std::unique_ptr<Task> task;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+      if (m_stop)
+        return;
+      task = takeTask();
+      m_taskCurrent = task.get();
+    }
+    runTask(*task);
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_taskCurrent = nullptr;
+    }
+  }
+}
+
+void RecogWorker::pushEvent(RecogEvent&& evt) {
+  // ui takes events by timer: queue is full only for a short time
+  while (!m_events.push(std::move(evt))) {
+    if (m_stop)
+      return;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+void RecogWorker::pushEvent(RecogEventType type, int jobId) {
+  RecogEvent evt;
+  evt.type = type;
+  evt.jobId = jobId;
+  pushEvent(std::move(evt));
+}
+
+void RecogWorker::runTask(Task& task) {
+  const int id = task.id;
+  if (task.cancel) {
+    pushEvent(RecogEventType::CANCELLED, id);
+    return;
+  }
+  const auto timeStart = std::chrono::steady_clock::now();
+  TRACE_ZONE("recogJob");
+
+  BinImage imageBin;
+  RecogEvent evtImage;
+  evtImage.type = RecogEventType::IMAGE;
+  evtImage.jobId = id;
+  if (task.job.binarize) {
+    TRACE_ZONE("binarize");
+    imageBin = task.job.binarize(task.job.image);
+    // 1 bpp image over the same pixels: no expansion for render
+    evtImage.image = imageBin.getQImage();
+  } else {
+    evtImage.image = task.job.image;
+  }
+  if (task.cancel) {
+    pushEvent(RecogEventType::CANCELLED, id);
+    return;
+  }
+  pushEvent(std::move(evtImage));
+
+  std::vector<QRect> blocks;
+  if (!imageBin.isNull() && task.job.byBlocks &&
+      (m_pool->getNumEngines() > 1))
+    blocks = PageLayout::getTextBlocks(imageBin);
+
+  const size_t numParts = (blocks.size() > 1) ? blocks.size() : 1;
+  std::vector<OcrProgress> progress(numParts);
+  for (OcrProgress& p : progress) {
+    p.cancel = &task.cancel;
+  }
+  std::vector<std::future<std::vector<TextBox>>> results;
+  if (imageBin.isNull()) {
+    results.push_back(
+        m_pool->submit(task.job.image, &progress[0], task.job.hPage));
+  } else if (blocks.size() <= 1) {
+    results.push_back(
+        m_pool->submit(imageBin, &progress[0], task.job.hPage));
+  } else {
+    // text blocks on separate engines, sent in reading order
+    const SharedPix pix = OcrEngine::getPix(imageBin);
+    for (size_t i = 0; i < blocks.size(); i++) {
+      results.push_back(m_pool->submit(pix, blocks[i], &progress[i]));
+    }
+  }
+
+  // every result is waited even after cancel: engines use progress
+  const std::chrono::milliseconds timeWait(30);
+  int percentSent = -1;
+  size_t numWords = 0;
+  for (auto& result : results) {
+    while (result.wait_for(timeWait) != std::future_status::ready) {
+      int sumPercent = 0;
+      for (const OcrProgress& p : progress) {
+        sumPercent += p.percent.load();
+      }
+      const int percent = sumPercent / (int)numParts;
+      if ((percent != percentSent) && !task.cancel) {
+        RecogEvent evt;
+        evt.type = RecogEventType::PROGRESS;
+        evt.jobId = id;
+        evt.percent = percent;
+        pushEvent(std::move(evt));
+        percentSent = percent;
+      }
+    }
+    std::vector<TextBox> words = result.get();
+    if (task.cancel || words.empty())
+      continue;
+    numWords += words.size();
+    RecogEvent evt;
+    evt.type = RecogEventType::WORDS;
+    evt.jobId = id;
+    evt.words = std::move(words);
+    pushEvent(std::move(evt));
+  }
+
+  if (task.cancel) {
+    pushEvent(RecogEventType::CANCELLED, id);
+    return;
+  }
+  const auto timeEnd = std::chrono::steady_clock::now();
+  qInfo() << "RecogWorker: job" << id << ":" << numWords << "words in"
+          << std::chrono::duration_cast<std::chrono::milliseconds>(
+                 timeEnd - timeStart).count()
+          << "ms," << numParts << "parts";
+  pushEvent(RecogEventType::DONE, id);
+}
@@ -0,0 +1,124 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _RECOG_WORKER_H__
+#define _RECOG_WORKER_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <QtGui/QImage>
+
+#include "BinImage.h"
+#include "OcrPool.h"
+#include "RecogRes.h"
+#include "SpscQueue.h"
+
+// job priorities: higher is started first
+#define RECOG_PRIORITY_NORMAL   0
+#define RECOG_PRIORITY_HIGH     10
+
+// capacity of events queue from worker to ui
+#define RECOG_EVENTS_CAPACITY   1024
+
+struct RecogJob {
+  // source page
+  QImage                                  image;
+  // binarization of image; empty function: source image is recognized
+  std::function<BinImage(const QImage&)>  binarize;
+  // split binarized page into text blocks (PageLayout), recognized on
+  // separate pool engines
+  bool                                    byBlocks = true;
+  // image is a part of page: page height in image pixels for word height
+  // filter (see OcrEngine::recognize), 0: image is the whole page
+  int                                     hPage = 0;
+  // pending jobs with same priority are started in submit order
+  int                                     priority = RECOG_PRIORITY_NORMAL;
+};
+
+enum class RecogEventType {
+  // page image for render is ready (binarized or source)
+  IMAGE = 0,
+  // words of the next text block, in reading order
+  WORDS = 1,
+  // recognition percent of the whole page
+  PROGRESS = 2,
+  // job is finished, all its words are sent
+  DONE = 3,
+  // job is cancelled, later events of job are not sent
+  CANCELLED = 4,
+};
+
+struct RecogEvent {
+  RecogEventType          type = RecogEventType::DONE;
+  int                     jobId = 0;
+  QImage                  image;
+  std::vector<TextBox>    words;
+  int                     percent = 0;
+};
+
+// Background worker running binarize + OCR jobs one by one, pages are
+// recognized on OcrPool engines. Results are streamed as events through
+// lock-free queue and taken by one consumer thread (ui timer) with
+// popEvent, so ui never waits for the worker.
+class RecogWorker
+{
+public:
+  RecogWorker();
+  ~RecogWorker();
+
+  RecogWorker(const RecogWorker&) = delete;
+  RecogWorker& operator=(const RecogWorker&) = delete;
+
+  // pool should live until stop
+  void start(OcrPool* pool);
+  // cancel all jobs and stop worker thread
+  void stop();
+
+  // returns job id (> 0)
+  int submit(RecogJob job);
+  // pending job is dropped, running job stops at the nearest word.
+  // CANCELLED event is sent in both cases
+  void cancel(int jobId);
+  void cancelAll();
+  // no pending or running jobs
+  bool isIdle();
+
+  // consumer thread only. false if no events
+  bool popEvent(RecogEvent& evt);
+
+private:
+  struct Task {
+    int                   id = 0;
+    RecogJob              job;
+    std::atomic<bool>     cancel{false};
+  };
+
+  void workerLoop();
+  // highest priority pending task, nullptr if none. Under m_mutex
+  std::unique_ptr<Task> takeTask();
+  void runTask(Task& task);
+  // waits while queue is full
+  void pushEvent(RecogEvent&& evt);
+  void pushEvent(RecogEventType type, int jobId);
+
+  OcrPool*                            m_pool;
+  std::thread                         m_thread;
+  SpscQueue<RecogEvent>               m_events;
+
+  std::mutex                          m_mutex;
+  std::condition_variable             m_cond;
+  std::vector<std::unique_ptr<Task>>  m_tasks;
+  // task in work, owned by worker thread
+  Task*                               m_taskCurrent;
+  int                                 m_idNext;
+  std::atomic<bool>                   m_stop;
+};
+
+#endif
@@ -0,0 +1,402 @@
+//
+// Copyright 2022 Vlad
+//
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+
+#include "ResultWriter.h"
+
+// hOCR 1.2: pages, lines and words of XHTML document
+class HocrWriter : public ResultWriter
+{
+public:
+  explicit HocrWriter(QIODevice* out) : ResultWriter(out) {}
+  bool begin() override;
+  bool writePage(const BatchPage& page) override;
+  bool end() override;
+
+private:
+  void appendBbox(const QRect& rect);
+};
+
+// ALTO v4: page has one text block with lines of strings
+class AltoWriter : public ResultWriter
+{
+public:
+  explicit AltoWriter(QIODevice* out) : ResultWriter(out) {}
+  bool begin() override;
+  bool writePage(const BatchPage& page) override;
+  bool end() override;
+
+private:
+  // HPOS VPOS WIDTH HEIGHT attributes
+  void appendPos(const QRect& rect);
+};
+
+// JSON Lines: one compact getPageJson object per line
+class JsonLinesWriter : public ResultWriter
+{
+public:
+  explicit JsonLinesWriter(QIODevice* out) : ResultWriter(out) {}
+  bool writePage(const BatchPage& page) override;
+};
+
+static QRect getLineRect(const std::vector<TextBox>& words, size_t start,
+                         size_t stop) {
+  QRect rect;
+  for (size_t i = start; i < stop; i++) {
+    rect = rect.united(words[i].m_rect);
+  }
+  return rect;
+}
+
+ResultWriter::ResultWriter(QIODevice* out) {
+  m_out = out;
+  m_numPages = 0;
+}
+
+bool ResultWriter::begin() {
+  return true;
+}
+
+bool ResultWriter::end() {
+  return flush();
+}
+
+std::unique_ptr<ResultWriter> ResultWriter::create(ResultFormat format,
+                                                   QIODevice* out) {
+  switch (format) {
+    case ResultFormat::HOCR:
+      return std::unique_ptr<ResultWriter>(new HocrWriter(out));
+    case ResultFormat::ALTO:
+      return std::unique_ptr<ResultWriter>(new AltoWriter(out));
+    case ResultFormat::JSONL:
+      return std::unique_ptr<ResultWriter>(new JsonLinesWriter(out));
+  }
+  return nullptr;
+}
+
+bool ResultWriter::getFormatByName(const char* name, ResultFormat& format) {
+  if (strcmp(name, "hocr") == 0)
+    format = ResultFormat::HOCR;
+  else if (strcmp(name, "alto") == 0)
+    format = ResultFormat::ALTO;
+  else if (strcmp(name, "jsonl") == 0)
+    format = ResultFormat::JSONL;
+  else
+    return false;
+  return true;
+}
+
+const char* ResultWriter::getFileSuffix(ResultFormat format) {
+  switch (format) {
+    case ResultFormat::HOCR:
+      return "hocr";
+    case ResultFormat::ALTO:
+      return "xml";
+    case ResultFormat::JSONL:
+      return "jsonl";
+  }
+  return "";
+}
+
+std::vector<size_t> ResultWriter::getLineStarts(
+    const std::vector<TextBox>& words) {
+  std::vector<size_t> starts;
+  for (size_t i = 0; i < words.size(); i++) {
+    if (i == 0) {
+      starts.push_back(i);
+      continue;
+    }
+    const QRect& prev = words[i - 1].m_rect;
+    const QRect& cur = words[i].m_rect;
+    const int yCenter = cur.top() + cur.height() / 2;
+    // back to the left or below / above previous word
+    if ((cur.left() < prev.left()) || (yCenter < prev.top()) ||
+        (yCenter > prev.bottom()))
+      starts.push_back(i);
+  }
+  return starts;
+}
+
+QJsonObject ResultWriter::getPageJson(const BatchPage& page) {
+  QJsonObject obj;
+  obj["file"] = QString::fromStdString(page.fileName);
+  obj["page"] = page.pageIndex;
+  obj["width"] = page.size.width();
+  obj["height"] = page.size.height();
+  obj["textLayer"] = page.isTextLayer;
+  if (!page.ok)
+    obj["error"] = "cannot load page";
+  QJsonArray words;
+  for (const TextBox& tb : page.words) {
+    QJsonObject word;
+    word["box"] = QJsonArray({tb.m_rect.x(), tb.m_rect.y(),
+                              tb.m_rect.width(), tb.m_rect.height()});
+    word["text"] = tb.m_text;
+    // one decimal: Tesseract confidence is not more precise
+    word["conf"] = std::round(tb.m_confidence * 10.0) / 10.0;
+    words.append(word);
+  }
+  obj["words"] = words;
+  return obj;
+}
+
+bool ResultWriter::flush() {
+  if (m_buf.empty())
+    return true;
+  const qint64 size = (qint64)m_buf.size();
+  const bool ok = (m_out->write(m_buf.data(), size) == size);
+  m_buf.clear();
+  return ok;
+}
+
+void ResultWriter::append(const char* text) {
+  m_buf.append(text);
+}
+
+void ResultWriter::appendInt(int value) {
+  char str[16];
+  const int len = snprintf(str, sizeof(str), "%d", value);
+  m_buf.append(str, (size_t)len);
+}
+
+void ResultWriter::appendFixed(float value, int decimals) {
+  // printf("%f") would follow locale set by Qt application
+  int scale = 1;
+  for (int i = 0; i < decimals; i++) {
+    scale *= 10;
+  }
+  long units = lroundf(value * (float)scale);
+  if (units < 0) {
+    m_buf.push_back('-');
+    units = -units;
+  }
+  appendInt((int)(units / scale));
+  if (decimals <= 0)
+    return;
+  char str[16];
+  const int len = snprintf(str, sizeof(str), ".%0*d", decimals,
+                           (int)(units % scale));
+  m_buf.append(str, (size_t)len);
+}
+
+void ResultWriter::appendXml(const QString& text) {
+  appendXml(text.toStdString());
+}
+
+void ResultWriter::appendXml(const std::string& text) {
+  for (char c : text) {
+    switch (c) {
+      case '&':
+        m_buf.append("&amp;");
+        break;
+      case '<':
+        m_buf.append("&lt;");
+        break;
+      case '>':
+        m_buf.append("&gt;");
+        break;
+      case '"':
+        m_buf.append("&quot;");
+        break;
+      case '\'':
+        m_buf.append("&apos;");
+        break;
+      default:
+        // control characters are not allowed in XML 1.0
+        if ((unsigned char)c >= 0x20 || c == '\t' || c == '\n')
+          m_buf.push_back(c);
+        break;
+    }
+  }
+}
+
+bool HocrWriter::begin() {
+  append(
+      "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+      "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.0 Transitional//EN\"\n"
+      "    \"http://www.w3.org/TR/xhtml1/DTD/xhtml1-transitional.dtd\">\n"
+      "<html xmlns=\"http://www.w3.org/1999/xhtml\" xml:lang=\"en\" "
+      "lang=\"en\">\n"
+      " <head>\n"
+      "  <title></title>\n"
+      "  <meta http-equiv=\"Content-Type\" "
+      "content=\"text/html;charset=utf-8\"/>\n"
+      "  <meta name=\"ocr-system\" content=\"imb\"/>\n"
+      "  <meta name=\"ocr-capabilities\" "
+      "content=\"ocr_page ocr_line ocrx_word\"/>\n"
+      " </head>\n"
+      " <body>\n");
+  return flush();
+}
+
+void HocrWriter::appendBbox(const QRect& rect) {
+  append("bbox ");
+  appendInt(rect.left());
+  append(" ");
+  appendInt(rect.top());
+  append(" ");
+  appendInt(rect.left() + rect.width());
+  append(" ");
+  appendInt(rect.top() + rect.height());
+}
+
+bool HocrWriter::writePage(const BatchPage& page) {
+  const int numPage = ++m_numPages;
+  append("  <div class='ocr_page' id='page_");
+  appendInt(numPage);
+  append("' title='image \"");
+  appendXml(page.fileName);
+  append("\"; ");
+  appendBbox(QRect(0, 0, page.size.width(), page.size.height()));
+  append("; ppageno ");
+  appendInt(page.pageIndex);
+  append("'>\n");
+
+  const std::vector<TextBox>& words = page.words;
+  const std::vector<size_t> starts = getLineStarts(words);
+  for (size_t l = 0; l < starts.size(); l++) {
+    const size_t stop =
+        (l + 1 < starts.size()) ? starts[l + 1] : words.size();
+    append("   <span class='ocr_line' id='line_");
+    appendInt(numPage);
+    append("_");
+    appendInt((int)l + 1);
+    append("' title='");
+    appendBbox(getLineRect(words, starts[l], stop));
+    append("'>\n");
+    for (size_t i = starts[l]; i < stop; i++) {
+      append("    <span class='ocrx_word' id='word_");
+      appendInt(numPage);
+      append("_");
+      appendInt((int)i + 1);
+      append("' title='");
+      appendBbox(words[i].m_rect);
+      append("; x_wconf ");
+      appendInt((int)lroundf(words[i].m_confidence));
+      append("'>");
+      appendXml(words[i].m_text);
+      append("</span>\n");
+    }
+    append("   </span>\n");
+  }
+  append("  </div>\n");
+  return flush();
+}
+
+bool HocrWriter::end() {
+  append(" </body>\n</html>\n");
+  return flush();
+}
+
+bool AltoWriter::begin() {
+  append(
+      "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+      "<alto xmlns=\"http://www.loc.gov/standards/alto/ns-v4#\" "
+      "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
+      "xsi:schemaLocation=\"http://www.loc.gov/standards/alto/ns-v4# "
+      "http://www.loc.gov/alto/v4/alto-4-2.xsd\">\n"
+      " <Description>\n"
+      "  <MeasurementUnit>pixel</MeasurementUnit>\n"
+      "  <OCRProcessing ID=\"OCR_0\">\n"
+      "   <ocrProcessingStep>\n"
+      "    <processingSoftware>\n"
+      "     <softwareName>imb</softwareName>\n"
+      "    </processingSoftware>\n"
+      "   </ocrProcessingStep>\n"
+      "  </OCRProcessing>\n"
+      " </Description>\n"
+      " <Layout>\n");
+  return flush();
+}
+
+void AltoWriter::appendPos(const QRect& rect) {
+  append(" HPOS=\"");
+  appendInt(rect.left());
+  append("\" VPOS=\"");
+  appendInt(rect.top());
+  append("\" WIDTH=\"");
+  appendInt(rect.width());
+  append("\" HEIGHT=\"");
+  appendInt(rect.height());
+  append("\"");
+}
+
+bool AltoWriter::writePage(const BatchPage& page) {
+  const int numPage = ++m_numPages;
+  const QRect rectPage(0, 0, page.size.width(), page.size.height());
+  append("  <Page ID=\"page_");
+  appendInt(numPage);
+  append("\" PHYSICAL_IMG_NR=\"");
+  appendInt(numPage);
+  append("\" PRINTED_IMG_NR=\"");
+  appendXml(page.fileName);
+  append(":");
+  appendInt(page.pageIndex + 1);
+  append("\" WIDTH=\"");
+  appendInt(rectPage.width());
+  append("\" HEIGHT=\"");
+  appendInt(rectPage.height());
+  append("\">\n   <PrintSpace");
+  appendPos(rectPage);
+  append(">\n");
+
+  const std::vector<TextBox>& words = page.words;
+  if (!words.empty()) {
+    append("    <TextBlock ID=\"block_");
+    appendInt(numPage);
+    append("\"");
+    appendPos(getLineRect(words, 0, words.size()));
+    append(">\n");
+    const std::vector<size_t> starts = getLineStarts(words);
+    for (size_t l = 0; l < starts.size(); l++) {
+      const size_t stop =
+          (l + 1 < starts.size()) ? starts[l + 1] : words.size();
+      append("     <TextLine ID=\"line_");
+      appendInt(numPage);
+      append("_");
+      appendInt((int)l + 1);
+      append("\"");
+      appendPos(getLineRect(words, starts[l], stop));
+      append(">\n");
+      for (size_t i = starts[l]; i < stop; i++) {
+        append("      <String ID=\"string_");
+        appendInt(numPage);
+        append("_");
+        appendInt((int)i + 1);
+        append("\"");
+        appendPos(words[i].m_rect);
+        // word confidence [0..1]
+        append(" WC=\"");
+        appendFixed(words[i].m_confidence / 100.0F, 2);
+        append("\" CONTENT=\"");
+        appendXml(words[i].m_text);
+        append("\"/>\n");
+      }
+      append("     </TextLine>\n");
+    }
+    append("    </TextBlock>\n");
+  }
+  append("   </PrintSpace>\n  </Page>\n");
+  return flush();
+}
+
+bool AltoWriter::end() {
+  append(" </Layout>\n</alto>\n");
+  return flush();
+}
+
+bool JsonLinesWriter::writePage(const BatchPage& page) {
+  m_numPages++;
+  const QByteArray line =
+      QJsonDocument(getPageJson(page)).toJson(QJsonDocument::Compact);
+  m_buf.append(line.constData(), (size_t)line.size());
+  m_buf.push_back('\n');
+  return flush();
+}
@@ -0,0 +1,75 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _RESULT_WRITER_H__
+#define _RESULT_WRITER_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QtCore/QIODevice>
+#include <QtCore/QJsonObject>
+#include <QtCore/QString>
+
+#include "BatchPipeline.h"
+#include "RecogRes.h"
+
+enum class ResultFormat {
+  HOCR = 0,
+  ALTO = 1,
+  JSONL = 2,
+};
+
+// Streaming serializer of recognized pages: every page is formatted into
+// a reused buffer and written out at once, so memory does not grow with
+// the number of pages. Not thread safe, pages should come in order (see
+// BatchPipeline::PageCallback).
+class ResultWriter
+{
+public:
+  // out should be open for writing and outlive the writer
+  explicit ResultWriter(QIODevice* out);
+  virtual ~ResultWriter() = default;
+
+  ResultWriter(const ResultWriter&) = delete;
+  ResultWriter& operator=(const ResultWriter&) = delete;
+
+  // document header, before the first page. false on write error
+  virtual bool begin();
+  virtual bool writePage(const BatchPage& page) = 0;
+  // document footer, after the last page
+  virtual bool end();
+
+  int getNumPages() const {
+    return m_numPages;
+  }
+
+  static std::unique_ptr<ResultWriter> create(ResultFormat format,
+                                              QIODevice* out);
+  // "hocr", "alto", "jsonl". false for unknown name
+  static bool getFormatByName(const char* name, ResultFormat& format);
+  static const char* getFileSuffix(ResultFormat format);
+  // indices of words which start text lines: words of Tesseract come in
+  // reading order, line ends when next word is not on the same baseline
+  static std::vector<size_t> getLineStarts(const std::vector<TextBox>& words);
+  // page object of JSON Lines results and OcrServer page replies
+  static QJsonObject getPageJson(const BatchPage& page);
+
+protected:
+  // buffer is written to device and cleared, its capacity is kept
+  bool flush();
+  void append(const char* text);
+  void appendInt(int value);
+  // fixed point number, independent of C locale
+  void appendFixed(float value, int decimals);
+  void appendXml(const QString& text);
+  void appendXml(const std::string& text);
+
+  QIODevice*    m_out;
+  std::string   m_buf;
+  int           m_numPages;
+};
+
+#endif
@@ -0,0 +1,27 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _SIMD_H__
+#define _SIMD_H__
+
+// SIMD instruction sets, available for the current compilation.
+// SSE2 is always present on x64 targets, AVX2 requires /arch:AVX2
+// (MSVC) or -mavx2 (gcc, clang).
+
+#if defined(__AVX2__)
+#define IMB_SIMD_AVX2
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define IMB_SIMD_SSE2
+#endif
+
+#if defined(IMB_SIMD_AVX2)
+#include <immintrin.h>
+#elif defined(IMB_SIMD_SSE2)
+#include <emmintrin.h>
+#endif
+
+#endif
@@ -0,0 +1,75 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _SPSC_QUEUE_H__
+#define _SPSC_QUEUE_H__
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread (ring buffer). Producer only writes tail, consumer only writes
+// head, so neither side ever waits for a lock held by the other.
+// T should be default constructible and movable.
+template <typename T>
+class SpscQueue
+{
+public:
+  // capacity is rounded up to power of 2
+  explicit SpscQueue(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity)
+      size *= 2;
+    m_items.resize(size);
+    m_mask = size - 1;
+    m_head.store(0);
+    m_tail.store(0);
+  }
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  // producer side. false (and item is untouched) if queue is full
+  bool push(T&& item) {
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) > m_mask)
+      return false;
+    m_items[tail & m_mask] = std::move(item);
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer side. false if queue is empty
+  bool pop(T& item) {
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire))
+      return false;
+    item = std::move(m_items[head & m_mask]);
+    // moved-from slot should not keep item resources alive
+    m_items[head & m_mask] = T();
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // approximate when called concurrently with push / pop
+  bool isEmpty() const {
+    return m_head.load(std::memory_order_acquire) ==
+           m_tail.load(std::memory_order_acquire);
+  }
+  size_t getCapacity() const {
+    return m_mask + 1;
+  }
+
+private:
+  std::vector<T>        m_items;
+  size_t                m_mask;
+  // next item to pop, written by consumer only
+  alignas(64) std::atomic<size_t>   m_head;
+  // next free slot, written by producer only
+  alignas(64) std::atomic<size_t>   m_tail;
+};
+
+#endif
@@ -0,0 +1,96 @@
+//
+// Copyright 2022 Vlad
+//
+
+#include <cmath>
+#include <vector>
+
+#include <QtCore/QDebug>
+
+#include "Bmp.h"
+#include "FImage.h"
+#include "FastMeanStd.h"
+#include "IntegralImage.h"
+#include "PdfRender.h"
+#include "TextScale.h"
+#include "Trace.h"
+
+// Sauvola window on probe and factor, see WidImageBinarizer
+constexpr int cTextScaleProbeWindow = 15;
+constexpr float cTextScaleProbeFactor = 0.25F;
+
+int TextScale::estimateXHeight(const BinImage& image, int minComponents) {
+  if (image.isNull())
+    return 0;
+  PIX* pix = BmpBinImageToPix(image);
+  if (pix == nullptr)
+    return 0;
+  BOXA* boxa = pixConnCompBB(pix, 8);
+  pixDestroy(&pix);
+  if (boxa == nullptr)
+    return 0;
+
+  // rules, frames and pictures are larger, noise is smaller
+  const int hMax = image.height() / 10;
+  std::vector<int> histogram(hMax + 2, 0);
+  int numComponents = 0;
+  const int numBoxes = boxaGetCount(boxa);
+  for (int i = 0; i < numBoxes; i++) {
+    l_int32 x, y, w, h;
+    boxaGetBoxGeometry(boxa, i, &x, &y, &w, &h);
+    if ((h < 3) || (h > hMax) || (w > h * 4))
+      continue;
+    histogram[h]++;
+    numComponents++;
+  }
+  boxaDestroy(&boxa);
+  if (numComponents < minComponents)
+    return 0;
+
+  // mode of histogram smoothed by neighbours: one pixel jitter of
+  // the same letters
+  int hBest = 0;
+  int sumBest = 0;
+  for (int h = 3; h <= hMax; h++) {
+    const int sum = histogram[h - 1] + 2 * histogram[h] + histogram[h + 1];
+    if (sum > sumBest) {
+      sumBest = sum;
+      hBest = h;
+    }
+  }
+  return hBest;
+}
+
+float TextScale::getScale(const BinImage& probe,
+                          const AutoScaleParams& params) {
+  const int xHeight = estimateXHeight(probe, params.minComponents);
+  if (xHeight <= 0)
+    return 0.0F;
+  const float xHeightTarget = params.targetCapHeight * TEXT_SCALE_X_TO_CAP;
+  float scale = params.probeScale * xHeightTarget / (float)xHeight;
+  scale = std::round(scale / params.scaleStep) * params.scaleStep;
+  if (scale < params.minScale)
+    scale = params.minScale;
+  if (scale > params.maxScale)
+    scale = params.maxScale;
+  return scale;
+}
+
+float TextScale::getPageScale(fz_context* ctx, fz_document* doc,
+                              int pageIndex, float rotate,
+                              const AutoScaleParams& params) {
+  TRACE_ZONE("textScale");
+  QImage probe = PdfRender::renderPage(
+      ctx, doc, pageIndex, PdfRender::getMatrix(params.probeScale, rotate),
+      true);
+  if (probe.isNull())
+    return 0.0F;
+  FImage imageFloat(probe);
+  IntegralImage integral(imageFloat);
+  BinImage probeBin(imageFloat.width(), imageFloat.height());
+  FastMeanStd::getSauvolaFused(imageFloat, integral, cTextScaleProbeWindow,
+                               cTextScaleProbeFactor, probeBin);
+  const float scale = getScale(probeBin, params);
+  qInfo() << "TextScale: page" << pageIndex << "auto scale" << scale;
+  return scale;
+}
@@ -0,0 +1,57 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _TEXT_SCALE_H__
+#define _TEXT_SCALE_H__
+
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable : 4100)
+#pragma warning(disable : 4611)
+#endif
+
+#include "mupdf/fitz.h"
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+#include "BinImage.h"
+
+// x-height / cap height of typical latin and cyrillic fonts
+#define TEXT_SCALE_X_TO_CAP       0.7F
+
+struct AutoScaleParams {
+  // probe render scale (1.0 is 72 dpi): body text x-height 6-8 pixels
+  float   probeScale = 1.5F;
+  // tesseract works best with cap height about 30 pixels
+  float   targetCapHeight = 30.0F;
+  float   minScale = 0.5F;
+  float   maxScale = 8.0F;
+  // scale is rounded to this step: same pages share cache keys
+  float   scaleStep = 0.25F;
+  // less character-like components: page has no text to measure
+  int     minComponents = 20;
+};
+
+// Render scale from text size: dominant height of connected components on
+// a cheap low resolution probe is the x-height of body text (most of
+// lowercase letters have no ascenders and descenders). Page is rendered
+// at the scale, which gives target cap height.
+class TextScale {
+ public:
+  // dominant component height in pixels, 0 if there are less than
+  // minComponents character-like components
+  static int estimateXHeight(const BinImage& image, int minComponents);
+  // render scale for probe rendered with probeScale, 0 if unknown
+  static float getScale(const BinImage& probe,
+                        const AutoScaleParams& params = AutoScaleParams());
+  // probe render, binarization and estimation. ctx should be the only
+  // user of doc during call. 0 if unknown (no text, mupdf error)
+  static float getPageScale(fz_context* ctx, fz_document* doc, int pageIndex,
+                            float rotate,
+                            const AutoScaleParams& params = AutoScaleParams());
+};
+
+#endif
@@ -0,0 +1,180 @@
+//
+// Copyright 2022 Vlad
+//
+
+#include <cassert>
+#include <chrono>
+#include <string>
+
+#include "ThreadPool.h"
+#include "Trace.h"
+
+// range is split into more chunks than threads for load balance
+const int POOL_CHUNKS_PER_THREAD = 4;
+
+// completion state of one parallelFor call
+struct ParallelForSync {
+  std::mutex                mutex;
+  std::condition_variable   cond;
+  int                       numLeft;
+};
+
+ThreadPool& ThreadPool::instance() {
+  static ThreadPool pool;
+  return pool;
+}
+
+ThreadPool::ThreadPool() {
+  m_numWorkers = 1;
+  m_indexQueueNext = 0;
+  m_numQueued = 0;
+  m_stop = false;
+  setNumWorkers(0);
+}
+
+ThreadPool::~ThreadPool() {
+  stopThreads();
+}
+
+void ThreadPool::setNumWorkers(int numWorkers) {
+  if (numWorkers <= 0) {
+    numWorkers = (int)std::thread::hardware_concurrency();
+    if (numWorkers < 1)
+      numWorkers = 1;
+  }
+  if ((numWorkers == m_numWorkers) && ((int)m_threads.size() == numWorkers - 1))
+    return;
+  stopThreads();
+  m_numWorkers = numWorkers;
+  startThreads(numWorkers - 1);
+}
+
+void ThreadPool::startThreads(int numThreads) {
+  m_stop = false;
+  m_queues.clear();
+  for (int i = 0; i < numThreads; i++) {
+    m_queues.push_back(std::make_unique<TaskQueue>());
+  }
+  for (int i = 0; i < numThreads; i++) {
+    m_threads.emplace_back(&ThreadPool::workerLoop, this, i);
+  }
+}
+
+void ThreadPool::stopThreads() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutexWake);
+    m_stop = true;
+  }
+  m_condWake.notify_all();
+  for (auto& t : m_threads) {
+    t.join();
+  }
+  m_threads.clear();
+  assert(m_numQueued == 0);
+}
+
+bool ThreadPool::popTask(int indexQueue, Task& task) {
+  const int numQueues = (int)m_queues.size();
+  if (indexQueue >= 0) {
+    TaskQueue& q = *m_queues[indexQueue];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (!q.tasks.empty()) {
+      task = std::move(q.tasks.front());
+      q.tasks.pop_front();
+      m_numQueued--;
+      return true;
+    }
+  }
+  // steal
+  const int indexStart = (indexQueue >= 0) ? indexQueue + 1 : 0;
+  for (int i = 0; i < numQueues; i++) {
+    const int indexVictim = (indexStart + i) % numQueues;
+    if (indexVictim == indexQueue)
+      continue;
+    TaskQueue& q = *m_queues[indexVictim];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (!q.tasks.empty()) {
+      task = std::move(q.tasks.back());
+      q.tasks.pop_back();
+      m_numQueued--;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::workerLoop(int indexQueue) {
+  const std::string name = "pool " + std::to_string(indexQueue);
+  Trace::setThreadName(name.c_str());
+  for (;;) {
+    Task task;
+    if (popTask(indexQueue, task)) {
+      task();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(m_mutexWake);
+    m_condWake.wait(lock, [this] { return m_stop || (m_numQueued > 0); });
+    if (m_stop && (m_numQueued == 0))
+      return;
+  }
+}
+
+void ThreadPool::parallelFor(int begin, int end,
+                             const std::function<void(int, int)>& body,
+                             int grain) {
+  const int numItems = end - begin;
+  if (numItems <= 0)
+    return;
+  if (grain < 1)
+    grain = 1;
+  int numChunks = numItems / grain;
+  if (numChunks > m_numWorkers * POOL_CHUNKS_PER_THREAD)
+    numChunks = m_numWorkers * POOL_CHUNKS_PER_THREAD;
+  if ((numChunks <= 1) || m_queues.empty()) {
+    body(begin, end);
+    return;
+  }
+
+  auto sync = std::make_shared<ParallelForSync>();
+  sync->numLeft = numChunks;
+  const int numQueues = (int)m_queues.size();
+  for (int i = 0; i < numChunks; i++) {
+    const int chunkBegin = begin + (int)((int64_t)i * numItems / numChunks);
+    const int chunkEnd = begin + (int)((int64_t)(i + 1) * numItems / numChunks);
+    Task task = [&body, sync, chunkBegin, chunkEnd]() {
+      {
+        TRACE_ZONE("poolChunk");
+        body(chunkBegin, chunkEnd);
+      }
+      std::lock_guard<std::mutex> lock(sync->mutex);
+      if (--sync->numLeft == 0)
+        sync->cond.notify_all();
+    };
+    TaskQueue& q = *m_queues[m_indexQueueNext++ % numQueues];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    q.tasks.push_back(std::move(task));
+    m_numQueued++;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutexWake);
+  }
+  m_condWake.notify_all();
+
+  // help workers until all chunks of this call are finished
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(sync->mutex);
+      if (sync->numLeft == 0)
+        return;
+    }
+    Task task;
+    if (popTask(-1, task)) {
+      task();
+      continue;
+    }
+    // remaining chunks are being processed by workers
+    std::unique_lock<std::mutex> lock(sync->mutex);
+    sync->cond.wait(lock, [&sync] { return sync->numLeft == 0; });
+    return;
+  }
+}
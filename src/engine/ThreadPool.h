@@ -0,0 +1,75 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _THREAD_POOL_H__
+#define _THREAD_POOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Process-wide pool of persistent worker threads for engine kernels.
+// Every worker has its own task queue; idle workers steal tasks from
+// the other queues. Thread calling parallelFor also executes tasks while
+// waiting, so nested parallelFor calls can not deadlock.
+class ThreadPool
+{
+public:
+  static ThreadPool& instance();
+
+  // Number of threads running parallelFor chunks, including the calling
+  // thread (so pool owns numWorkers - 1 threads). 0 means all CPU cores.
+  // Should not be called while parallelFor is running.
+  void setNumWorkers(int numWorkers);
+  int  getNumWorkers() const {
+    return m_numWorkers;
+  }
+
+  // Process range [begin .. end) by body(chunkBegin, chunkEnd) calls on
+  // the pool threads. Chunks are at least grain long (except the last one).
+  // Returns after all chunks are finished.
+  void parallelFor(int begin, int end,
+                   const std::function<void(int, int)>& body,
+                   int grain = 1);
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+private:
+  using Task = std::function<void()>;
+  struct TaskQueue {
+    std::mutex          mutex;
+    std::deque<Task>    tasks;
+  };
+
+  ThreadPool();
+  ~ThreadPool();
+
+  void startThreads(int numThreads);
+  void stopThreads();
+  void workerLoop(int indexQueue);
+  // own queue front first, then steal from the back of other queues.
+  // indexQueue < 0: no own queue (calling thread)
+  bool popTask(int indexQueue, Task& task);
+
+  int                                       m_numWorkers;
+  std::vector<std::thread>                  m_threads;
+  std::vector<std::unique_ptr<TaskQueue>>   m_queues;
+  // next queue to put task into
+  std::atomic<unsigned>                     m_indexQueueNext;
+
+  // idle workers sleep here
+  std::mutex                                m_mutexWake;
+  std::condition_variable                   m_condWake;
+  // tasks in queues, not taken yet
+  std::atomic<int>                          m_numQueued;
+  bool                                      m_stop;
+};
+
+#endif
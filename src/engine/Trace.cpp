@@ -0,0 +1,222 @@
+//
+// Copyright 2022 Vlad
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "Trace.h"
+
+using TraceClock = std::chrono::steady_clock;
+
+// written out when buffer grows above
+constexpr size_t cTraceWriteChunk = 1 << 16;
+
+// events of one thread. Ring outlives its thread: events are written out
+// later; ring of finished thread is reused by the next new one
+struct TraceRing {
+  std::mutex                mutex;
+  std::vector<TraceEvent>   events;
+  // position of next event is numAdded % TRACE_RING_SIZE
+  uint64_t                  numAdded = 0;
+  bool                      isFree = false;
+};
+
+struct TraceRegistry {
+  std::mutex                                mutex;
+  std::vector<std::unique_ptr<TraceRing>>   rings;
+  // index is thread id
+  std::vector<std::string>                  threadNames;
+};
+
+// ring and id of calling thread, ring is released at thread exit
+struct TraceThread {
+  TraceRing*  ring = nullptr;
+  int         threadId = -1;
+  ~TraceThread();
+};
+
+std::atomic<bool> Trace::s_isEnabled(false);
+
+static const TraceClock::time_point s_timeStart = TraceClock::now();
+static thread_local TraceThread s_thread;
+
+static TraceRegistry& getRegistry() {
+  static TraceRegistry registry;
+  return registry;
+}
+
+TraceThread::~TraceThread() {
+  if (ring == nullptr)
+    return;
+  std::lock_guard<std::mutex> lock(getRegistry().mutex);
+  ring->isFree = true;
+}
+
+// registry mutex should be locked
+static int getThreadId(TraceRegistry& registry) {
+  if (s_thread.threadId < 0) {
+    s_thread.threadId = (int)registry.threadNames.size();
+    registry.threadNames.emplace_back();
+  }
+  return s_thread.threadId;
+}
+
+static TraceRing* acquireRing() {
+  TraceRegistry& registry = getRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  getThreadId(registry);
+  for (const std::unique_ptr<TraceRing>& ring : registry.rings) {
+    if (ring->isFree) {
+      ring->isFree = false;
+      return ring.get();
+    }
+  }
+  registry.rings.push_back(std::make_unique<TraceRing>());
+  TraceRing* ring = registry.rings.back().get();
+  ring->events.resize(TRACE_RING_SIZE);
+  return ring;
+}
+
+// microseconds with 3 decimals, independent of C locale
+static void appendMicros(std::string& buf, int64_t timeNs) {
+  buf += std::to_string(timeNs / 1000);
+  const int rest = (int)(timeNs % 1000);
+  buf += '.';
+  buf += (char)('0' + rest / 100);
+  buf += (char)('0' + (rest / 10) % 10);
+  buf += (char)('0' + rest % 10);
+}
+
+// names are identifiers of the code: quotes and escapes are dropped
+static void appendName(std::string& buf, const char* name) {
+  buf += '"';
+  for (const char* s = name; *s != 0; s++) {
+    if ((*s != '"') && (*s != '\\') && ((unsigned char)*s >= ' '))
+      buf += *s;
+  }
+  buf += '"';
+}
+
+static bool writeChunk(QIODevice* out, std::string& buf) {
+  const qint64 size = (qint64)buf.size();
+  const bool ok = (out->write(buf.data(), size) == size);
+  buf.clear();
+  return ok;
+}
+
+void Trace::setEnabled(bool isEnabled) {
+  s_isEnabled.store(isEnabled, std::memory_order_relaxed);
+}
+
+int64_t Trace::getTimeNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             TraceClock::now() - s_timeStart).count();
+}
+
+void Trace::addEvent(const char* name, int64_t timeStart, int64_t timeEnd,
+                     int page) {
+  if (s_thread.ring == nullptr)
+    s_thread.ring = acquireRing();
+  TraceRing& ring = *s_thread.ring;
+  // not contended: only getEvents and clear take it from other threads
+  std::lock_guard<std::mutex> lock(ring.mutex);
+  TraceEvent& evt = ring.events[ring.numAdded % TRACE_RING_SIZE];
+  evt.name = name;
+  evt.timeStart = timeStart;
+  evt.duration = timeEnd - timeStart;
+  evt.threadId = s_thread.threadId;
+  evt.page = page;
+  ring.numAdded++;
+}
+
+void Trace::setThreadName(const char* name) {
+  TraceRegistry& registry = getRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.threadNames[getThreadId(registry)] = name;
+}
+
+std::vector<TraceEvent> Trace::getEvents() {
+  TraceRegistry& registry = getRegistry();
+  std::vector<TraceEvent> events;
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (const std::unique_ptr<TraceRing>& ring : registry.rings) {
+    std::lock_guard<std::mutex> lockRing(ring->mutex);
+    const uint64_t numKept =
+        std::min<uint64_t>(ring->numAdded, TRACE_RING_SIZE);
+    for (uint64_t i = ring->numAdded - numKept; i < ring->numAdded; i++) {
+      events.push_back(ring->events[i % TRACE_RING_SIZE]);
+    }
+  }
+  return events;
+}
+
+double Trace::getTotalMs(const char* name) {
+  int64_t sumNs = 0;
+  for (const TraceEvent& evt : getEvents()) {
+    if (strcmp(evt.name, name) == 0)
+      sumNs += evt.duration;
+  }
+  return (double)sumNs / 1.0e6;
+}
+
+void Trace::clear() {
+  TraceRegistry& registry = getRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (const std::unique_ptr<TraceRing>& ring : registry.rings) {
+    std::lock_guard<std::mutex> lockRing(ring->mutex);
+    ring->numAdded = 0;
+  }
+}
+
+bool Trace::write(QIODevice* out) {
+  std::vector<std::string> threadNames;
+  {
+    TraceRegistry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    threadNames = registry.threadNames;
+  }
+  const std::vector<TraceEvent> events = getEvents();
+
+  std::string buf = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool isFirst = true;
+  bool ok = true;
+  // tid 0 is not shown by some viewers: thread id + 1
+  for (size_t i = 0; i < threadNames.size(); i++) {
+    if (threadNames[i].empty())
+      continue;
+    buf += isFirst ? "\n" : ",\n";
+    isFirst = false;
+    buf += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":";
+    buf += std::to_string(i + 1);
+    buf += ",\"args\":{\"name\":";
+    appendName(buf, threadNames[i].c_str());
+    buf += "}}";
+  }
+  for (const TraceEvent& evt : events) {
+    buf += isFirst ? "\n" : ",\n";
+    isFirst = false;
+    buf += "{\"name\":";
+    appendName(buf, evt.name);
+    buf += ",\"cat\":\"imb\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+    buf += std::to_string(evt.threadId + 1);
+    buf += ",\"ts\":";
+    appendMicros(buf, evt.timeStart);
+    buf += ",\"dur\":";
+    appendMicros(buf, evt.duration);
+    if (evt.page >= 0) {
+      buf += ",\"args\":{\"page\":";
+      buf += std::to_string(evt.page);
+      buf += '}';
+    }
+    buf += '}';
+    if (buf.size() > cTraceWriteChunk)
+      ok = writeChunk(out, buf) && ok;
+  }
+  buf += "\n]}\n";
+  return writeChunk(out, buf) && ok;
+}
@@ -0,0 +1,87 @@
+//
+// Copyright 2022 Vlad
+//
+
+#ifndef _TRACE_H__
+#define _TRACE_H__
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <QtCore/QIODevice>
+
+// events kept per thread, older ones are overwritten
+#define TRACE_RING_SIZE   (1 << 15)
+
+struct TraceEvent {
+  // string literal: pointer is stored, not the text
+  const char* name;
+  // nanoseconds since process start
+  int64_t     timeStart;
+  int64_t     duration;
+  int         threadId;
+  // page index of pipeline, -1: none
+  int         page;
+};
+
+// Stage level tracing: scoped zones (TRACE_ZONE) are recorded into ring
+// buffers of their threads and written out as Chrome trace event JSON
+// (chrome://tracing, ui.perfetto.dev). While disabled a zone costs one
+// relaxed atomic load, so zones are compiled in everywhere.
+class Trace
+{
+public:
+  static void setEnabled(bool isEnabled);
+  static bool isEnabled() {
+    return s_isEnabled.load(std::memory_order_relaxed);
+  }
+  static int64_t getTimeNs();
+
+  static void addEvent(const char* name, int64_t timeStart, int64_t timeEnd,
+                       int page = -1);
+  // name of calling thread in trace, text is copied
+  static void setThreadName(const char* name);
+
+  // events of all threads, oldest first within every thread
+  static std::vector<TraceEvent> getEvents();
+  // sum of durations of zones with this name
+  static double getTotalMs(const char* name);
+  static void clear();
+  // JSON object with traceEvents array. false on write error
+  static bool write(QIODevice* out);
+
+private:
+  static std::atomic<bool> s_isEnabled;
+};
+
+// records its lifetime as an event, if tracing was enabled at start
+class TraceZone
+{
+public:
+  explicit TraceZone(const char* name, int page = -1) {
+    m_name = name;
+    m_page = page;
+    m_timeStart = Trace::isEnabled() ? Trace::getTimeNs() : -1;
+  }
+  ~TraceZone() {
+    if (m_timeStart >= 0)
+      Trace::addEvent(m_name, m_timeStart, Trace::getTimeNs(), m_page);
+  }
+
+  TraceZone(const TraceZone&) = delete;
+  TraceZone& operator=(const TraceZone&) = delete;
+
+private:
+  const char* m_name;
+  int64_t     m_timeStart;
+  int         m_page;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b)  TRACE_CONCAT_(a, b)
+// zone from this line to the end of the scope
+#define TRACE_ZONE(...) \
+  TraceZone TRACE_CONCAT(traceZone, __LINE__)(__VA_ARGS__)
+
+#endif
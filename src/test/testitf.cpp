@@ -2,9 +2,46 @@
 //
 //
 
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include <QtCore/QBuffer>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QXmlStreamReader>
+#include <QtNetwork/QLocalSocket>
+
 #include "testitf.h"
 #include "FImage.h"
 #include "FastMeanStd.h"
+#include "BufferPool.h"
+#include "IntegralImage.h"
+#include "ThreadPool.h"
+#include "Bmp.h"
+#include "PdfExport.h"
+#include "PdfRender.h"
+#include "PdfText.h"
+#include "FzLocks.h"
+#include "PageCache.h"
+#include "PdfPages.h"
+#include "TextScale.h"
+#include "BinImage.h"
+#include "ImageDif.h"
+#include "OcrPool.h"
+#include "PageLayout.h"
+#include "SpscQueue.h"
+#include "RecogWorker.h"
+#include "BoundedQueue.h"
+#include "BatchPipeline.h"
+#include "OcrServer.h"
+#include "ResultWriter.h"
+#include "Trace.h"
+#include "mupdf/tessocr.h"
 
 
 TestInterface::TestInterface(QObject *parent) {
@@ -116,12 +153,16 @@ void TestInterface::testGaussThreads() {
 
   FImage imageKernel = getGaussianKernel(9, 9, 1.2F);
 
-  float timeSlow, timeFast;
-
-  FImage imageSmooth = imageSrc.getGaussSmooth(imageKernel, &timeSlow);
-  FImage imageSmoothThr = imageSrc.getGaussSmoothViaThreads(imageKernel, &timeFast);
+  Trace::clear();
+  Trace::setEnabled(true);
+  FImage imageSmooth = imageSrc.getGaussSmooth(imageKernel);
+  FImage imageSmoothThr = imageSrc.getGaussSmoothViaThreads(imageKernel);
+  Trace::setEnabled(false);
+  const double timeSlow = Trace::getTotalMs("gaussSmooth");
+  const double timeFast = Trace::getTotalMs("gaussSmoothThreads");
+  Trace::clear();
 
-  const float speedUpTimes = timeSlow / timeFast;
+  const double speedUpTimes = timeSlow / timeFast;
   QVERIFY(speedUpTimes > 2.5f);
 
   float *pixelsDst = imageSmooth.getBits();
@@ -283,3 +324,1644 @@ void TestInterface::testFastMean() {
   err = err / numPixels;
   QVERIFY(err < 1.0e-3F);
 }
+
+void TestInterface::testBufferPool() {
+  const int w = 320;
+  const int h = 240;
+  BufferPool& pool = BufferPool::instance();
+
+  // warm up: first image of this size may be allocated from heap
+  {
+    FImage imageWarm(w, h);
+  }
+  pool.resetCounters();
+
+  FImage imageSrc(w, h);
+  float *pixels = imageSrc.getBits();
+  const int numPixels = w * h;
+  for (int i = 0; i < numPixels; i++) {
+    pixels[i] = (float)(i & 255);
+  }
+  QVERIFY(pool.getNumHits() == 1);
+  QVERIFY(pool.getNumMisses() == 0);
+
+  // run full naive sauvola twice: second run should not touch heap
+  for (int iter = 0; iter < 2; iter++) {
+    if (iter == 1)
+      pool.resetCounters();
+    FImage imageMean = imageSrc.getWindowedMean(3);
+    FImage imageStdDev = imageSrc.getWindowedStdDev(imageMean, 3);
+    FImage imageThr = imageMean.getSauvolaThreshold(imageStdDev, 0.25F);
+    FImage imageBina = imageSrc.applyThresholds(imageThr);
+  }
+  QVERIFY(pool.getNumHits() == 4);
+  QVERIFY(pool.getNumMisses() == 0);
+
+  // buckets are never smaller than requested
+  QVERIFY(BufferPool::getBucketSize(1) >= 1);
+  QVERIFY(BufferPool::getBucketSize(5000) >= 5000);
+  QVERIFY(BufferPool::getBucketSize(4960 * 7016) >= 4960 * 7016);
+  QVERIFY(BufferPool::getBucketSize(4960 * 7016) < 4960 * 7016 / 8 * 9);
+}
+
+void TestInterface::testSauvolaFused() {
+  const int w = 64;
+  const int h = 48;
+  FImage imageSrc(w, h);
+  const int numPixels = w * h;
+  float *pixels = imageSrc.getBits();
+
+  srand(0x3417);
+  for (int i = 0; i < numPixels; i++) {
+    pixels[i] = (float)(rand() & 255);
+  }  //
+
+  const int neibSize = 5;
+  const float factor = 0.25F;
+
+  // separate passes
+  FImage imageMean(w, h);
+  FImage imageStd(w, h);
+  FastMeanStd::getFastMeanStd(imageSrc, imageMean, imageStd, neibSize);
+  FImage imageThr = imageMean.getSauvolaThreshold(imageStd, factor);
+  FImage imageBina = imageSrc.applyThresholds(imageThr);
+
+  // fused pass without and with debug images
+  FImage imageFused(w, h);
+  FastMeanStd::getSauvolaFused(imageSrc, neibSize, factor, imageFused);
+  FImage imageFusedDbg(w, h);
+  FImage imageMeanDbg(w, h);
+  FImage imageStdDbg(w, h);
+  FImage imageThrDbg(w, h);
+  FastMeanStd::getSauvolaFused(imageSrc, neibSize, factor, imageFusedDbg,
+                               &imageMeanDbg, &imageStdDbg, &imageThrDbg);
+
+  const float *floatBina = imageBina.getBits();
+  const float *floatFused = imageFused.getBits();
+  const float *floatFusedDbg = imageFusedDbg.getBits();
+  const float *floatThr = imageThr.getBits();
+  const float *floatThrDbg = imageThrDbg.getBits();
+  const float *floatStd = imageStd.getBits();
+  const float *floatStdDbg = imageStdDbg.getBits();
+  for (int i = 0; i < numPixels; i++) {
+    QVERIFY(floatBina[i] == floatFused[i]);
+    QVERIFY(floatBina[i] == floatFusedDbg[i]);
+    QVERIFY(fabs(floatThr[i] - floatThrDbg[i]) < 1.0e-3F);
+    QVERIFY(fabs(floatStd[i] - floatStdDbg[i]) < 1.0e-3F);
+  }  // for i
+}
+
+void TestInterface::testIntegralImageExact() {
+  // same data as in testIntegralSum3x3
+  const uint8_t pixels3x3[] = {192, 166, 113, 147, 194, 227, 219, 97, 29};
+  IntegralImage integral3x3(pixels3x3, 3, 3, 3);
+  QVERIFY(integral3x3.getSum(1, 1, 2, 2) == 547);
+  QVERIFY(integral3x3.getSum(1, 0, 2, 1) == 700);
+  QVERIFY(integral3x3.getSum(0, 1, 1, 2) == 657);
+  QVERIFY(integral3x3.getSum(0, 0, 0, 0) == 192);
+  QVERIFY(integral3x3.getSum2(2, 2, 2, 2) == 29 * 29);
+  QVERIFY(integral3x3.getSum2(0, 0, 1, 0) == 192 * 192 + 166 * 166);
+
+  // large white page: float sum of squares is not exact here
+  const int w = 1024;
+  const int h = 1024;
+  FImage imageSrc(w, h);
+  float *pixels = imageSrc.getBits();
+  const int numPixels = w * h;
+  for (int i = 0; i < numPixels; i++) {
+    pixels[i] = 255.0F;
+  }
+  IntegralImage integral(imageSrc);
+  const uint64_t sum2Match = (uint64_t)9 * 255 * 255;
+  QVERIFY(integral.getSum(w - 3, h - 3, w - 1, h - 1) == 9 * 255);
+  QVERIFY(integral.getSum2(w - 3, h - 3, w - 1, h - 1) == sum2Match);
+  QVERIFY(integral.getSum2(0, 0, w - 1, h - 1) ==
+          (uint64_t)numPixels * 255 * 255);
+
+  // std dev of constant image should be zero
+  FImage imageMean(w, h);
+  FImage imageStd(w, h);
+  FastMeanStd::getFastMeanStd(integral, imageMean, imageStd, 31);
+  const float *floatMean = imageMean.getBits();
+  const float *floatStd = imageStd.getBits();
+  QVERIFY(floatMean[numPixels - 1] == 255.0F);
+  QVERIFY(floatStd[numPixels - 1] == 0.0F);
+
+  // random image: compare with slow calculation
+  const int wr = 16;
+  const int hr = 12;
+  FImage imageRand(wr, hr);
+  pixels = imageRand.getBits();
+  srand(0x1942);
+  for (int i = 0; i < wr * hr; i++) {
+    pixels[i] = (float)(rand() & 255);
+  }
+  IntegralImage integralRand(imageRand);
+  FImage imageMeanFast(wr, hr);
+  FImage imageStdFast(wr, hr);
+  FastMeanStd::getFastMeanStd(integralRand, imageMeanFast, imageStdFast, 5);
+  FImage imageMeanSlow = imageRand.getWindowedMean(5);
+  FImage imageStdSlow = imageRand.getWindowedStdDev(imageMeanSlow, 5);
+  for (int i = 0; i < wr * hr; i++) {
+    QVERIFY(fabs(imageMeanFast.getBits()[i] - imageMeanSlow.getBits()[i]) <
+            1.0e-3F);
+    QVERIFY(fabs(imageStdFast.getBits()[i] - imageStdSlow.getBits()[i]) <
+            1.0e-3F);
+  }
+}
+
+void TestInterface::testFastMeanStdScaling() {
+  const int w = 2048;
+  const int h = 2048;
+  FImage imageSrc(w, h);
+  const int numPixels = w * h;
+  float *pixels = imageSrc.getBits();
+  srand(0x5432);
+  for (int i = 0; i < numPixels; i++) {
+    pixels[i] = (float)(rand() & 255);
+  }
+  const int neibSize = 31;
+  const float factor = 0.25F;
+
+  FImage imageRef(w, h);
+  FImage imageDst(w, h);
+
+  const int numCpuCores = (int)std::thread::hardware_concurrency();
+  // at least few threads to check band split even on small machines
+  const int numThreadsMax = (numCpuCores > 4) ? numCpuCores : 4;
+  float timeOne = 0.0F;
+  for (int numThreads = 1; numThreads <= numThreadsMax; numThreads++) {
+    ThreadPool::instance().setNumWorkers(numThreads);
+
+    std::chrono::high_resolution_clock::time_point timeS, timeE;
+    timeS = std::chrono::high_resolution_clock::now();
+    IntegralImage integral(imageSrc);
+    FastMeanStd::getSauvolaFused(imageSrc, integral, neibSize, factor,
+                                 (numThreads == 1) ? imageRef : imageDst);
+    timeE = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> timeSpan = timeE - timeS;
+    const auto timeMs = (float)timeSpan.count();
+    if (numThreads == 1)
+      timeOne = timeMs;
+    qInfo() << "FastMeanStd scaling: threads =" << numThreads
+            << "time =" << timeMs << "ms, speed up =" << timeOne / timeMs;
+
+    // result should not depend on number of threads
+    if (numThreads > 1) {
+      QVERIFY(memcmp(imageRef.getBits(), imageDst.getBits(),
+                     sizeof(float) * numPixels) == 0);
+    }
+  }
+  ThreadPool::instance().setNumWorkers(0);
+}
+
+void TestInterface::testThreadPool() {
+  ThreadPool& pool = ThreadPool::instance();
+  pool.setNumWorkers(4);
+  QVERIFY(pool.getNumWorkers() == 4);
+
+  // every item is processed exactly once
+  const int numItems = 1000;
+  std::vector<std::atomic<int>> counters(numItems);
+  for (auto& c : counters) {
+    c = 0;
+  }
+  pool.parallelFor(0, numItems, [&](int start, int end) {
+    for (int i = start; i < end; i++) {
+      counters[i]++;
+    }
+  });
+  bool allOnce = true;
+  for (auto& c : counters) {
+    allOnce = allOnce && (c == 1);
+  }
+  QVERIFY(allOnce);
+
+  // nested calls
+  std::atomic<int> sum(0);
+  pool.parallelFor(0, 16, [&](int start, int end) {
+    for (int i = start; i < end; i++) {
+      pool.parallelFor(0, 100, [&](int s, int e) {
+        sum += e - s;
+      });
+    }
+  });
+  QVERIFY(sum == 16 * 100);
+
+  // threaded gauss should match the single thread one
+  const int w = 96;
+  const int h = 80;
+  FImage imageSrc(w, h);
+  float *pixels = imageSrc.getBits();
+  for (int i = 0; i < w * h; i++) {
+    pixels[i] = (float)((i * 7) & 255);
+  }
+  FImage imageKernel = getGaussianKernel(7, 7, 0.4F);
+  FImage imageSmooth = imageSrc.getGaussSmooth(imageKernel);
+  FImage imageSmoothThr = imageSrc.getGaussSmoothViaThreads(imageKernel);
+  QVERIFY(memcmp(imageSmooth.getBits(), imageSmoothThr.getBits(),
+                 sizeof(float) * w * h) == 0);
+
+  pool.setNumWorkers(0);
+}
+
+void TestInterface::testGaussSeparable() {
+  const int w = 203;
+  const int h = 157;
+  FImage imageSrc(w, h);
+  const int numPixels = w * h;
+  float *pixels = imageSrc.getBits();
+  srand(0x6161);
+  for (int i = 0; i < numPixels; i++) {
+    pixels[i] = (float)(rand() & 255);
+  }
+
+  const int kernelSizes[] = {3, 7, 9, 15};
+  for (const int kernelSize : kernelSizes) {
+    FImage imageKernel = getGaussianKernel(kernelSize, kernelSize, 0.4F);
+    FImage imageKernel1D = getGaussianKernel1D(kernelSize, 0.4F);
+
+    Trace::clear();
+    Trace::setEnabled(true);
+    FImage imageRef = imageSrc.getGaussSmooth(imageKernel);
+    FImage imageSep = imageSrc.getGaussSmoothSeparable(imageKernel1D);
+    Trace::setEnabled(false);
+    const double timeRef = Trace::getTotalMs("gaussSmooth");
+    const double timeSep = Trace::getTotalMs("gaussSmoothSeparable");
+    qInfo() << "Gauss" << kernelSize << "x" << kernelSize
+            << ": 2d =" << timeRef << "ms, separable =" << timeSep << "ms";
+
+    const float *floatRef = imageRef.getBits();
+    const float *floatSep = imageSep.getBits();
+    float errMax = 0.0F;
+    for (int i = 0; i < numPixels; i++) {
+      const float err = fabsf(floatRef[i] - floatSep[i]);
+      errMax = (err > errMax) ? err : errMax;
+    }
+    QVERIFY(errMax < 1.0e-2F);
+  }
+
+  Trace::clear();
+
+  // image smaller than kernel: only border path is used
+  FImage imageTiny(3, 2);
+  pixels = imageTiny.getBits();
+  for (int i = 0; i < 6; i++) {
+    pixels[i] = (float)(i * 40);
+  }
+  FImage imageKernel = getGaussianKernel(9, 9, 0.4F);
+  FImage imageKernel1D = getGaussianKernel1D(9, 0.4F);
+  FImage imageTinyRef = imageTiny.getGaussSmooth(imageKernel);
+  FImage imageTinySep = imageTiny.getGaussSmoothSeparable(imageKernel1D);
+  for (int i = 0; i < 6; i++) {
+    QVERIFY(fabsf(imageTinyRef.getBits()[i] - imageTinySep.getBits()[i]) <
+            1.0e-3F);
+  }
+}
+
+void TestInterface::testGaussIir() {
+  const int w = 512;
+  const int h = 384;
+  FImage imageSrc(w, h);
+  float *pixels = imageSrc.getBits();
+  srand(0x7171);
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      // text-like: dark blocks on light background, plus noise
+      const bool dark = (((x / 23) + (y / 17)) & 3) == 0;
+      pixels[y * w + x] = (dark ? 40.0F : 220.0F) + (float)(rand() & 15);
+    }
+  }
+
+  // constant image stays constant
+  FImage imageConst(37, 29);
+  for (int i = 0; i < 37 * 29; i++) {
+    imageConst.getBits()[i] = 100.0F;
+  }
+  FImage imageConstSmooth = imageConst.getGaussSmoothIir(12.0F);
+  for (int i = 0; i < 37 * 29; i++) {
+    QVERIFY(fabsf(imageConstSmooth.getBits()[i] - 100.0F) < 1.0e-2F);
+  }
+
+  // IIR approximates FIR away from borders
+  const float sigmas[] = {1.0F, 2.0F, 3.0F, 4.0F, 6.0F,
+                          10.0F, 20.0F, 40.0F};
+  for (const float sigma : sigmas) {
+    FImage imageKernel1D = getGaussianKernel1DPx(sigma);
+    Trace::clear();
+    Trace::setEnabled(true);
+    FImage imageFir = imageSrc.getGaussSmoothSeparable(imageKernel1D);
+    FImage imageIir = imageSrc.getGaussSmoothIir(sigma);
+    Trace::setEnabled(false);
+    const double timeFir = Trace::getTotalMs("gaussSmoothSeparable");
+    const double timeIir = Trace::getTotalMs("gaussSmoothIir");
+    qInfo() << "Gauss sigma" << sigma << "px: fir =" << timeFir
+            << "ms, iir =" << timeIir << "ms";
+
+    const int border = imageKernel1D.width();
+    float errMax = 0.0F;
+    for (int y = border; y < h - border; y++) {
+      for (int x = border; x < w - border; x++) {
+        const float err = fabsf(imageFir.getBits()[y * w + x] -
+                                imageIir.getBits()[y * w + x]);
+        errMax = (err > errMax) ? err : errMax;
+      }
+    }
+    QVERIFY(errMax < 1.0F);
+  }
+
+  Trace::clear();
+
+  // auto selection uses IIR for large sigma
+  FImage imageAuto = imageSrc.getGaussSmoothSigma(cGaussIirSigmaMin * 2);
+  FImage imageIir = imageSrc.getGaussSmoothIir(cGaussIirSigmaMin * 2);
+  QVERIFY(memcmp(imageAuto.getBits(), imageIir.getBits(),
+                 sizeof(float) * w * h) == 0);
+}
+
+void TestInterface::testPixFromQImage() {
+  // odd width: partial last word of each line
+  const int w = 2047;
+  const int h = 1531;
+  QImage imageSrc(w, h, QImage::Format::Format_RGB32);
+  srand(0x8181);
+  for (int y = 0; y < h; y++) {
+    uint8_t *line = imageSrc.scanLine(y);
+    for (int x = 0; x < w * 4; x++) {
+      line[x] = (uint8_t)(rand() & 255);
+    }
+  }
+
+  // old path: BMP in memory, parsed back by leptonica
+  std::chrono::high_resolution_clock::time_point timeS, timeE;
+  timeS = std::chrono::high_resolution_clock::now();
+  Bmp bmpMem;
+  bmpMem.initFromQImage(imageSrc);
+  PIX *pixBmp = pixReadMem((l_uint8 *)bmpMem.bits(), bmpMem.sizeInBytes());
+  timeE = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double, std::milli> timeSpan = timeE - timeS;
+  const auto timeBmp = (float)timeSpan.count();
+
+  timeS = std::chrono::high_resolution_clock::now();
+  PIX *pixDirect = BmpQImageToPix(imageSrc);
+  timeE = std::chrono::high_resolution_clock::now();
+  timeSpan = timeE - timeS;
+  const auto timeDirect = (float)timeSpan.count();
+  qInfo() << "QImage to PIX: via bmp =" << timeBmp
+          << "ms, direct =" << timeDirect << "ms";
+
+  QVERIFY(pixBmp != nullptr);
+  QVERIFY(pixDirect != nullptr);
+  QVERIFY(pixGetDepth(pixDirect) == 8);
+  for (int y = 0; y < h; y++) {
+    const uint8_t *line = imageSrc.constScanLine(y);
+    for (int x = 0; x < w; x++) {
+      const uint32_t gray =
+          ((uint32_t)line[x * 4] + line[x * 4 + 1] + line[x * 4 + 2]) / 3;
+      l_uint32 valBmp = 0, valDirect = 0;
+      pixGetPixel(pixBmp, x, y, &valBmp);
+      pixGetPixel(pixDirect, x, y, &valDirect);
+      QVERIFY(valDirect == gray);
+      QVERIFY(valBmp == gray);
+    }
+  }
+  pixDestroy(&pixBmp);
+  pixDestroy(&pixDirect);
+
+  // gray image and float image
+  const int wGray = 37;
+  const int hGray = 5;
+  QImage imageGray(wGray, hGray, QImage::Format::Format_Grayscale8);
+  FImage imageFloat(wGray, hGray);
+  for (int y = 0; y < hGray; y++) {
+    for (int x = 0; x < wGray; x++) {
+      imageGray.scanLine(y)[x] = (uint8_t)(x * 7 + y);
+      imageFloat.getBits()[y * wGray + x] = (float)(x * 9 - 40) + 0.4F;
+    }
+  }
+  PIX *pixGray = BmpQImageToPix(imageGray);
+  PIX *pixFloat = BmpFImageToPix(imageFloat);
+  for (int y = 0; y < hGray; y++) {
+    for (int x = 0; x < wGray; x++) {
+      l_uint32 val = 0;
+      pixGetPixel(pixGray, x, y, &val);
+      QVERIFY(val == (uint32_t)(uint8_t)(x * 7 + y));
+      pixGetPixel(pixFloat, x, y, &val);
+      const int valExpected = std::min(std::max(x * 9 - 40, 0), 255);
+      QVERIFY(val == (uint32_t)valExpected);
+    }
+  }
+  pixDestroy(&pixGray);
+  pixDestroy(&pixFloat);
+}
+
+// pdf with pages 200 x 100 pt, all with the same content stream and page
+// resources
+static std::string makeTestPdf(const std::string& content,
+                               const std::string& resources,
+                               int numPages = 1) {
+  std::string kids;
+  for (int i = 0; i < numPages; i++) {
+    kids += std::to_string(4 + i) + " 0 R ";
+  }
+  std::vector<std::string> objects = {
+      "<< /Type /Catalog /Pages 2 0 R >>",
+      "<< /Type /Pages /Kids [" + kids + "] /Count " +
+          std::to_string(numPages) + " >>",
+      "<< /Length " + std::to_string(content.size()) + " >>\nstream\n" +
+          content + "endstream"};
+  for (int i = 0; i < numPages; i++) {
+    objects.push_back("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 200 100] "
+                      "/Contents 3 0 R " + resources + " >>");
+  }
+  std::string pdf = "%PDF-1.4\n";
+  std::vector<size_t> offsets;
+  for (size_t i = 0; i < objects.size(); i++) {
+    offsets.push_back(pdf.size());
+    pdf += std::to_string(i + 1) + " 0 obj\n" + objects[i] + "\nendobj\n";
+  }
+  const size_t offsetXref = pdf.size();
+  pdf += "xref\n0 " + std::to_string(objects.size() + 1) + "\n";
+  pdf += "0000000000 65535 f \n";
+  for (size_t offset : offsets) {
+    char line[32];
+    snprintf(line, sizeof(line), "%010zu 00000 n \n", offset);
+    pdf += line;
+  }
+  pdf += "trailer\n<< /Size " + std::to_string(objects.size() + 1) +
+         " /Root 1 0 R >>\nstartxref\n" + std::to_string(offsetXref) +
+         "\n%%EOF\n";
+  return pdf;
+}
+
+void TestInterface::testPdfRender() {
+  // black rectangle in the middle
+  const std::string pdf = makeTestPdf("0 g 50 25 100 50 re f\n", "");
+
+  fz_context *ctx = fz_new_context(nullptr, nullptr, FZ_STORE_DEFAULT);
+  fz_register_document_handlers(ctx);
+  fz_stream *stream = fz_open_memory(ctx, (const unsigned char *)pdf.data(),
+                                     pdf.size());
+  fz_document *doc = fz_open_document_with_stream(ctx, "pdf", stream);
+  const fz_matrix ctm = fz_scale(2.0F, 2.0F);
+
+  QImage imageGray = PdfRender::renderPage(ctx, doc, 0, ctm, true);
+  QImage imageColor = PdfRender::renderPage(ctx, doc, 0, ctm, false);
+  // missing page: null image, no exception
+  QImage imageMissing = PdfRender::renderPage(ctx, doc, 5, ctm, true);
+
+  fz_drop_document(ctx, doc);
+  fz_drop_stream(ctx, stream);
+  fz_drop_context(ctx);
+
+  QVERIFY(imageMissing.isNull());
+  QVERIFY(imageGray.format() == QImage::Format::Format_Grayscale8);
+  QVERIFY(imageColor.format() == QImage::Format::Format_RGB32);
+  QVERIFY((imageGray.width() == 400) && (imageGray.height() == 200));
+  QVERIFY((imageColor.width() == 400) && (imageColor.height() == 200));
+
+  // corner is white, center is black
+  QVERIFY(imageGray.constScanLine(5)[5] == 255);
+  QVERIFY(imageGray.constScanLine(100)[200] == 0);
+  QVERIFY(imageColor.pixel(5, 5) == qRgb(255, 255, 255));
+  QVERIFY(imageColor.pixel(200, 100) == qRgb(0, 0, 0));
+
+  // gray render gives the same float image as rgb render
+  FImage floatGray(imageGray);
+  FImage floatColor(imageColor);
+  QVERIFY(memcmp(floatGray.getBits(), floatColor.getBits(),
+                 sizeof(float) * 400 * 200) == 0);
+}
+
+void TestInterface::testBinImage() {
+  // width is not multiple of 64: partial last word of each line
+  const int w = 203;
+  const int h = 37;
+  FImage imageSrc(w, h);
+  const int numPixels = w * h;
+  float *pixels = imageSrc.getBits();
+  srand(0x5150);
+  for (int i = 0; i < numPixels; i++) {
+    pixels[i] = (float)(rand() & 255);
+  }
+
+  const int neibSize = 5;
+  const float factor = 0.25F;
+  FImage imageMean = imageSrc.getWindowedMean(neibSize);
+  FImage imageStd = imageSrc.getWindowedStdDev(imageMean, neibSize);
+  FImage imageThr = imageMean.getSauvolaThreshold(imageStd, factor);
+  FImage imageBina = imageSrc.applyThresholds(imageThr);
+  BinImage imageBin = imageSrc.applyThresholdsBin(imageThr);
+
+  // fused pass: float and bit destinations
+  IntegralImage integral(imageSrc);
+  FImage imageFused(w, h);
+  FastMeanStd::getSauvolaFused(imageSrc, integral, neibSize, factor,
+                               imageFused);
+  BinImage imageFusedBin(w, h);
+  FastMeanStd::getSauvolaFused(imageSrc, integral, neibSize, factor,
+                               imageFusedBin);
+
+  QVERIFY(imageBin.getBytesPerLine() == 32);
+  const float *floatBina = imageBina.getBits();
+  const float *floatFused = imageFused.getBits();
+  int64_t numBlack = 0;
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      const int i = y * w + x;
+      QVERIFY(imageBin.isWhite(x, y) == (floatBina[i] > 0.0F));
+      QVERIFY(imageFusedBin.isWhite(x, y) == (floatFused[i] > 0.0F));
+      numBlack += (floatBina[i] > 0.0F) ? 0 : 1;
+    }
+  }
+  QVERIFY(imageBin.getNumBlack() == numBlack);
+
+  // Format_Mono view over the same bits, back to float
+  QImage imageMono = imageBin.getQImage();
+  QVERIFY(imageMono.format() == QImage::Format::Format_Mono);
+  QVERIFY(imageMono.constBits() == imageBin.getBytes());
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      const QRgb colExpected = imageBin.isWhite(x, y)
+                                   ? qRgb(255, 255, 255)
+                                   : qRgb(0, 0, 0);
+      QVERIFY(imageMono.pixel(x, y) == colExpected);
+    }
+  }
+  FImage imageBack(imageMono);
+  QVERIFY(memcmp(imageBack.getBits(), floatBina, sizeof(float) * numPixels) ==
+          0);
+  // image keeps pixels alive after BinImage is gone
+  {
+    BinImage imageTmp(w, h);
+    imageTmp.setWhite(3, 4);
+    imageMono = imageTmp.getQImage();
+  }
+  QVERIFY(imageMono.pixel(3, 4) == qRgb(255, 255, 255));
+  QVERIFY(imageMono.pixel(4, 4) == qRgb(0, 0, 0));
+
+  // leptonica 1 bpp: 1 is black
+  PIX *pix = pixCreate(w, h, 1);
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      if (!imageBin.isWhite(x, y))
+        pixSetPixel(pix, x, y, 1);
+    }
+  }
+  BinImage imageFromPix = BmpPixToBinImage(pix);
+  pixDestroy(&pix);
+  for (int y = 0; y < h; y++) {
+    QVERIFY(memcmp(imageFromPix.getLine(y), imageBin.getLine(y),
+                   imageBin.getBytesPerLine()) == 0);
+  }
+
+  // diff of image with itself: no white pixels
+  FImage imageBinaCopy(imageBina);
+  BinImage imageDiff(w, h);
+  ImageDiff::getDiff(imageBina, imageBinaCopy, 0.2F, imageDiff);
+  QVERIFY(imageDiff.getNumBlack() == (int64_t)numPixels);
+}
+
+void TestInterface::testOcrPool() {
+  OcrPoolConfig config;
+  config.numEngines = 0;
+  config.engineMemoryMb = 40;
+  config.memoryBudgetMb = 0;
+  // one engine per core without memory limit
+  QVERIFY(OcrPool::getPoolSize(config, 8) == 8);
+  config.memoryBudgetMb = 200;
+  QVERIFY(OcrPool::getPoolSize(config, 8) == 5);
+  config.numEngines = 3;
+  QVERIFY(OcrPool::getPoolSize(config, 8) == 3);
+  // at least one engine, even over budget
+  config.memoryBudgetMb = 10;
+  QVERIFY(OcrPool::getPoolSize(config, 8) == 1);
+
+  // missing model: init fails, pages are not blocked
+  OcrPool pool;
+  config.dataPath = "data/no_models/";
+  config.numEngines = 2;
+  config.memoryBudgetMb = 0;
+  QVERIFY(!pool.init(config));
+  QVERIFY(pool.getNumEngines() == 0);
+  std::vector<BinImage> pages = {BinImage(64, 32), BinImage(32, 16)};
+  std::vector<std::vector<TextBox>> words = pool.recognizePages(pages);
+  QVERIFY(words.size() == pages.size());
+  QVERIFY(words[0].empty() && words[1].empty());
+}
+
+void TestInterface::testPageLayout() {
+  const int w = 603;
+  const int h = 401;
+  BinImage image(w, h);
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      image.setWhite(x, y);
+    }
+  }
+  QVERIFY(image.getNumBlack() == 0);
+  QVERIFY(PageLayout::getTextBlocks(image).empty());
+
+  // title, then two columns, right column has two paragraphs
+  const std::vector<QRect> rectsText = {
+      QRect(40, 20, 500, 30), QRect(40, 100, 230, 250),
+      QRect(330, 100, 230, 120), QRect(330, 260, 230, 90)};
+  for (const QRect& rc : rectsText) {
+    for (int y = rc.top(); y <= rc.bottom(); y++) {
+      uint64_t *line = image.getLine(y);
+      for (int x = rc.left(); x <= rc.right(); x++) {
+        line[x >> 6] &= ~BinImage::getMask(x);
+      }
+    }
+  }
+  PageLayoutParams params;
+  const std::vector<QRect> blocks = PageLayout::getTextBlocks(image, params);
+  // blocks are found in reading order, with margins
+  QVERIFY(blocks.size() == rectsText.size());
+  for (size_t i = 0; i < blocks.size(); i++) {
+    const QRect rcExpected = rectsText[i].adjusted(
+        -params.margin, -params.margin, params.margin, params.margin);
+    QVERIFY(blocks[i] == rcExpected);
+  }
+}
+
+void TestInterface::testBinImageToPix() {
+  // 2 leptonica words in the last BinImage word, one of them padding only
+  const int w = 150;
+  const int h = 23;
+  BinImage imageBin(w, h);
+  srand(0x1bb);
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      if (rand() & 1)
+        imageBin.setWhite(x, y);
+    }
+  }
+
+  PIX *pix = BmpBinImageToPix(imageBin);
+  QVERIFY(pix != nullptr);
+  QVERIFY(pixGetDepth(pix) == 1);
+  QVERIFY(pixGetWidth(pix) == w);
+  QVERIFY(pixGetHeight(pix) == h);
+  QVERIFY(pixGetWpl(pix) == 5);
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      l_uint32 val = 0;
+      pixGetPixel(pix, x, y, &val);
+      QVERIFY((val == 0) == imageBin.isWhite(x, y));
+    }
+  }
+  // padding bits are white for leptonica too
+  l_int32 numBlack = 0;
+  pixCountPixels(pix, &numBlack, nullptr);
+  QVERIFY(numBlack == (l_int32)imageBin.getNumBlack());
+  const l_uint32 *lineLast = pixGetData(pix) + (size_t)(h - 1) * 5;
+  QVERIFY((lineLast[4] & ((1U << (32 - (w - 128))) - 1)) == 0);
+
+  // back to BinImage: same bits
+  BinImage imageBack = BmpPixToBinImage(pix);
+  pixDestroy(&pix);
+  for (int y = 0; y < h; y++) {
+    QVERIFY(memcmp(imageBack.getLine(y), imageBin.getLine(y),
+                   imageBin.getBytesPerLine()) == 0);
+  }
+
+  // shared page pix is destroyed with its last owner
+  SharedPix pixShared = OcrEngine::getPix(imageBin);
+  QVERIFY(pixShared);
+  SharedPix pixBlock = pixShared;
+  pixShared.reset();
+  QVERIFY(pixGetWidth(pixBlock.get()) == w);
+}
+
+void TestInterface::testSpscQueue() {
+  SpscQueue<int> queue(5);
+  QVERIFY(queue.getCapacity() == 8);
+  QVERIFY(queue.isEmpty());
+  for (int i = 0; i < 8; i++) {
+    QVERIFY(queue.push(int(i)));
+  }
+  QVERIFY(!queue.push(8));
+  int val = -1;
+  QVERIFY(queue.pop(val) && (val == 0));
+  QVERIFY(queue.push(8));
+
+  // producer and consumer threads: every item once, in push order
+  SpscQueue<std::vector<int>> queueVec(16);
+  const int numItems = 20000;
+  std::thread producer([&queueVec] {
+    for (int i = 0; i < numItems; i++) {
+      std::vector<int> item(1 + (i & 3), i);
+      while (!queueVec.push(std::move(item)))
+        std::this_thread::yield();
+    }
+  });
+  int numPopped = 0;
+  bool okOrder = true;
+  while (numPopped < numItems) {
+    std::vector<int> item;
+    if (!queueVec.pop(item)) {
+      std::this_thread::yield();
+      continue;
+    }
+    okOrder = okOrder && (item.size() == (size_t)(1 + (numPopped & 3))) &&
+              (item.back() == numPopped);
+    numPopped++;
+  }
+  producer.join();
+  QVERIFY(okOrder);
+  QVERIFY(queueVec.isEmpty());
+}
+
+void TestInterface::testRecogWorker() {
+  // pool without engines: pages are "recognized" at once with no words
+  OcrPool pool;
+  RecogWorker worker;
+  worker.start(&pool);
+
+  // first job holds the worker until other jobs are queued
+  auto started = std::make_shared<std::promise<void>>();
+  std::future<void> isStarted = started->get_future();
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  const int w = 64;
+  const int h = 32;
+  QImage image(w, h, QImage::Format::Format_Grayscale8);
+  image.fill(255);
+  RecogJob jobFirst;
+  jobFirst.image = image;
+  jobFirst.binarize = [started, released](const QImage& img) {
+    started->set_value();
+    released.wait();
+    BinImage imageBin(img.width(), img.height());
+    return imageBin;
+  };
+  const int idFirst = worker.submit(jobFirst);
+  isStarted.wait();
+
+  RecogJob jobNormal;
+  jobNormal.image = image;
+  const int idNormal = worker.submit(jobNormal);
+  RecogJob jobHigh;
+  jobHigh.image = image;
+  jobHigh.priority = RECOG_PRIORITY_HIGH;
+  const int idHigh = worker.submit(jobHigh);
+  RecogJob jobStale;
+  jobStale.image = image;
+  const int idStale = worker.submit(jobStale);
+  worker.cancel(idStale);
+  release.set_value();
+
+  // events of every job: IMAGE, DONE or only CANCELLED
+  std::vector<int> idsImage;
+  std::vector<int> idsDone;
+  std::vector<int> idsCancelled;
+  const auto timeEnd =
+      std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while ((idsDone.size() + idsCancelled.size() < 4) &&
+         (std::chrono::steady_clock::now() < timeEnd)) {
+    RecogEvent evt;
+    if (!worker.popEvent(evt)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+    if (evt.type == RecogEventType::IMAGE) {
+      QVERIFY(evt.image.width() == w);
+      idsImage.push_back(evt.jobId);
+    }
+    if (evt.type == RecogEventType::DONE)
+      idsDone.push_back(evt.jobId);
+    if (evt.type == RecogEventType::CANCELLED)
+      idsCancelled.push_back(evt.jobId);
+  }
+  worker.stop();
+
+  QVERIFY(idsCancelled.size() == 1);
+  QVERIFY(idsCancelled[0] == idStale);
+  // high priority job overtakes the earlier normal one
+  QVERIFY(idsImage.size() == 3);
+  QVERIFY(idsImage[0] == idFirst);
+  QVERIFY(idsImage[1] == idHigh);
+  QVERIFY(idsImage[2] == idNormal);
+  QVERIFY(idsDone == idsImage);
+}
+
+void TestInterface::testPdfText() {
+  // base 14 font: every glyph has unicode
+  const std::string pdf = makeTestPdf(
+      "BT /F1 10 Tf 10 70 Td (Born digital page has) Tj "
+      "0 -20 Td (reliable text layer words) Tj ET\n",
+      "/Resources << /Font << /F1 << /Type /Font /Subtype /Type1 "
+      "/BaseFont /Helvetica >> >> >>");
+  // no text at all: scanned page
+  const std::string pdfScan = makeTestPdf("0 g 50 25 100 50 re f\n", "");
+
+  fz_context *ctx = fz_new_context(nullptr, nullptr, FZ_STORE_DEFAULT);
+  fz_register_document_handlers(ctx);
+  const fz_matrix ctm = fz_scale(2.0F, 2.0F);
+  PdfTextLayer layer;
+  PdfTextLayer layerScan;
+  bool ok = false;
+  bool okScan = false;
+  QImage image;
+  {
+    fz_stream *stream = fz_open_memory(
+        ctx, (const unsigned char *)pdf.data(), pdf.size());
+    fz_document *doc = fz_open_document_with_stream(ctx, "pdf", stream);
+    ok = PdfText::getTextLayer(ctx, doc, 0, ctm, layer);
+    image = PdfRender::renderPage(ctx, doc, 0, ctm, true);
+    fz_drop_document(ctx, doc);
+    fz_drop_stream(ctx, stream);
+  }
+  {
+    fz_stream *stream = fz_open_memory(
+        ctx, (const unsigned char *)pdfScan.data(), pdfScan.size());
+    fz_document *doc = fz_open_document_with_stream(ctx, "pdf", stream);
+    okScan = PdfText::getTextLayer(ctx, doc, 0, ctm, layerScan);
+    fz_drop_document(ctx, doc);
+    fz_drop_stream(ctx, stream);
+  }
+  fz_drop_context(ctx);
+
+  QVERIFY(ok && okScan);
+  QVERIFY(layer.words.size() == 8);
+  QVERIFY(layer.words[0].m_text == QString("Born"));
+  QVERIFY(layer.words[7].m_text == QString("words"));
+  QVERIFY(layer.numChars == 40);
+  QVERIFY(layer.numBadChars == 0);
+  QVERIFY(layer.isReliable());
+  // boxes are in rendered image pixels: first line is above the second
+  const QRect rcImage(0, 0, image.width(), image.height());
+  for (const TextBox &tb : layer.words) {
+    QVERIFY(rcImage.contains(tb.m_rect));
+  }
+  QVERIFY(layer.words[0].m_rect.left() >= 18);
+  QVERIFY(layer.words[0].m_rect.left() <= 22);
+  QVERIFY(layer.words[0].m_rect.bottom() < layer.words[4].m_rect.top());
+
+  QVERIFY(layerScan.words.empty());
+  QVERIFY(!layerScan.isReliable());
+  QVERIFY(!PdfText::useTextLayer(TextLayerPolicy::AUTO, layerScan));
+  QVERIFY(PdfText::useTextLayer(TextLayerPolicy::TEXT_LAYER_ONLY, layerScan));
+  QVERIFY(PdfText::useTextLayer(TextLayerPolicy::AUTO, layer));
+  QVERIFY(!PdfText::useTextLayer(TextLayerPolicy::ALWAYS_OCR, layer));
+}
+
+void TestInterface::testPageCache() {
+  // 100 x 100 gray pages: 10000 bytes each, budget for 3 pages
+  PageCache cache(30000);
+  QImage image(100, 100, QImage::Format::Format_Grayscale8);
+  for (int i = 0; i < 3; i++) {
+    PageKey key;
+    key.docId = 1;
+    key.pageIndex = i;
+    cache.put(key, image);
+  }
+  QVERIFY(cache.getNumPages() == 3);
+  QVERIFY(cache.getSizeBytes() == 30000);
+
+  // page 0 is used: page 1 becomes the oldest and is evicted
+  PageKey key0;
+  key0.docId = 1;
+  key0.pageIndex = 0;
+  QImage imageHit;
+  QVERIFY(cache.get(key0, imageHit));
+  QVERIFY(imageHit.constBits() == image.constBits());
+  PageKey key3 = key0;
+  key3.pageIndex = 3;
+  cache.put(key3, image);
+  QVERIFY(cache.getNumPages() == 3);
+  PageKey key1 = key0;
+  key1.pageIndex = 1;
+  QVERIFY(!cache.contains(key1));
+  QVERIFY(cache.contains(key0));
+  QVERIFY(cache.contains(key3));
+
+  // other scale is other page
+  PageKey key0Zoom = key0;
+  key0Zoom.scale = 2.0F;
+  QVERIFY(!cache.contains(key0Zoom));
+
+  // larger than budget: not stored
+  QImage imageHuge(200, 200, QImage::Format::Format_Grayscale8);
+  cache.put(key0Zoom, imageHuge);
+  QVERIFY(!cache.contains(key0Zoom));
+
+  cache.removeDocument(1);
+  QVERIFY(cache.getNumPages() == 0);
+  QVERIFY(cache.getSizeBytes() == 0);
+}
+
+void TestInterface::testPdfPages() {
+  const std::string pdf = makeTestPdf("0 g 50 25 100 50 re f\n", "", 3);
+  FzLocks locks;
+  fz_context *ctx = locks.newContext();
+  QVERIFY(ctx != nullptr);
+  fz_stream *stream = fz_open_memory(ctx, (const unsigned char *)pdf.data(),
+                                     pdf.size());
+  fz_document *doc = fz_open_document_with_stream(ctx, "pdf", stream);
+  const int numPages = fz_count_pages(ctx, doc);
+
+  bool okStart = false;
+  QImage page0;
+  QImage page0Again;
+  int numMissesFirst = 0;
+  bool isPrefetched = false;
+  {
+    PdfPages pages;
+    okStart = pages.start(ctx, 16 * 1024 * 1024);
+    pages.setDocument(doc, numPages);
+    page0 = pages.getPage(0, 2.0F, 0.0F);
+    numMissesFirst = pages.getNumMisses();
+    page0Again = pages.getPage(0, 2.0F, 0.0F);
+
+    // page 1 is rendered in background after page 0 request
+    PageKey key1;
+    key1.docId = 1;
+    key1.pageIndex = 1;
+    key1.scale = 2.0F;
+    for (int i = 0; (i < 500) && !isPrefetched; i++) {
+      isPrefetched = pages.getCache()->contains(key1);
+      if (!isPrefetched)
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    QImage page1 = pages.getPage(1, 2.0F, 0.0F);
+    QVERIFY(!page1.isNull());
+    QVERIFY(pages.getNumMisses() == 1);
+    QVERIFY(pages.getNumHits() == 2);
+    pages.stop();
+    pages.setDocument(nullptr, 0);
+  }
+  fz_drop_document(ctx, doc);
+  fz_drop_stream(ctx, stream);
+  fz_drop_context(ctx);
+
+  QVERIFY(okStart);
+  QVERIFY(numPages == 3);
+  QVERIFY(numMissesFirst == 1);
+  QVERIFY(page0.width() == 400);
+  QVERIFY(page0.format() == QImage::Format::Format_Grayscale8);
+  // hit: the same pixels, no second render
+  QVERIFY(page0Again.constBits() == page0.constBits());
+  QVERIFY(isPrefetched);
+}
+
+void TestInterface::testPdfRenderBands() {
+  // slanted edges: anti-aliased pixels on band borders
+  const std::string pdf = makeTestPdf(
+      "0 g 20 10 m 180 90 l 30 80 l f 0.5 g 100 5 90 40 re f\n", "", 3);
+  FzLocks locks;
+  fz_context *ctx = locks.newContext();
+  fz_stream *stream = fz_open_memory(ctx, (const unsigned char *)pdf.data(),
+                                     pdf.size());
+  fz_document *doc = fz_open_document_with_stream(ctx, "pdf", stream);
+  const fz_matrix ctm = PdfRender::getMatrix(4.0F, 0.0F);
+
+  QImage imageRef = PdfRender::renderPage(ctx, doc, 1, ctm, true);
+  fz_display_list *list = PdfRender::newDisplayList(ctx, doc, 1);
+  QImage imageBands = PdfRender::renderDisplayList(ctx, list, ctm, true, 4);
+  QImage imageBandsColor =
+      PdfRender::renderDisplayList(ctx, list, ctm, false, 3);
+  QImage imageColorRef = PdfRender::renderPage(ctx, doc, 1, ctm, false);
+  fz_drop_display_list(ctx, list);
+  std::vector<QImage> pages =
+      PdfRender::renderPages(ctx, doc, {2, 0, 1}, ctm, true);
+  // missing page: null list, null image
+  fz_display_list *listMissing = PdfRender::newDisplayList(ctx, doc, 7);
+
+  fz_drop_document(ctx, doc);
+  fz_drop_stream(ctx, stream);
+  fz_drop_context(ctx);
+
+  QVERIFY(listMissing == nullptr);
+  QVERIFY(imageRef.width() == 800);
+  QVERIFY(imageRef.height() == 400);
+  QVERIFY(imageBands.size() == imageRef.size());
+  QVERIFY(imageBands.format() == QImage::Format::Format_Grayscale8);
+  QVERIFY(pages.size() == 3);
+  for (int y = 0; y < imageRef.height(); y++) {
+    const int bytes = imageRef.width();
+    QVERIFY(memcmp(imageBands.constScanLine(y), imageRef.constScanLine(y),
+                   bytes) == 0);
+    QVERIFY(memcmp(imageBandsColor.constScanLine(y),
+                   imageColorRef.constScanLine(y), bytes * 4) == 0);
+    for (const QImage &page : pages) {
+      QVERIFY(memcmp(page.constScanLine(y), imageRef.constScanLine(y),
+                     bytes) == 0);
+    }
+  }
+}
+
+// white binary image
+static BinImage makeWhiteBinImage(int w, int h) {
+  BinImage image(w, h);
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      image.setWhite(x, y);
+    }
+  }
+  return image;
+}
+
+static void fillBlackRect(BinImage& image, int x0, int y0, int w, int h) {
+  for (int y = y0; y < y0 + h; y++) {
+    uint64_t* line = image.getLine(y);
+    for (int x = x0; x < x0 + w; x++) {
+      line[x >> 6] &= ~BinImage::getMask(x);
+    }
+  }
+}
+
+void TestInterface::testTextScale() {
+  // "text lines": lowercase letters 5 x 7, every 5th letter is capital
+  // or ascender 5 x 10. Plus long rule and noise dot
+  const int w = 600;
+  const int h = 400;
+  BinImage page = makeWhiteBinImage(w, h);
+  for (int line = 0; line < 6; line++) {
+    const int yBase = 40 + line * 40;
+    for (int k = 0; k < 40; k++) {
+      const int hLetter = ((k % 5) == 0) ? 10 : 7;
+      fillBlackRect(page, 20 + k * 14, yBase - hLetter, 5, hLetter);
+    }
+  }
+  fillBlackRect(page, 10, 300, 580, 2);
+  fillBlackRect(page, 500, 350, 1, 1);
+
+  QVERIFY(TextScale::estimateXHeight(page, 20) == 7);
+  AutoScaleParams params;
+  params.probeScale = 1.5F;
+  params.targetCapHeight = 30.0F;
+  // 1.5 * 30 * 0.7 / 7 = 4.5
+  QVERIFY(std::fabs(TextScale::getScale(page, params) - 4.5F) < 0.01F);
+  params.maxScale = 3.0F;
+  QVERIFY(TextScale::getScale(page, params) == 3.0F);
+
+  // no text: unknown scale
+  const BinImage pageEmpty = makeWhiteBinImage(w, h);
+  QVERIFY(TextScale::estimateXHeight(pageEmpty, 20) == 0);
+  QVERIFY(TextScale::getScale(pageEmpty, AutoScaleParams()) == 0.0F);
+}
+
+void TestInterface::testRegionRecog() {
+  const std::string pdf = makeTestPdf(
+      "0 g 20 10 m 180 90 l 30 80 l f 0.5 g 100 5 90 40 re f\n", "");
+  fz_context *ctx = fz_new_context(nullptr, nullptr, FZ_STORE_DEFAULT);
+  fz_register_document_handlers(ctx);
+  fz_stream *stream = fz_open_memory(ctx, (const unsigned char *)pdf.data(),
+                                     pdf.size());
+  fz_document *doc = fz_open_document_with_stream(ctx, "pdf", stream);
+  const fz_matrix ctm = PdfRender::getMatrix(4.0F, 0.0F);
+  const QRect clip(120, 60, 200, 100);
+  QImage imageRef = PdfRender::renderPage(ctx, doc, 0, ctm, true);
+  QImage imageClip = PdfRender::renderClip(ctx, doc, 0, ctm, clip, true);
+  // partially and fully outside of page
+  QImage imageBorder =
+      PdfRender::renderClip(ctx, doc, 0, ctm, QRect(700, 300, 200, 200), true);
+  QImage imageOutside =
+      PdfRender::renderClip(ctx, doc, 0, ctm, QRect(900, 0, 50, 50), true);
+  fz_drop_document(ctx, doc);
+  fz_drop_stream(ctx, stream);
+  fz_drop_context(ctx);
+
+  QVERIFY(imageClip.width() == clip.width());
+  QVERIFY(imageClip.height() == clip.height());
+  for (int y = 0; y < clip.height(); y++) {
+    QVERIFY(memcmp(imageClip.constScanLine(y),
+                   imageRef.constScanLine(clip.top() + y) + clip.left(),
+                   clip.width()) == 0);
+  }
+  QVERIFY(imageBorder.width() == 100);
+  QVERIFY(imageBorder.height() == 100);
+  QVERIFY(imageOutside.isNull());
+
+  // words of upscaled region replace words inside selection
+  RecognitionResult res;
+  res.m_image = imageRef;
+  // selection is re-processed from the image the result is made from
+  QVERIFY(!res.hasSource());
+  res.m_imageSource = imageRef;
+  QVERIFY(res.hasSource());
+  TextBox tbKeep;
+  tbKeep.m_rect = QRect(10, 10, 40, 20);
+  tbKeep.m_text = "keep";
+  TextBox tbOld;
+  tbOld.m_rect = QRect(130, 70, 40, 20);
+  tbOld.m_text = "old";
+  res.m_textBoxes = {tbKeep, tbOld};
+
+  QVector<QPoint> lasso = {QPoint(60, 30), QPoint(160, 30), QPoint(160, 80),
+                           QPoint(60, 80)};
+  QVERIFY(res.markSelectedByPoly(lasso, 0.5F));
+  QVERIFY(res.m_rectSelected == QRect(120, 60, 201, 101));
+
+  TextBox tbNew;
+  tbNew.m_rect = QRect(20, 20, 80, 40);
+  tbNew.m_text = "new";
+  QVERIFY(res.spliceRegion(res.m_rectSelected, 2.0F, {tbNew}) == 1);
+  QVERIFY(res.m_textBoxes.size() == 2);
+  QVERIFY(res.m_textBoxes[0].m_text == "keep");
+  QVERIFY(res.m_textBoxes[1].m_text == "new");
+  QVERIFY(res.m_textBoxes[1].m_rect == QRect(130, 70, 40, 20));
+
+  // region without words (nothing recognized): old words are kept
+  const std::vector<TextBox> boxesBefore = res.m_textBoxes;
+  QVERIFY(res.spliceRegion(res.m_rectSelected, 2.0F, {}) == 0);
+  QVERIFY(res.m_textBoxes.size() == boxesBefore.size());
+  for (size_t i = 0; i < boxesBefore.size(); i++) {
+    QVERIFY(res.m_textBoxes[i].m_text == boxesBefore[i].m_text);
+    QVERIFY(res.m_textBoxes[i].m_rect == boxesBefore[i].m_rect);
+  }
+
+  // one text line rendered at region scale: its words are taller than 1/8
+  // of the clip, but not of the page
+  const std::string pdfLine = makeTestPdf(
+      "BT /F1 16 Tf 20 45 Td (1234 5678) Tj ET\n",
+      "/Resources << /Font << /F1 << /Type /Font /Subtype /Type1 "
+      "/BaseFont /Helvetica >> >> >>");
+  ctx = fz_new_context(nullptr, nullptr, FZ_STORE_DEFAULT);
+  fz_register_document_handlers(ctx);
+  stream = fz_open_memory(ctx, (const unsigned char *)pdfLine.data(),
+                          pdfLine.size());
+  doc = fz_open_document_with_stream(ctx, "pdf", stream);
+  const QRect clipLine(40, 140, 600, 120);
+  const QImage imageLine =
+      PdfRender::renderClip(ctx, doc, 0, ctm, clipLine, true);
+  const int hPage = PdfRender::renderPage(ctx, doc, 0, ctm, true).height();
+  fz_drop_document(ctx, doc);
+  fz_drop_stream(ctx, stream);
+  QVERIFY(imageLine.height() == clipLine.height());
+
+  set_leptonica_mem(ctx);
+  std::vector<TextBox> wordsLine;
+  bool isInit = false;
+  {
+    OcrEngine engine;
+    isInit = engine.init("data/models/", "rus");
+    if (isInit)
+      wordsLine = engine.recognize(imageLine, nullptr, hPage);
+  }
+  clear_leptonica_mem(ctx);
+  fz_drop_context(ctx);
+  if (!isInit)
+    QSKIP("trained model is not available");
+  QVERIFY(!wordsLine.empty());
+  for (const TextBox& tb : wordsLine) {
+    QVERIFY(tb.m_rect.height() > clipLine.height() / 8);
+    QVERIFY(imageLine.rect().contains(tb.m_rect));
+  }
+  const QString textLine = wordsLine.front().m_text;
+  QVERIFY(res.spliceRegion(res.m_rectSelected, 2.0F, wordsLine) ==
+          (int)wordsLine.size());
+  QVERIFY(res.m_textBoxes.size() == 1 + wordsLine.size());
+  QVERIFY(res.m_textBoxes[0].m_text == "keep");
+  QVERIFY(res.m_textBoxes[1].m_text == textLine);
+}
+
+static void writeTestFile(const std::string& fileName,
+                          const std::string& data) {
+  std::ofstream file(fileName, std::ios::binary);
+  file.write(data.data(), (std::streamsize)data.size());
+}
+
+void TestInterface::testBatchPipeline() {
+  // bounded queue: producer waits for consumer, close releases both
+  BoundedQueue<int> queue(2);
+  std::thread producer([&queue] {
+    for (int i = 0; i < 100; i++) {
+      queue.push(std::move(i));
+    }
+    queue.close();
+  });
+  int sum = 0;
+  int value = 0;
+  while (queue.pop(value)) {
+    QVERIFY(queue.getSize() <= queue.getCapacity());
+    sum += value;
+  }
+  producer.join();
+  QVERIFY(sum == 99 * 100 / 2);
+  int valueClosed = 7;
+  QVERIFY(!queue.push(std::move(valueClosed)));
+
+  // scanned pdf (3 pages), born-digital pdf, image and broken file
+  const std::string dir = QDir::tempPath().toStdString() + "/imb_batch";
+  QDir().mkpath(QString::fromStdString(dir));
+  writeTestFile(dir + "/a_scan.pdf",
+                makeTestPdf("0 g 50 25 100 50 re f\n", "", 3));
+  writeTestFile(dir + "/b_text.pdf", makeTestPdf(
+      "BT /F1 10 Tf 10 70 Td (Born digital page has) Tj "
+      "0 -20 Td (reliable text layer words) Tj ET\n",
+      "/Resources << /Font << /F1 << /Type /Font /Subtype /Type1 "
+      "/BaseFont /Helvetica >> >> >>"));
+  QImage image(64, 48, QImage::Format::Format_RGB32);
+  image.fill(Qt::white);
+  image.save(QString::fromStdString(dir + "/c_image.png"));
+  writeTestFile(dir + "/d_broken.pdf", "not a pdf");
+  writeTestFile(dir + "/e_notes.txt", "skipped");
+
+  const std::vector<std::string> files =
+      BatchPipeline::getSourceFiles({dir});
+  QVERIFY(files.size() == 4);
+
+  FzLocks locks;
+  fz_context *ctx = locks.newContext();
+  // pool without engines: pages come without words
+  OcrPool pool;
+  BatchConfig config;
+  config.scale = 2.0F;
+  config.numBinarizeThreads = 2;
+  config.queueCapacity = 1;
+  BatchPipeline pipeline(config, ctx, &pool);
+  std::vector<BatchPage> pages;
+  const BatchStats stats = pipeline.run(files, [&pages](BatchPage &page) {
+    pages.push_back(std::move(page));
+  });
+  // invalid queue capacity and threads are clamped, pages still pass
+  BatchConfig configInvalid = config;
+  configInvalid.queueCapacity = -2;
+  configInvalid.numBinarizeThreads = 0;
+  BatchPipeline pipelineInvalid(configInvalid, ctx, &pool);
+  int numPagesInvalid = 0;
+  pipelineInvalid.run(files, [&numPagesInvalid](BatchPage &) {
+    numPagesInvalid++;
+  });
+  QVERIFY(numPagesInvalid == 6);
+  fz_drop_context(ctx);
+  QDir(QString::fromStdString(dir)).removeRecursively();
+
+  QVERIFY(pages.size() == 6);
+  QVERIFY(stats.numPages == 6);
+  QVERIFY(stats.numFailed == 1);
+  QVERIFY(stats.numTextLayer == 1);
+  for (int i = 0; i < 6; i++) {
+    QVERIFY(pages[i].index == i);
+  }
+  for (int i = 0; i < 3; i++) {
+    QVERIFY(pages[i].ok && !pages[i].isTextLayer);
+    QVERIFY(pages[i].pageIndex == i);
+    QVERIFY(pages[i].size == QSize(400, 200));
+    // page images are dropped after OCR without keepImage
+    QVERIFY(pages[i].imageBin.isNull());
+    QVERIFY(pages[i].image.isNull());
+  }
+  QVERIFY(pages[3].isTextLayer);
+  QVERIFY(pages[3].words.size() == 8);
+  QVERIFY(pages[3].size == QSize(400, 200));
+  QVERIFY(pages[4].ok && (pages[4].size == QSize(64, 48)));
+  QVERIFY(!pages[5].ok);
+  for (int stage = 0; stage < BATCH_NUM_STAGES; stage++) {
+    QVERIFY(stats.stages[stage].numPages == 6);
+    QVERIFY(stats.getUtilization(stage) <= 1.0);
+  }
+}
+
+void TestInterface::testOcrServer() {
+  // request parameters override defaults, invalid ones are rejected
+  BatchConfig configDefault;
+  BatchConfig config;
+  QString error;
+  QJsonObject request;
+  request["algorithm"] = "leptonica";
+  request["range"] = 9;
+  request["scale"] = "auto";
+  request["text"] = "ocr";
+  QVERIFY(OcrServer::getBatchConfig(request, configDefault, config, error));
+  QVERIFY(config.algorithm == AlgirithmBinType::ALGORITHM_LEPTONICA);
+  QVERIFY(config.neibSize == 9);
+  QVERIFY(config.scale == 0.0F);
+  QVERIFY(config.textLayerPolicy == TextLayerPolicy::ALWAYS_OCR);
+  QVERIFY(config.factor == configDefault.factor);
+  request["algorithm"] = "otsu";
+  QVERIFY(!OcrServer::getBatchConfig(request, configDefault, config, error));
+  request.remove("algorithm");
+  request["factor"] = -1.0;
+  QVERIFY(!OcrServer::getBatchConfig(request, configDefault, config, error));
+
+  // page reply is one JSON line
+  BatchPage page;
+  page.fileName = "doc.pdf";
+  page.pageIndex = 2;
+  page.size = QSize(300, 200);
+  TextBox box;
+  box.m_rect = QRect(10, 20, 30, 40);
+  box.m_text = "word";
+  box.m_confidence = 90.0F;
+  page.words.push_back(box);
+  const QByteArray line = OcrServer::getPageReply(5, page);
+  QVERIFY(line.endsWith('\n') && (line.count('\n') == 1));
+  const QJsonObject reply = QJsonDocument::fromJson(line).object();
+  QVERIFY(reply.value("id").toInt() == 5);
+  QVERIFY(reply.value("page").toInt() == 2);
+  QVERIFY(reply.value("width").toInt() == 300);
+  const QJsonArray words = reply.value("words").toArray();
+  QVERIFY(words.size() == 1);
+  const QJsonObject word = words[0].toObject();
+  QVERIFY(word.value("text").toString() == "word");
+  QVERIFY(word.value("box").toArray()[3].toInt() == 40);
+  // the same page object as JSON Lines results
+  QJsonObject replyPage = reply;
+  replyPage.remove("id");
+  QVERIFY(replyPage == ResultWriter::getPageJson(page));
+
+  // resident server: pages then job end, errors for bad requests
+  const std::string dir = QDir::tempPath().toStdString() + "/imb_server";
+  QDir().mkpath(QString::fromStdString(dir));
+  const std::string fileName = dir + "/scan.pdf";
+  writeTestFile(fileName, makeTestPdf("0 g 50 25 100 50 re f\n", "", 2));
+
+  FzLocks locks;
+  fz_context *ctx = locks.newContext();
+  OcrPool pool;
+  std::vector<QJsonObject> replies;
+  {
+    OcrServer server(ctx, &pool);
+    OcrServerConfig configServer;
+    configServer.name = "imb-ocr-test";
+    QVERIFY(server.start(configServer));
+
+    QLocalSocket socket;
+    socket.connectToServer("imb-ocr-test");
+    QVERIFY(socket.waitForConnected(1000));
+    socket.write("{\"id\": 1, \"file\": \"" +
+                 QByteArray(fileName.c_str()) + "\", \"scale\": 1}\n");
+    socket.write("{\"id\": 2, \"algorithm\": \"otsu\"}\n");
+    socket.write("not json\n");
+    socket.flush();
+    // server lives on this thread: replies come while events are processed
+    for (int i = 0; (i < 500) && (replies.size() < 5); i++) {
+      QTest::qWait(10);
+      while (socket.canReadLine()) {
+        replies.push_back(
+            QJsonDocument::fromJson(socket.readLine()).object());
+      }
+    }
+    server.stop();
+  }
+  fz_drop_context(ctx);
+  QDir(QString::fromStdString(dir)).removeRecursively();
+
+  QVERIFY(replies.size() == 5);
+  int numPages = 0;
+  int numErrors = 0;
+  bool isDone = false;
+  for (const QJsonObject &rep : replies) {
+    if (rep.contains("error")) {
+      numErrors++;
+    } else if (rep.value("done").toBool()) {
+      // job end comes after its pages
+      QVERIFY(numPages == 2);
+      QVERIFY(rep.value("pages").toInt() == 2);
+      isDone = true;
+    } else {
+      QVERIFY(rep.value("id").toInt() == 1);
+      QVERIFY(rep.value("page").toInt() == numPages);
+      QVERIFY(rep.value("width").toInt() == 200);
+      numPages++;
+    }
+  }
+  QVERIFY(isDone && (numPages == 2) && (numErrors == 2));
+}
+
+void TestInterface::testResultWriter() {
+  // two lines of words, the second word needs escaping
+  BatchPage page;
+  page.fileName = "a&b.pdf";
+  page.size = QSize(400, 200);
+  const char* const texts[] = {"one", "<two>", "three", "four"};
+  const QRect rects[] = {QRect(10, 10, 40, 20), QRect(60, 12, 40, 20),
+                         QRect(10, 50, 40, 20), QRect(60, 50, 40, 20)};
+  for (int i = 0; i < 4; i++) {
+    TextBox box;
+    box.m_rect = rects[i];
+    box.m_text = texts[i];
+    box.m_confidence = 90.25F;
+    page.words.push_back(box);
+  }
+  const std::vector<size_t> starts = ResultWriter::getLineStarts(page.words);
+  QVERIFY((starts.size() == 2) && (starts[1] == 2));
+
+  ResultFormat format = ResultFormat::HOCR;
+  QVERIFY(ResultWriter::getFormatByName("alto", format));
+  QVERIFY(format == ResultFormat::ALTO);
+  QVERIFY(!ResultWriter::getFormatByName("pdf", format));
+
+  // every page is written out as soon as it comes
+  QBuffer buffer;
+  buffer.open(QIODevice::WriteOnly);
+  std::unique_ptr<ResultWriter> writer =
+      ResultWriter::create(ResultFormat::JSONL, &buffer);
+  QVERIFY(writer->begin());
+  QVERIFY(writer->writePage(page));
+  const int sizePage = buffer.data().size();
+  QVERIFY(sizePage > 0);
+  page.pageIndex = 1;
+  QVERIFY(writer->writePage(page));
+  QVERIFY(writer->end());
+  QVERIFY(buffer.data().count('\n') == 2);
+  const QList<QByteArray> lines = buffer.data().split('\n');
+  const QJsonObject reply = QJsonDocument::fromJson(lines[1]).object();
+  QVERIFY(reply.value("page").toInt() == 1);
+  QVERIFY(reply.value("file").toString() == "a&b.pdf");
+  const QJsonArray words = reply.value("words").toArray();
+  QVERIFY(words.size() == 4);
+  QVERIFY(words[1].toObject().value("text").toString() == "<two>");
+  QVERIFY(fabs(words[1].toObject().value("conf").toDouble() - 90.3) < 1e-6);
+  QVERIFY(lines[1] == QJsonDocument(ResultWriter::getPageJson(page))
+                          .toJson(QJsonDocument::Compact));
+
+  // xml formats are well formed, with lines and words
+  const ResultFormat formatsXml[] = {ResultFormat::HOCR, ResultFormat::ALTO};
+  for (ResultFormat formatXml : formatsXml) {
+    QBuffer bufferXml;
+    bufferXml.open(QIODevice::WriteOnly);
+    writer = ResultWriter::create(formatXml, &bufferXml);
+    QVERIFY(writer->begin());
+    QVERIFY(writer->writePage(page));
+    QVERIFY(writer->writePage(page));
+    QVERIFY(writer->end());
+    QVERIFY(writer->getNumPages() == 2);
+
+    QXmlStreamReader reader(bufferXml.data());
+    int numLines = 0;
+    int numWords = 0;
+    bool hasEscaped = false;
+    while (!reader.atEnd()) {
+      if (reader.readNext() != QXmlStreamReader::StartElement)
+        continue;
+      const QXmlStreamAttributes attrs = reader.attributes();
+      const QString cls = attrs.value("class").toString();
+      if ((cls == "ocr_line") || (reader.name() == QLatin1String("TextLine")))
+        numLines++;
+      if (cls == "ocrx_word") {
+        numWords++;
+        hasEscaped |= (reader.readElementText() == "<two>");
+      }
+      if (reader.name() == QLatin1String("String")) {
+        numWords++;
+        hasEscaped |= (attrs.value("CONTENT") == QLatin1String("<two>"));
+      }
+    }
+    QVERIFY(!reader.hasError());
+    QVERIFY(numLines == 4);
+    QVERIFY(numWords == 8);
+    QVERIFY(hasEscaped);
+  }
+}
+
+void TestInterface::testPdfExport() {
+  // binarized page with two words, gray page without words
+  BinImage imageBin = makeWhiteBinImage(400, 200);
+  fillBlackRect(imageBin, 20, 40, 100, 30);
+  std::vector<TextBox> words(2);
+  words[0].m_rect = QRect(20, 40, 100, 30);
+  words[0].m_text = "Born";
+  words[1].m_rect = QRect(140, 40, 120, 30);
+  words[1].m_text = QString::fromUtf8("\xd1\x81\xd0\xba\xd0\xb0\xd0\xbd");
+  QImage imageGray(300, 100, QImage::Format::Format_Grayscale8);
+  imageGray.fill(Qt::white);
+
+  const std::string fileName = QDir::tempPath().toStdString() +
+                               "/imb_export.pdf";
+  FzLocks locks;
+  fz_context *ctx = locks.newContext();
+  bool okClosed = false;
+  bool okAddClosed = true;
+  int numPagesExported = 0;
+  {
+    PdfExport exporter(ctx);
+    exporter.open(fileName.c_str());
+    exporter.addPage(imageBin.getQImage(), 2.0F, words);
+    exporter.addPage(imageGray, 1.0F, std::vector<TextBox>());
+    numPagesExported = exporter.getNumPages();
+    okClosed = exporter.close();
+    okAddClosed = exporter.addPage(imageGray, 1.0F, words);
+  }
+
+  // exported document: page size in points, words over their boxes
+  int numPages = 0;
+  fz_rect bounds = fz_empty_rect;
+  PdfTextLayer layer;
+  QImage image;
+  fz_document *doc = nullptr;
+  fz_var(doc);
+  fz_try(ctx) {
+    doc = fz_open_document(ctx, fileName.c_str());
+    numPages = fz_count_pages(ctx, doc);
+    fz_page *page = fz_load_page(ctx, doc, 0);
+    bounds = fz_bound_page(ctx, page);
+    fz_drop_page(ctx, page);
+  }
+  fz_catch(ctx) {
+    numPages = -1;
+  }
+  if (numPages == 2) {
+    PdfText::getTextLayer(ctx, doc, 0, fz_scale(2.0F, 2.0F), layer);
+    image = PdfRender::renderPage(ctx, doc, 0, fz_scale(2.0F, 2.0F), true);
+  }
+  fz_drop_document(ctx, doc);
+  fz_drop_context(ctx);
+  QFile::remove(QString::fromStdString(fileName));
+
+  QVERIFY(okClosed && !okAddClosed);
+  QVERIFY(numPagesExported == 2);
+  QVERIFY(numPages == 2);
+  QVERIFY((bounds.x1 - bounds.x0 == 200.0F) &&
+          (bounds.y1 - bounds.y0 == 100.0F));
+  QVERIFY(layer.words.size() == 2);
+  QVERIFY(layer.words[0].m_text == "Born");
+  QVERIFY(layer.words[1].m_text == words[1].m_text);
+  for (size_t i = 0; i < layer.words.size(); i++) {
+    const QRect &rect = layer.words[i].m_rect;
+    const QRect &rectSrc = words[i].m_rect;
+    QVERIFY(std::abs(rect.left() - rectSrc.left()) <= 2);
+    QVERIFY(std::abs(rect.right() - rectSrc.right()) <= 2);
+    // vertical extent depends on metrics of substituted font
+    QVERIFY(rectSrc.contains(rect.center()));
+  }
+  // image is under invisible text: 1 bpp pixels are back
+  QVERIFY(image.size() == QSize(400, 200));
+  QVERIFY(qGray(image.pixel(50, 50)) < 128);
+  QVERIFY(qGray(image.pixel(300, 150)) > 128);
+}
+
+void TestInterface::testTrace() {
+  Trace::clear();
+  {
+    // disabled: nothing is recorded
+    TRACE_ZONE("testDisabled");
+  }
+  const size_t numEventsDisabled = Trace::getEvents().size();
+
+  Trace::setEnabled(true);
+  {
+    TRACE_ZONE("testOuter", 7);
+  }
+  std::thread thread([] {
+    Trace::setThreadName("test thread");
+    // ring keeps the newest events
+    for (int i = 0; i < TRACE_RING_SIZE + 10; i++) {
+      Trace::addEvent("testRing", i, i + 1);
+    }
+  });
+  thread.join();
+  // counted now: ring of finished thread is reused by the next new one
+  int numRing = 0;
+  int64_t timeRingFirst = -1;
+  int numOuter = 0;
+  for (const TraceEvent& evt : Trace::getEvents()) {
+    if (strcmp(evt.name, "testRing") == 0) {
+      if (numRing++ == 0)
+        timeRingFirst = evt.timeStart;
+    }
+    if ((strcmp(evt.name, "testOuter") == 0) && (evt.page == 7) &&
+        (evt.duration >= 0))
+      numOuter++;
+  }
+
+  // instrumented kernels
+  QImage imageGray(256, 128, QImage::Format::Format_Grayscale8);
+  imageGray.fill(200);
+  const BinImage imageBin = Binarizer::binarize(
+      imageGray, AlgirithmBinType::ALGORITHM_SAUVOLA_FAST, 7, 0.25F);
+  Trace::setEnabled(false);
+  const bool hasKernels = (Trace::getTotalMs("gray") > 0.0) &&
+                          (Trace::getTotalMs("integral") > 0.0) &&
+                          (Trace::getTotalMs("sauvolaFused") > 0.0);
+
+  QBuffer buffer;
+  buffer.open(QIODevice::WriteOnly);
+  const bool okWrite = Trace::write(&buffer);
+  Trace::clear();
+
+  QJsonParseError errorParse;
+  const QJsonDocument doc = QJsonDocument::fromJson(buffer.data(),
+                                                    &errorParse);
+  const QJsonArray events = doc.object().value("traceEvents").toArray();
+  bool hasThreadName = false;
+  bool hasOuter = false;
+  for (const QJsonValue& value : events) {
+    const QJsonObject evt = value.toObject();
+    if ((evt.value("ph").toString() == "M") &&
+        (evt.value("args").toObject().value("name").toString() ==
+         "test thread"))
+      hasThreadName = true;
+    if ((evt.value("name").toString() == "testOuter") &&
+        (evt.value("ph").toString() == "X") &&
+        (evt.value("args").toObject().value("page").toInt() == 7) &&
+        (evt.value("dur").toDouble() >= 0.0))
+      hasOuter = true;
+  }
+
+  QVERIFY(numEventsDisabled == 0);
+  QVERIFY(numRing == TRACE_RING_SIZE);
+  QVERIFY(timeRingFirst == 10);
+  QVERIFY(numOuter == 1);
+  QVERIFY(hasKernels);
+  QVERIFY(!imageBin.isNull());
+  QVERIFY(okWrite);
+  QVERIFY(errorParse.error == QJsonParseError::NoError);
+  QVERIFY(events.size() > TRACE_RING_SIZE);
+  QVERIFY(hasThreadName);
+  QVERIFY(hasOuter);
+}
@@ -32,4 +32,30 @@ private slots:
   void testIntegralSum();
   void testIntegralSum2();
   void testFastMean();
+  void testBufferPool();
+  void testSauvolaFused();
+  void testIntegralImageExact();
+  void testFastMeanStdScaling();
+  void testThreadPool();
+  void testGaussSeparable();
+  void testGaussIir();
+  void testPixFromQImage();
+  void testPdfRender();
+  void testBinImage();
+  void testOcrPool();
+  void testPageLayout();
+  void testBinImageToPix();
+  void testSpscQueue();
+  void testRecogWorker();
+  void testPdfText();
+  void testPageCache();
+  void testPdfPages();
+  void testPdfRenderBands();
+  void testTextScale();
+  void testRegionRecog();
+  void testBatchPipeline();
+  void testOcrServer();
+  void testResultWriter();
+  void testPdfExport();
+  void testTrace();
 };
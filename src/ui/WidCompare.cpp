@@ -26,9 +26,10 @@ void WidCompare::onSliderBlend(int v) {
 }
 
 void WidCompare::setImages(QImage &imageA, QImage &imageB, QImage &imageDif) {
-  m_imageA = imageA;
-  m_imageB = imageB;
-  m_imageDif = imageDif;
+  // binarized images are 1 bpp: expand once to bytes for blending
+  m_imageA = imageA.convertToFormat(QImage::Format::Format_Grayscale8);
+  m_imageB = imageB.convertToFormat(QImage::Format::Format_Grayscale8);
+  m_imageDif = imageDif.convertToFormat(QImage::Format::Format_Grayscale8);
   showImages();
 }
 
@@ -36,36 +37,35 @@ void WidCompare::showImages() {
   // blend 2 source images into one
   const int w = m_imageA.width();
   const int h = m_imageA.height();
-  const int numPixels = w * h;
-  const QImage::Format fmt = m_imageA.format();
-  assert( (fmt == QImage::Format::Format_ARGB32) ||
-      (fmt == QImage::Format::Format_RGB32) );
-  QImage image = m_imageA.copy();
+  assert(m_imageA.format() == QImage::Format::Format_Grayscale8);
+  QImage image(w, h, QImage::Format::Format_RGB32);
 
-  const uint8_t *pixA = m_imageA.bits();
-  const uint8_t *pixB = m_imageB.bits();
-  const uint8_t *pixDif = m_imageDif.bits();
-  uint8_t *pixDst = image.bits();
-  int j = 0;
-  for (int i = 0; i < numPixels; i++, j += 4) {
-    auto valA = (uint32_t)pixA[j];
-    auto valB = (uint32_t)pixB[j];
-    uint8_t valDif = pixDif[j];
+  for (int y = 0; y < h; y++) {
+    const uint8_t *pixA = m_imageA.constScanLine(y);
+    const uint8_t *pixB = m_imageB.constScanLine(y);
+    const uint8_t *pixDif = m_imageDif.constScanLine(y);
+    uint8_t *pixDst = image.scanLine(y);
+    for (int x = 0, j = 0; x < w; x++, j += 4) {
+      auto valA = (uint32_t)pixA[x];
+      auto valB = (uint32_t)pixB[x];
+      uint8_t valDif = pixDif[x];
 
-    // blend 2 images as a * (1 - r) + b * r
-    auto val = (uint8_t)(valA * (1.0F - m_blend) + valB * m_blend);
-    if (valDif < 5) {
-      pixDst[j + 0] = val;
-      pixDst[j + 1] = val;
-      pixDst[j + 2] = val;
-    } else {
-      // make more red-colored
-      uint8_t valLess = val - val / 4;
-      pixDst[j + 0] = valLess;
-      pixDst[j + 1] = valLess;
-      pixDst[j + 2] = val;
-    } //if
-  }// for i , all pixels
+      // blend 2 images as a * (1 - r) + b * r
+      auto val = (uint8_t)(valA * (1.0F - m_blend) + valB * m_blend);
+      if (valDif < 5) {
+        pixDst[j + 0] = val;
+        pixDst[j + 1] = val;
+        pixDst[j + 2] = val;
+      } else {
+        // make more red-colored
+        uint8_t valLess = val - val / 4;
+        pixDst[j + 0] = valLess;
+        pixDst[j + 1] = valLess;
+        pixDst[j + 2] = val;
+      } //if
+      pixDst[j + 3] = 255;
+    } // for x
+  }// for y
 
 
   QPixmap pixmap = QPixmap::fromImage(image);
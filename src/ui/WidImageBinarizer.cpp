@@ -16,16 +16,14 @@
 #include <QtGui/QPainter>
 #include <QtWidgets/QBoxLayout>
 #include <QtGui/QMouseEvent>
-#include <QtCore/QTime>
+#include <QtCore/QTimer>
 
 
 #pragma warning(pop)
 
+#include <algorithm>
 #include <cassert>
 
-#include "tesseract/baseapi.h"
-#include "tesseract/publictypes.h"
-
 
 #include "WidImageBinarizer.h"
 #include "WidRender.h"
@@ -36,7 +34,25 @@
 #include "Bmp.h"
 #include "ImageConv.h"
 #include "ImageDif.h"
-#include "FastMeanStd.h"
+#include "PdfRender.h"
+#include "PdfExport.h"
+#include "PdfText.h"
+#include "TextScale.h"
+#include "Trace.h"
+
+
+// *************************************
+// consts
+// *************************************
+
+// memory limit for all OCR engines of the pool
+constexpr int cOcrMemoryBudgetMb = 512;
+// period of taking recognition events from worker, ms
+constexpr int cRecogEventsPeriodMs = 30;
+// selection is re-rendered with page scale multiplied by this factor
+constexpr float cRegionScaleFactor = 2.0F;
+// but not larger than this scale
+constexpr float cRegionMaxScale = 16.0F;
 
 
 // *************************************
@@ -53,12 +69,13 @@ WidImageBinarizer::WidImageBinarizer(QWidget* parent)
 
   m_widgetsRender.clear();
   m_recognitionResults.clear();
-  m_timeClickButton = QTime::currentTime();
+  m_jobIdCurrent = 0;
 
   m_algorithmType = AlgirithmBinType::ALGORITHM_SAUVOLA;
   m_numWidgets = 0;
   m_sauvilaNeibSize = 2;
   m_sauvolaFactor = 0.25F;
+  m_ocrByBlocks = true;
 
   // register connections
   connect(m_ui.m_pushButtonOpenImage, SIGNAL(pressed()), this, SLOT(onPushButtonOpen()));
@@ -88,6 +105,8 @@ WidImageBinarizer::WidImageBinarizer(QWidget* parent)
 
   connect(m_ui.m_buttonRemoveSelectedRectangles, SIGNAL(pressed()), this, 
           SLOT(onPressedRemoveSelectedRectangles()));
+  connect(m_ui.m_buttonReprocessSelection, SIGNAL(pressed()), this,
+          SLOT(onPressedReprocessSelection()));
 
   connect(m_ui.m_buttonDown, SIGNAL(pressed()), this,
           SLOT(onPushButtonDown()));
@@ -104,6 +123,10 @@ WidImageBinarizer::WidImageBinarizer(QWidget* parent)
           SLOT(oRadioRotateRight()));
 
   connect(m_ui.m_buttonCompareBinarized, SIGNAL(pressed()), this, SLOT(onPushButtonCompareBinarized()) );
+  connect(m_ui.m_buttonExportPdf, SIGNAL(pressed()), this,
+          SLOT(onPushButtonExportPdf()));
+  connect(&m_timerRecognition, SIGNAL(timeout()), this,
+          SLOT(onTimerRecognition()));
 
 
   setSauvolaRange(m_sauvilaNeibSize);
@@ -121,11 +144,14 @@ WidImageBinarizer::WidImageBinarizer(QWidget* parent)
   // switch off progress
   m_ui.m_progressRecognition->setVisible(false);
 
-  // init leptonica LIB
-  m_ctxFz = fz_new_context(nullptr, nullptr, FZ_STORE_DEFAULT);
-  fz_register_document_handlers(m_ctxFz);
+  // init leptonica LIB. Context with locks: pages are prefetched on its
+  // clone
+  m_ctxFz = m_fzLocks.newContext();
+  m_pdfPages.start(m_ctxFz, (size_t)PDF_PAGES_CACHE_MB * 1024 * 1024);
 
   ocrInit();
+  m_recogWorker.start(&m_ocrPool);
+  m_timerRecognition.start(cRecogEventsPeriodMs);
 
   // init pdf load from mupdf
   m_doc = nullptr;
@@ -133,12 +159,19 @@ WidImageBinarizer::WidImageBinarizer(QWidget* parent)
   m_docPageIndex = 0;
   m_docScale = 2.0F;
   m_docRotate = 0.0F;
+  m_docAutoScale = false;
+  m_pageFromPdf = false;
+  m_textLayerPolicy = TextLayerPolicy::AUTO;
 }
 
 
 WidImageBinarizer::~WidImageBinarizer() {
+  m_timerRecognition.stop();
+  // running job is cancelled before its engines are destroyed
+  m_recogWorker.stop();
   ocrDestroy();
 
+  m_pdfPages.stop();
   if (m_doc)
     fz_drop_document(m_ctxFz, m_doc);
 
@@ -153,48 +186,99 @@ WidImageBinarizer::~WidImageBinarizer() {
   for (RecognitionResult* res: m_recognitionResults) {
     delete res;
   }
+  // results of jobs stopped before their tabs are shown
+  for (auto& jobRes : m_jobResults) {
+    if (std::find(m_recognitionResults.begin(), m_recognitionResults.end(),
+                  jobRes.second) == m_recognitionResults.end())
+      delete jobRes.second;
+  }
 }
 
 QImage WidImageBinarizer::loadPdf(const char* fileName) {
-  fz_pixmap*    pix;
-  fz_matrix     ctm;
-  
-  m_doc = fz_open_document(m_ctxFz, fileName);
-  m_docNumPages = fz_count_pages(m_ctxFz, m_doc);
-
-  ctm = fz_scale(m_docScale, m_docScale);
-  ctm = fz_pre_rotate(ctm, m_docRotate);
-
-  pix = fz_new_pixmap_from_page_number(m_ctxFz, m_doc, m_docPageIndex, ctm,
-                                       fz_device_rgb(m_ctxFz), 0);
+  fz_document* doc = fz_open_document(m_ctxFz, fileName);
+  m_docNumPages = fz_count_pages(m_ctxFz, doc);
 
-  QImage imgPdf = BmpFzPixToQImage(pix);
-
-  // clean up
-  fz_drop_pixmap(m_ctxFz, pix);
+  // previous document is dropped after prefetch stops using it
+  m_pdfPages.setDocument(doc, m_docNumPages);
+  if (m_doc)
+    fz_drop_document(m_ctxFz, m_doc);
+  // pages of shown results cannot be rendered again
+  for (RecognitionResult* res : m_recognitionResults) {
+    res->m_pageIndex = -1;
+  }
+  for (auto& jobRes : m_jobResults) {
+    jobRes.second->m_pageIndex = -1;
+  }
+  const int indexTab = m_ui.m_tabWidget->currentIndex();
+  if ((indexTab >= 0) && !m_recognitionResults[indexTab]->hasSource())
+    enableButtonReprocessSelection(false);
+  m_doc = doc;
+  m_docAutoScales.clear();
+  updateAutoScale();
+
+  // next stage is binarization: render gray directly into image pixels
+  QImage imgPdf = m_pdfPages.getPage(m_docPageIndex, m_docScale, m_docRotate);
+  updatePageTextLayer(PdfRender::getMatrix(m_docScale, m_docRotate));
   return imgPdf;
 }
-void WidImageBinarizer::loadCurrentPageFromDoc() {
-  fz_pixmap* pix;
-  fz_matrix ctm;
-
-  ctm = fz_scale(m_docScale, m_docScale);
-  ctm = fz_pre_rotate(ctm, m_docRotate);
-
-  pix = fz_new_pixmap_from_page_number(m_ctxFz, m_doc, m_docPageIndex, ctm,
-                                       fz_device_rgb(m_ctxFz), 0);
 
-  m_imageSrc = BmpFzPixToQImage(pix);
+void WidImageBinarizer::loadCurrentPageFromDoc() {
+  if (!m_pageFromPdf)
+    return;
+  updateAutoScale();
+  // cached or prefetched page: no render on page flip
+  m_imageSrc = m_pdfPages.getPage(m_docPageIndex, m_docScale, m_docRotate);
+  updatePageTextLayer(PdfRender::getMatrix(m_docScale, m_docRotate));
   #ifdef DEEP_DEBUG
     m_imageSrc.save("log/pdf_src.png");
   #endif
 
-  // clean up
-  fz_drop_pixmap(m_ctxFz, pix);
   // send image to screen
   showImageSrc();
 }
 
+void WidImageBinarizer::updatePageTextLayer(fz_matrix ctm) {
+  m_pageTextLayer = PdfTextLayer();
+  // no probe cost if the layer is not used anyway
+  if (m_textLayerPolicy == TextLayerPolicy::ALWAYS_OCR)
+    return;
+  {
+    std::lock_guard<std::mutex> lockDoc(m_pdfPages.getDocMutex());
+    PdfText::getTextLayer(m_ctxFz, m_doc, m_docPageIndex, ctm,
+                          m_pageTextLayer);
+  }
+  qInfo() << "Pdf text layer: " << m_pageTextLayer.words.size() << "words,"
+          << m_pageTextLayer.numBadChars << "of" << m_pageTextLayer.numChars
+          << "characters without unicode";
+}
+
+void WidImageBinarizer::setTextLayerPolicy(TextLayerPolicy policy) {
+  m_textLayerPolicy = policy;
+}
+
+void WidImageBinarizer::setAutoScale(bool isAuto) {
+  m_docAutoScale = isAuto;
+}
+
+void WidImageBinarizer::updateAutoScale() {
+  if (!m_docAutoScale || (m_doc == nullptr))
+    return;
+  float scale;
+  const auto it = m_docAutoScales.find(m_docPageIndex);
+  if (it != m_docAutoScales.end()) {
+    scale = it->second;
+  } else {
+    std::lock_guard<std::mutex> lockDoc(m_pdfPages.getDocMutex());
+    scale = TextScale::getPageScale(m_ctxFz, m_doc, m_docPageIndex,
+                                    m_docRotate);
+    m_docAutoScales[m_docPageIndex] = scale;
+  }
+  // page without text keeps the previous scale
+  if (scale > 0.0F)
+    m_docScale = scale;
+  updatePagesUi();
+}
+
 bool WidImageBinarizer::performOpenFile(QString& strFileName) {
   QString suf = strFileName.right(3);
   bool okLoad;
@@ -203,8 +287,12 @@ bool WidImageBinarizer::performOpenFile(QString& strFileName) {
     const char *fn = ba.data();
     m_imageSrc = loadPdf(fn);
     okLoad = !m_imageSrc.isNull();
+    m_pageFromPdf = true;
   } else {
+    TRACE_ZONE("loadImage");
     okLoad = m_imageSrc.load(strFileName);
+    m_pageFromPdf = false;
+    m_pageTextLayer = PdfTextLayer();
     m_docNumPages = 1;
     m_docPageIndex = 0;
   }
@@ -237,6 +325,8 @@ void WidImageBinarizer::updatePagesUi() {
 }
 
 void WidImageBinarizer::onPushButtonPlus() {
+  // manual zoom
+  m_docAutoScale = false;
   m_docScale = m_docScale * 2.0F;
   updatePagesUi();
   loadCurrentPageFromDoc();
@@ -244,6 +334,7 @@ void WidImageBinarizer::onPushButtonPlus() {
 
 void WidImageBinarizer::onPushButtonMinus() {
   if (m_docScale >= 2.0F) {
+    m_docAutoScale = false;
     m_docScale = m_docScale / 2.0F;
     updatePagesUi();
     loadCurrentPageFromDoc();
@@ -252,14 +343,17 @@ void WidImageBinarizer::onPushButtonMinus() {
 
 void WidImageBinarizer::onRadioRotateNone() {
   m_docRotate = 0.0F;
+  m_docAutoScales.clear();
   loadCurrentPageFromDoc();
 }
 void WidImageBinarizer::onRadioRotateLeft() {
   m_docRotate = -90.0F;
+  m_docAutoScales.clear();
   loadCurrentPageFromDoc();
 }
 void WidImageBinarizer::oRadioRotateRight() {
   m_docRotate = +90.0F;
+  m_docAutoScales.clear();
   loadCurrentPageFromDoc();
 }
 
@@ -296,6 +390,64 @@ void WidImageBinarizer::enableButtonRemoveSelectedRectangles() {
   m_ui.m_buttonRemoveSelectedRectangles->setEnabled(true);
 }
 
+void WidImageBinarizer::enableButtonReprocessSelection(bool isEnabled) {
+  m_ui.m_buttonReprocessSelection->setEnabled(isEnabled);
+}
+
+void WidImageBinarizer::onPressedReprocessSelection() {
+  const int indexTab = m_ui.m_tabWidget->currentIndex();
+  if (indexTab < 0)
+    return;
+  RecognitionResult* res = m_recognitionResults[indexTab];
+  const QRect rect = res->m_rectSelected;
+  if (rect.isEmpty())
+    return;
+
+  // region is rasterized again with higher resolution, not just upscaled
+  QImage imageRegion;
+  float scale = cRegionScaleFactor;
+  if ((res->m_pageIndex >= 0) && (m_doc != nullptr)) {
+    float scalePage = res->m_pageScale * cRegionScaleFactor;
+    if (scalePage > cRegionMaxScale)
+      scalePage = cRegionMaxScale;
+    if (scalePage < res->m_pageScale)
+      scalePage = res->m_pageScale;
+    scale = scalePage / res->m_pageScale;
+    const QRect clip((int)(rect.left() * scale), (int)(rect.top() * scale),
+                     (int)(rect.width() * scale),
+                     (int)(rect.height() * scale));
+    std::lock_guard<std::mutex> lockDoc(m_pdfPages.getDocMutex());
+    imageRegion = PdfRender::renderClip(
+        m_ctxFz, m_doc, res->m_pageIndex,
+        PdfRender::getMatrix(scalePage, res->m_pageRotate), clip, true);
+  } else if (!res->m_imageSource.isNull()) {
+    // image file: only interpolation is possible
+    const QImage imageCrop = res->m_imageSource.copy(rect);
+    imageRegion = imageCrop.scaled(imageCrop.size() * scale,
+                                   Qt::IgnoreAspectRatio,
+                                   Qt::SmoothTransformation);
+  }
+  if (imageRegion.isNull()) {
+    setStatusText("Source of the selection is not available");
+    return;
+  }
+
+  RecogJob job;
+  job.image = imageRegion;
+  job.binarize = getBinarizeFunction(scale);
+  // small region: one engine, started before pending pages
+  job.byBlocks = false;
+  job.priority = RECOG_PRIORITY_HIGH;
+  // words are filtered by height of the whole page, not of the region
+  job.hPage = (int)(res->m_image.height() * scale);
+  const int jobId = m_recogWorker.submit(std::move(job));
+  RegionJob& regionJob = m_regionJobs[jobId];
+  regionJob.res = res;
+  regionJob.rect = rect;
+  regionJob.scale = scale;
+  m_ui.m_buttonReprocessSelection->setEnabled(false);
+}
+
 void WidImageBinarizer::onPressedRemoveSelectedRectangles() {
   const int indexTab = m_ui.m_tabWidget->currentIndex();
   if (indexTab >= 0) {
@@ -455,247 +607,216 @@ void WidImageBinarizer::addResultToTab(RecognitionResult* res,
   if (m_numWidgets >= 2) {
     m_ui.m_buttonCompareBinarized->setEnabled(true);
   }
+  m_ui.m_buttonExportPdf->setEnabled(true);
 }
 
 
 void WidImageBinarizer::onPushButtonBinarize()
 { 
-  // prevent repeated click on this button
-  QTime tm = QTime::currentTime();
-  const int dt = m_timeClickButton.msecsTo(tm);
-  if (dt < 500)
+  if (m_imageSrc.isNull())
+    return;
+  // result of previous press (other parameters or page) is stale now
+  m_recogWorker.cancelAll();
+
+  if (m_pageFromPdf &&
+      PdfText::useTextLayer(m_textLayerPolicy, m_pageTextLayer)) {
+    // born-digital page: words are known, no binarization and OCR
+    auto* recRes = new RecognitionResult();
+    recRes->m_image = m_imageSrc;
+    recRes->m_textBoxes = m_pageTextLayer.words;
+    recRes->m_pageIndex = m_docPageIndex;
+    recRes->m_pageScale = m_docScale;
+    recRes->m_pageRotate = m_docRotate;
+    QString strTab = QString("Text layer %1").arg(m_numWidgets + 1);
+    addResultToTab(recRes, strTab);
+    m_jobIdCurrent = 0;
+    m_ui.m_progressRecognition->setVisible(false);
     return;
-
-  QApplication::setOverrideCursor(Qt::WaitCursor);
-  m_ui.m_pushButtonBinarize->setEnabled(false);
-  m_ui.m_pushButtonOpenImage->setEnabled(false);
-  m_ui.m_sliderSauvolaRange->setEnabled(false);
-  m_ui.m_sliderSauvolaFactor->setEnabled(false);
-
-  QImage imageBin;
-
-  if (m_algorithmType == AlgirithmBinType::ALGORITHM_SAUVOLA) {
-    imageBin = createSauvola(m_imageSrc, m_sauvilaNeibSize, m_sauvolaFactor);
-  }
-  if (m_algorithmType == AlgirithmBinType::ALGORITHM_SAUVOLA_FAST) {
-    imageBin = createSauvolaFast(m_imageSrc, m_sauvilaNeibSize, m_sauvolaFactor);
-  }
-  if (m_algorithmType == AlgirithmBinType::ALGORITHM_LEPTONICA) {
-    imageBin = createLeptonicaBinarization(m_imageSrc, m_sauvilaNeibSize, m_sauvolaFactor);
-  }
-  if (m_algorithmType == AlgirithmBinType::ALGORITHM_NONE) {
-    imageBin = m_imageSrc.copy();
   }
 
-  std::vector<TextBox> boxes = applyTesseract(imageBin);
-
-  QString strTab = QString("Binarized %1").arg(m_numWidgets + 1);
-
+  RecogJob job;
+  job.image = m_imageSrc;
+  job.byBlocks = m_ocrByBlocks;
+  job.priority = RECOG_PRIORITY_NORMAL;
+  job.binarize = getBinarizeFunction();
+  m_jobIdCurrent = m_recogWorker.submit(std::move(job));
+  // tab is shown with page image
   auto* recRes = new RecognitionResult();
-  recRes->m_image = imageBin;
-  recRes->m_textBoxes = boxes;
-
-  addResultToTab(recRes, strTab);
+  if (m_pageFromPdf) {
+    recRes->m_pageIndex = m_docPageIndex;
+    recRes->m_pageScale = m_docScale;
+    recRes->m_pageRotate = m_docRotate;
+  } else {
+    // shared pixels: selection is cropped from this file, whatever is
+    // opened later
+    recRes->m_imageSource = m_imageSrc;
+  }
+  m_jobResults[m_jobIdCurrent] = recRes;
+  m_ui.m_progressRecognition->setVisible(true);
+  m_ui.m_progressRecognition->setValue(0);
+}
 
-  m_ui.m_pushButtonOpenImage->setEnabled(true);
-  m_ui.m_sliderSauvolaRange->setEnabled(true);
-  m_ui.m_sliderSauvolaFactor->setEnabled(true);
-  m_ui.m_pushButtonBinarize->setEnabled(true);
+std::function<BinImage(const QImage&)> WidImageBinarizer::getBinarizeFunction(
+    float scaleWindow) const {
+  // ALGORITHM_NONE: no binarize function, source image is recognized
+  if (m_algorithmType == AlgirithmBinType::ALGORITHM_NONE)
+    return nullptr;
+  // parameters are copied: sliders may change while job is in work.
+  // Runs on recognition worker thread
+  const AlgirithmBinType type = m_algorithmType;
+  const int neibSize = (int)(m_sauvilaNeibSize * scaleWindow + 0.5F);
+  const float factor = m_sauvolaFactor;
+  return [type, neibSize, factor](const QImage& image) {
+    return Binarizer::binarize(image, type, neibSize, factor);
+  };
+}
+
+void WidImageBinarizer::onTimerRecognition() {
+  RecogEvent evt;
+  while (m_recogWorker.popEvent(evt)) {
+    processRecogEvent(evt);
+  }
+}
 
-  QApplication::restoreOverrideCursor();
+void WidImageBinarizer::processRecogEvent(RecogEvent& evt) {
+  const auto itRegion = m_regionJobs.find(evt.jobId);
+  if (itRegion != m_regionJobs.end()) {
+    processRegionEvent(evt, itRegion->second);
+    return;
+  }
+  const auto itRes = m_jobResults.find(evt.jobId);
+  RecognitionResult* res =
+      (itRes != m_jobResults.end()) ? itRes->second : nullptr;
+
+  switch (evt.type) {
+    case RecogEventType::IMAGE: {
+      // tab is shown at once, words are added while they come
+      if (res == nullptr)
+        break;
+      res->m_image = evt.image;
+      QString strTab = QString("Binarized %1").arg(m_numWidgets + 1);
+      addResultToTab(res, strTab);
+      break;
+    }
+    case RecogEventType::WORDS: {
+      if (res == nullptr)
+        break;
+      res->m_textBoxes.insert(res->m_textBoxes.end(), evt.words.begin(),
+                              evt.words.end());
+      for (size_t i = 0; i < m_recognitionResults.size(); i++) {
+        if (m_recognitionResults[i] == res)
+          m_widgetsRender[i]->update();
+      }
+      break;
+    }
+    case RecogEventType::PROGRESS: {
+      if (evt.jobId == m_jobIdCurrent)
+        m_ui.m_progressRecognition->setValue(evt.percent);
+      break;
+    }
+    case RecogEventType::DONE:
+    case RecogEventType::CANCELLED: {
+      // partial result of cancelled job is not shown
+      if ((evt.type == RecogEventType::CANCELLED) && (res != nullptr))
+        removeResultTab(res);
+      m_jobResults.erase(evt.jobId);
+      if (evt.jobId == m_jobIdCurrent) {
+        m_jobIdCurrent = 0;
+        m_ui.m_progressRecognition->setVisible(false);
+      }
+      break;
+    }
+  }
+}
 
-  // prevent dbl click
-  m_timeClickButton = QTime::currentTime();
+void WidImageBinarizer::processRegionEvent(RecogEvent& evt, RegionJob& job) {
+  switch (evt.type) {
+    case RecogEventType::IMAGE:
+    case RecogEventType::PROGRESS:
+      break;
+    case RecogEventType::WORDS: {
+      job.words.insert(job.words.end(), evt.words.begin(), evt.words.end());
+      break;
+    }
+    case RecogEventType::DONE: {
+      // old words are kept if region job is cancelled or has no words
+      if (job.words.empty()) {
+        setStatusText("Selection re-processed: no words, old words are kept");
+        m_regionJobs.erase(evt.jobId);
+        break;
+      }
+      const int numWords =
+          job.res->spliceRegion(job.rect, job.scale, job.words);
+      for (size_t i = 0; i < m_recognitionResults.size(); i++) {
+        if (m_recognitionResults[i] == job.res)
+          m_widgetsRender[i]->update();
+      }
+      QString strText;
+      QTextStream(&strText) << "Selection re-processed: " << numWords
+                            << " words";
+      setStatusText(strText);
+      m_regionJobs.erase(evt.jobId);
+      break;
+    }
+    case RecogEventType::CANCELLED: {
+      m_regionJobs.erase(evt.jobId);
+      break;
+    }
+  }
 }
 
+void WidImageBinarizer::removeResultTab(RecognitionResult* res) {
+  for (size_t i = 0; i < m_recognitionResults.size(); i++) {
+    if (m_recognitionResults[i] != res)
+      continue;
+    m_ui.m_tabWidget->removeTab((int)i);
+    delete m_widgetsRender[i];
+    m_widgetsRender.erase(m_widgetsRender.begin() + i);
+    m_recognitionResults.erase(m_recognitionResults.begin() + i);
+    m_numWidgets--;
+    break;
+  }
+  // selection re-processing of the removed result is not needed
+  for (auto it = m_regionJobs.begin(); it != m_regionJobs.end();) {
+    if (it->second.res == res) {
+      m_recogWorker.cancel(it->first);
+      it = m_regionJobs.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  // result may be not shown yet (job cancelled before its image)
+  delete res;
+  m_ui.m_buttonCompareBinarized->setEnabled(m_numWidgets >= 2);
+  m_ui.m_buttonExportPdf->setEnabled(m_numWidgets >= 1);
+}
 
-// #define USE_MUPDF
 
 void WidImageBinarizer::ocrInit() {
-  // Initialize tesseract-ocr with English, without specifying tessdata path
-  //
   // trained models are taken from
   // https://github.com/tesseract-ocr/tessdata/raw/master/eng.traineddata
   //
 
-  const char* dataPath = "data\\models\\";
-  const char* lang = "rus";
-
-  #ifdef USE_MUPDF
-    m_ocrApi = ocr_init(m_ctxFz, lang, dataPath);
-  #else
+  // leptonica inside tesseract allocates via mupdf context
   set_leptonica_mem(m_ctxFz);
 
-
-    tesseract::TessBaseAPI* api;
-    m_ocrApi = api = new tesseract::TessBaseAPI();
-    api->Init(dataPath, 
-      0, 
-      lang, 
-      tesseract::OcrEngineMode::OEM_LSTM_ONLY,
-      NULL, 0,
-      NULL, NULL,
-      false, // set_only_non_debug_params
-      NULL);
-  #endif
+  OcrPoolConfig config;
+  config.dataPath = "data\\models\\";
+  config.lang = "rus";
+  // one engine per core, but not more than memory limit
+  config.numEngines = 0;
+  config.memoryBudgetMb = cOcrMemoryBudgetMb;
+  if (!m_ocrPool.init(config)) {
+    qWarning() << "Tesseract engines are not initialized";
+  }
 }
 
 void WidImageBinarizer::ocrDestroy() { 
-#ifdef USE_MUPDF
-  ocr_fin(m_ctxFz, m_ocrApi); 
-#else
-  tesseract::TessBaseAPI* api = (tesseract::TessBaseAPI*)m_ocrApi;
-  api->End();
-  delete api;
+  m_ocrPool.destroy();
   clear_leptonica_mem(m_ctxFz);
-#endif
-}
-
-
-QImage WidImageBinarizer::createLeptonicaBinarization(QImage&       imageSrc,
-                                                      const int     neibSize,
-                                                      const float   factor) {
-
-  PIX* pixSrc = nullptr;
-  PIX* pixDest = nullptr;
-  PIX* pixThr = nullptr;
-
-  Bmp bmpMem;
-  bmpMem.initFromQImage(imageSrc);
-
-  auto* dataBits = (l_uint8*)bmpMem.bits();
-  size_t sz = bmpMem.sizeInBytes();
-
-  pixSrc = pixReadMem(dataBits, sz);
-  assert(pixSrc);
-
-  #ifdef DEEP_DEBUG
-    pixWrite("log/src_for_lepto.png", pixSrc, IFF_PNG);
-  #endif
-
-  const int subdivTiles = 4;
-  pixSauvolaBinarizeTiled(pixSrc, neibSize * 2 + 1, factor, subdivTiles, subdivTiles,
-                          &pixThr, &pixDest);
-
-  #ifdef DEEP_DEBUG
-    pixWrite("log/bin_lepto.png", pixDest, IFF_PNG);
-  #endif
-
-  QImage imageBin; //  = imageFloatDest.getQImage();
-  imageBin = BmpPixToQImage(pixDest);
-
-  #ifdef DEEP_DEBUG
-    imageBin.save("log/qimg_bina.png");
-  #endif
-
-  pixDestroy(&pixDest);
-  pixDestroy(&pixThr);
-  pixDestroy(&pixSrc);
-  return imageBin;
 }
 
 
-QImage WidImageBinarizer::createSauvola(QImage& imageSrc, const int neibSize,
-                                        const float factor) {
-  //
-  // According to https://craftofcoding.wordpress.com/2021/10/06/thresholding-algorithms-sauvola-local/
-  // threshold value is calculated as:
-  // t = M * (1 + k * ((S/128) - 1))
-  // t: result threshold
-  // M: media value
-  // S: standard deviation value
-  // k: factor in [0.2 .. 0.5]
-
-  FImage imageFloatSrc(imageSrc);
-
-  FImage imageFloatMean = imageFloatSrc.getWindowedMean(neibSize * 2 + 1);
-  FImage imageFloatStdDev = imageFloatSrc.getWindowedStdDev(imageFloatMean, neibSize * 2 + 1);
-  FImage imageFloatThresholds =
-      imageFloatMean.getSauvolaThreshold(imageFloatStdDev, factor);
-
-  FImage imageFloatDest = imageFloatSrc.applyThresholds(imageFloatThresholds);
-
-  QImage imageBin = imageFloatDest.getQImage();
-  return imageBin;
-}
-
-QImage WidImageBinarizer::createSauvolaFast(QImage& imageSrc, const int neibSize,
-                                        const float factor) {
-  FImage imageFloatSrc(imageSrc);
-  FImage imageFloatMean(imageSrc);
-  FImage imageFloatStdDev(imageSrc);
-
-  FastMeanStd::getFastMeanStd(imageFloatSrc, imageFloatMean, imageFloatStdDev,
-                              neibSize * 2 + 1);
-
-  FImage imageFloatThresholds =
-      imageFloatMean.getSauvolaThreshold(imageFloatStdDev, factor);
-
-  FImage imageFloatDest = imageFloatSrc.applyThresholds(imageFloatThresholds);
-
-  QImage imageBin = imageFloatDest.getQImage();
-  return imageBin;
-}
-
-
-std::vector<TextBox> WidImageBinarizer::applyTesseract(QImage& image) {
-  std::vector<TextBox> textBoxes;
-
-  const uchar* bits = image.bits();
-  const int w = image.width();
-  const int h = image.height();
-  const int bpp = 4;
-  const int bpLine = image.bytesPerLine();
-
-  auto* ocr = (tesseract::TessBaseAPI*)m_ocrApi;
-  ocr->SetImage(bits, w, h, bpp, bpLine);
-
-
-  Boxa* bounds = ocr->GetWords(nullptr);
-
-  // prevent recognize too narrow (by height) text boxes
-  const int hMax = h / 8;
-  m_ui.m_progressRecognition->setVisible(true);
-  m_ui.m_progressRecognition->setValue(0);
-
-  for (int i = 0; i < bounds->n; ++i) {
-    // progress rare update
-    if ((i & 15) == 0) {
-      const int valProgress = 100 * i / bounds->n;
-      m_ui.m_progressRecognition->setValue(valProgress);
-      QCoreApplication::processEvents();
-    }
-
-    Box* b = bounds->box[i];
-    if (b->h > hMax) {
-      continue;
-    }
-
-    ocr->SetRectangle(b->x, b->y, b->w, b->h);
-    char* outText;
-    outText = ocr->GetUTF8Text();
-    QString strRecognized(outText);
-    delete[] outText;
-
-    if (strRecognized.length() == 0) {
-      continue;
-    }
-
-    QRect rect(b->x, b->y, b->w, b->h);
-
-    TextBox tBox;
-    tBox.m_rect = rect;
-    tBox.m_text = strRecognized;
-    textBoxes.push_back(tBox);
-  } // for i, all detected rects by ocr
-
-  // free memory from detected by ocr boxes set
-  boxaDestroy(&bounds);
-
-  m_ui.m_progressRecognition->setVisible(false);
-  return textBoxes;
-}
-
 void WidImageBinarizer::onPushButtonCompareBinarized() { 
   assert(m_numWidgets >= 2);
   RecognitionResult* resA = m_recognitionResults[0];
@@ -703,7 +824,7 @@ void WidImageBinarizer::onPushButtonCompareBinarized() {
 
   FImage imageA(resA->m_image);
   FImage imageB(resB->m_image);
-  FImage imageDiff(resA->m_image);
+  BinImage imageDiff(imageA.width(), imageA.height());
   const float distBar = 0.2F;
   ImageDiff::getDiff(imageA, imageB, distBar, imageDiff);
   QImage qimageDiff = imageDiff.getQImage();
@@ -720,3 +841,26 @@ void WidImageBinarizer::onPushButtonCompareBinarized() {
   dlg->close();
   delete dlg;
 }
+
+void WidImageBinarizer::onPushButtonExportPdf() {
+  if (m_recognitionResults.empty())
+    return;
+  const QString fileName = QFileDialog::getSaveFileName(
+      this, "Export searchable pdf", "", "Pdf files (*.pdf)");
+  if (fileName.length() < 2)
+    return;
+
+  // result tabs become pages: result image with invisible words over it
+  PdfExport exporter(m_ctxFz);
+  bool ok = exporter.open(fileName.toUtf8().constData());
+  for (size_t i = 0; (i < m_recognitionResults.size()) && ok; i++) {
+    const RecognitionResult* res = m_recognitionResults[i];
+    ok = exporter.addPage(res->m_image, res->m_pageScale, res->m_textBoxes);
+  }
+  const int numPages = exporter.getNumPages();
+  ok = exporter.close() && ok;
+  if (ok)
+    setStatusText(QString("Exported %1 pages").arg(numPages));
+  else
+    setStatusText("Cannot export pdf");
+}
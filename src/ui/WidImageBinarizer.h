@@ -18,14 +18,23 @@
 
 #include <QtWidgets/QMainWindow>
 #include <QtGui/QImage>
+#include <functional>
+#include <map>
 #include <vector>
 #include <QtCore/QRect>
-#include <QtCore/QTime>
+#include <QtCore/QTimer>
 
 #include "ui_WidImageBinarizer.h"
 
 #include "RecogRes.h"
 #include "WidRender.h"
+#include "BinImage.h"
+#include "Binarizer.h"
+#include "OcrPool.h"
+#include "RecogWorker.h"
+#include "PdfText.h"
+#include "FzLocks.h"
+#include "PdfPages.h"
 
 #if defined(_MSC_VER)
 #pragma warning(pop)
@@ -49,13 +58,6 @@
 // classes
 // *************************************
 
-enum class AlgirithmBinType {
-  ALGORITHM_SAUVOLA = 0,
-  ALGORITHM_SAUVOLA_FAST = 1,
-  ALGORITHM_LEPTONICA = 2,
-  ALGORITHM_NONE = 3,
-};
-
 
 class WidImageBinarizer: public QMainWindow {
   Q_OBJECT
@@ -67,9 +69,14 @@ public:
   bool performOpenFile(QString& strFileName);
   void setStatusText(const QString& strText);
   void enableButtonRemoveSelectedRectangles();
+  void enableButtonReprocessSelection(bool isEnabled);
 
   void setSauvolaRange(int range);
   void setSauvolaFactor(float factor);
+  // pdf text layer usage instead of OCR
+  void setTextLayerPolicy(TextLayerPolicy policy);
+  // pdf render scale by text size of every page (until manual zoom)
+  void setAutoScale(bool isAuto);
 
 
 
@@ -90,6 +97,7 @@ protected slots:
   void onCheckRenderRectangles(int state);
 
   void onPressedRemoveSelectedRectangles();
+  void onPressedReprocessSelection();
   void onPushButtonDown();
   void onPushButtonUp();
   void onPushButtonPlus();
@@ -100,22 +108,42 @@ protected slots:
   void oRadioRotateRight();
 
   void onPushButtonCompareBinarized();
+  void onPushButtonExportPdf();
 
+  void onTimerRecognition();
 
 
 private:
-  QImage                  createSauvola(QImage& imageSrc, int neibSize, float factor);
-  QImage                  createSauvolaFast(QImage& imageSrc, int neibSize, float factor);
-  QImage                  createLeptonicaBinarization(QImage& imageSrc, int neibSize,
-                                float factor);
-
-  std::vector<TextBox> applyTesseract(QImage& image);
+  // selection of result, re-recognized on upscaled region image
+  struct RegionJob {
+    RecognitionResult*    res = nullptr;
+    // selection in result image pixels
+    QRect                 rect;
+    // region image pixels per result image pixel
+    float                 scale = 1.0F;
+    std::vector<TextBox>  words;
+  };
+
+  // binarization by current algorithm and parameters. Sauvola window is
+  // multiplied by scaleWindow
+  std::function<BinImage(const QImage&)> getBinarizeFunction(
+                              float scaleWindow = 1.0F) const;
+  // page image with words, streamed by worker
+  void                    processRecogEvent(RecogEvent& evt);
+  // events of selection re-processing job
+  void                    processRegionEvent(RecogEvent& evt, RegionJob& job);
+  // remove tab with result and its render widget
+  void                    removeResultTab(RecognitionResult* res);
   void                    showImageSrc();
   void                    renderBoxes(QPixmap& pixmap, float scale, std::vector<TextBox>& boxes);
   void                    addResultToTab(RecognitionResult* res,
                               const QString& strTabMsg = QString(""));
   QImage                  loadPdf(const char* fileName);
   void                    loadCurrentPageFromDoc();
+  // text layer of current pdf page, rendered with ctm
+  void                    updatePageTextLayer(fz_matrix ctm);
+  // m_docScale by text size of current page, if auto scale is on
+  void                    updateAutoScale();
   void                    updatePagesUi();
   void                    ocrInit();
   void                    ocrDestroy();
@@ -124,10 +152,26 @@ private:
   // private data
   Ui::WidImageBinarizerClass      m_ui;
 
-  // interface to tessocr
-  void*                           m_ocrApi;
+  // initialized tesseract engines
+  OcrPool                         m_ocrPool;
+  // binarize + ocr jobs in background, uses m_ocrPool
+  RecogWorker                     m_recogWorker;
+  // takes worker events on ui thread
+  QTimer                          m_timerRecognition;
+  // last submitted job, 0 if finished
+  int                             m_jobIdCurrent;
+  // results (tabs) of jobs in work by job id, shown from IMAGE event
+  std::map<int, RecognitionResult*> m_jobResults;
+  // selection re-processing jobs in work by job id
+  std::map<int, RegionJob>        m_regionJobs;
+  // binarized page is split into text blocks, recognized in parallel
+  bool                            m_ocrByBlocks;
+  // mupdf lock functions, should outlive m_ctxFz
+  FzLocks                         m_fzLocks;
   // interface to leptonica / tesseract lib
   fz_context*                     m_ctxFz;
+  // rendered pages cache with prefetch of neighbours
+  PdfPages                        m_pdfPages;
 
   // source pdf document
   fz_document*                    m_doc;
@@ -135,6 +179,10 @@ private:
   float                           m_docScale;
   // pdf rotate
   float                           m_docRotate;
+  // m_docScale is estimated by text size
+  bool                            m_docAutoScale;
+  // estimated scale of pages (0: no text), for current rotation
+  std::map<int, float>            m_docAutoScales;
   // num pages
   int                             m_docNumPages;
   // index cur page of dicument
@@ -142,9 +190,11 @@ private:
 
   // source input image (without processing)
   QImage                          m_imageSrc;
-
-  // prevent double click on  button
-  QTime                           m_timeClickButton;
+  // m_imageSrc is a rendered pdf page
+  bool                            m_pageFromPdf;
+  // embedded text of current pdf page
+  PdfTextLayer                    m_pageTextLayer;
+  TextLayerPolicy                 m_textLayerPolicy;
 
   // sauvola parameters
   int                             m_sauvilaNeibSize;
@@ -11,6 +11,7 @@
 
 #include "WidRender.h"
 #include "WidImageBinarizer.h"
+#include "Trace.h"
 
 WidRender::WidRender(QWidget* parent) : QWidget(parent) {
   m_recognitionResult = nullptr;
@@ -137,6 +138,7 @@ void WidRender::drawLasso(QPainter* painter) {
 
 void WidRender::paintEvent(QPaintEvent* evt) { 
   evt;
+  TRACE_ZONE("paint");
   QPainter painter(this);
 
   int wRender = size().width();
@@ -183,6 +185,9 @@ void WidRender::detectRectsByLasso() {
   if (isOneDetected)  {
     m_widMain->enableButtonRemoveSelectedRectangles();
   }
+  m_widMain->enableButtonReprocessSelection(
+      !m_recognitionResult->m_rectSelected.isEmpty() &&
+      m_recognitionResult->hasSource());
 }
 
 void WidRender::mousePressEvent(QMouseEvent* evt) {
@@ -29,6 +29,7 @@
 
 #include "main.h"
 #include "WidImageBinarizer.h"
+#include "Trace.h"
 
 
 // *************************************
@@ -65,14 +66,35 @@ int main(int argc, char *argv[])
   // detect file name to open immediately after 
   // application start
   QString fileNameOpen;
-  for (int i = 1; i < argc; i += 2) {
+  // pdf text layer: -t ocr | auto | layer
+  TextLayerPolicy textLayerPolicy = TextLayerPolicy::AUTO;
+  // pdf render scale: -s auto
+  bool isAutoScale = false;
+  // trace of stages, written at exit: -T trace.json
+  QString fileNameTrace;
+  for (int i = 1; i + 1 < argc; i += 2) {
     if (args[i] == "-o")
       fileNameOpen = args[i + 1];
+    if (args[i] == "-T")
+      fileNameTrace = args[i + 1];
+    if ((args[i] == "-s") && (args[i + 1] == "auto"))
+      isAutoScale = true;
+    if (args[i] == "-t") {
+      if (args[i + 1] == "ocr")
+        textLayerPolicy = TextLayerPolicy::ALWAYS_OCR;
+      if (args[i + 1] == "layer")
+        textLayerPolicy = TextLayerPolicy::TEXT_LAYER_ONLY;
+    }
   }
 
 
+  Trace::setThreadName("main");
+  Trace::setEnabled(fileNameTrace.length() > 0);
+
   QApplication a(argc, argv);
   WidImageBinarizer winMain;
+  winMain.setTextLayerPolicy(textLayerPolicy);
+  winMain.setAutoScale(isAutoScale);
   winMain.show();
   if (fileNameOpen.length() > 0) 
     winMain.performOpenFile(fileNameOpen);
@@ -86,6 +108,13 @@ int main(int argc, char *argv[])
 #endif
 
   const int appRes = a.exec();
+  if (fileNameTrace.length() > 0) {
+    Trace::setEnabled(false);
+    QFile fileTrace(fileNameTrace);
+    if (!fileTrace.open(QFile::WriteOnly | QFile::Truncate) ||
+        !Trace::write(&fileTrace))
+      qInfo() << "Cannot write trace" << fileNameTrace;
+  }
   qInfo() << "Binarizer Application has been finished";
 
   return appRes;